@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/aximemsim.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Models a memory behind an AXI4 slave port, for measuring the
+//		burst efficiency of the controller's AXI DMA option.  See
+//	aximemsim.h for more details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "aximemsim.h"
+
+AXIMEMSIM::AXIMEMSIM(MEMSIM *mem, const unsigned delay,
+		const unsigned maxout) {
+	// {{{
+	m_mem    = mem;
+	m_delay  = delay;
+	m_maxout = (maxout > 0) ? maxout : 1;
+	clear_stats();
+}
+// }}}
+
+void	AXIMEMSIM::clear_stats(void) {
+	// {{{
+	m_clocks = m_active = m_errors = 0;
+	m_rd_bursts = m_rd_beats = 0;
+	m_wr_bursts = m_wr_beats = 0;
+}
+// }}}
+
+bool	AXIMEMSIM::stall(void) const {
+	return (rand() & 0x03f)==0;	// 1 in 64
+}
+
+void	AXIMEMSIM::write(BURST &b, const uint32_t *wdata,
+		const uint64_t wstrb) {
+	// {{{
+	const int	NW = MEMSIM::NWRDWIDTH;
+	const uint32_t	*sp = &wdata[NW-1];
+
+	// As with MEMSIM, the first (lowest addressed) word is found in the
+	// most significant bits of the bus
+	for(int k=0; k<NW; k++) {
+		unsigned	dsel = (wstrb >> ((NW-1-k)*4)) & 0x0f;
+		uint32_t	sel = 0, memv = (*m_mem)[b.m_addr + k];
+
+		if (dsel & 0x8)
+			sel |= 0x0ff000000;
+		if (dsel & 0x4)
+			sel |= 0x000ff0000;
+		if (dsel & 0x2)
+			sel |= 0x00000ff00;
+		if (dsel & 0x1)
+			sel |= 0x0000000ff;
+
+		memv &= ~sel;
+		memv |= (*sp-- & sel);
+		(*m_mem)[b.m_addr + k] = memv;
+	}
+
+	b.m_addr += NW;
+}
+// }}}
+
+void	AXIMEMSIM::apply(
+		const uchar awvalid, uchar &awready,
+		const unsigned awid, const BUSW awaddr, const unsigned awlen,
+		const uchar wvalid, uchar &wready,
+		const uint32_t *wdata, const uint64_t wstrb, const uchar wlast,
+		uchar &bvalid, const uchar bready, uchar &bid, uchar &bresp,
+		const uchar arvalid, uchar &arready,
+		const unsigned arid, const BUSW araddr, const unsigned arlen,
+		uchar &rvalid, const uchar rready,
+		uchar &rid, uint32_t *rdata, uchar &rlast, uchar &rresp) {
+	// {{{
+	const int	NW = MEMSIM::NWRDWIDTH;
+	// Byte addresses to (bus aligned) MEMSIM word addresses
+	const unsigned	WSHIFT = 2;
+	BURST		burst;
+
+	m_clocks++;
+	if (awvalid || wvalid || arvalid || !m_rdq.empty()
+			|| !m_wrq.empty() || !m_bq.empty())
+		m_active++;
+
+	// Read address channel
+	// {{{
+	arready = (m_rdq.size() < m_maxout) && !stall();
+	if (arvalid && arready) {
+		burst.m_addr  = (araddr >> WSHIFT) & ~(NW-1);
+		burst.m_beats = arlen + 1;
+		burst.m_id    = arid;
+		burst.m_when  = m_clocks + m_delay;
+		m_rdq.push_back(burst);
+		m_rd_bursts++;
+	}
+	// }}}
+
+	// Read data channel
+	// {{{
+	rvalid = 0;
+	rlast  = 0;
+	rresp  = 0;
+	if (!m_rdq.empty() && m_rdq.front().m_when <= m_clocks) {
+		BURST		&b = m_rdq.front();
+		uint32_t	*dp = &rdata[NW-1];
+
+		rvalid = 1;
+		rid    = b.m_id;
+		rlast  = (b.m_beats == 1);
+		for(int k=0; k<NW; k++)
+			*dp-- = (*m_mem)[b.m_addr + k];
+
+		if (rready) {
+			m_rd_beats++;
+			b.m_addr += NW;
+			if (--b.m_beats == 0)
+				m_rdq.pop_front();
+		}
+	}
+	// }}}
+
+	// Write address channel
+	// {{{
+	awready = (m_wrq.size() + m_bq.size() < m_maxout) && !stall();
+	if (awvalid && awready) {
+		burst.m_addr  = (awaddr >> WSHIFT) & ~(NW-1);
+		burst.m_beats = awlen + 1;
+		burst.m_id    = awid;
+		burst.m_when  = 0;
+		m_wrq.push_back(burst);
+		m_wr_bursts++;
+	}
+	// }}}
+
+	// Write data channel
+	// {{{
+	// Write data is only accepted once its address is known
+	wready = !m_wrq.empty() && !stall();
+	if (wvalid && wready) {
+		BURST	&b = m_wrq.front();
+
+		write(b, wdata, wstrb);
+		m_wr_beats++;
+		b.m_beats--;
+		if ((b.m_beats == 0) != (wlast != 0)) {
+			fprintf(stderr, "AXIMEMSIM: WLAST mismatch, %u beats remaining\n", b.m_beats);
+			m_errors++;
+		}
+
+		if (b.m_beats == 0) {
+			b.m_when = m_clocks + m_delay;
+			m_bq.push_back(b);
+			m_wrq.pop_front();
+		}
+	}
+	// }}}
+
+	// Write response channel
+	// {{{
+	bvalid = 0;
+	bresp  = 0;
+	if (!m_bq.empty() && m_bq.front().m_when <= m_clocks) {
+		bvalid = 1;
+		bid    = m_bq.front().m_id;
+		if (bready)
+			m_bq.pop_front();
+	}
+	// }}}
+}
+// }}}
+
+void	AXIMEMSIM::report(FILE *fp) const {
+	// {{{
+	unsigned long	beats = m_rd_beats + m_wr_beats;
+
+	fprintf(fp, "AXI:  %lu clocks, %lu active, %lu beats (%5.3f beats per active clock)\n",
+		m_clocks, m_active, beats,
+		(m_active) ? (double)beats / m_active : 0.0);
+	fprintf(fp, "AXI:  Reads  %8lu bursts, %8lu beats (%6.1f beats/burst)\n",
+		m_rd_bursts, m_rd_beats,
+		(m_rd_bursts) ? (double)m_rd_beats / m_rd_bursts : 0.0);
+	fprintf(fp, "AXI:  Writes %8lu bursts, %8lu beats (%6.1f beats/burst)\n",
+		m_wr_bursts, m_wr_beats,
+		(m_wr_bursts) ? (double)m_wr_beats / m_wr_bursts : 0.0);
+	if (m_errors)
+		fprintf(fp, "AXI:  %lu protocol errors\n", m_errors);
+}
+// }}}
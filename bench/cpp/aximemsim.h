@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/aximemsim.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Models a memory behind an AXI4 slave port, so that the AXI DMA
+//		option of the controller (OPT_AXI) may be simulated and its
+//	burst efficiency measured.  The memory itself is a MEMSIM, shared with
+//	the Wishbone port, so either port may be used to set up or check DMA
+//	buffers.
+//
+//	Reads return their first beat "delay" clocks after the burst is
+//	accepted, and then one beat per clock.  Writes are accepted as soon
+//	as their address is known, and acknowledged "delay" clocks after
+//	their last beat.  Up to "maxout" bursts may be outstanding in each
+//	direction.  As with MEMSIM, the ready lines are occasionally (1 in 64)
+//	dropped at random.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	AXIMEMSIM_H
+#define	AXIMEMSIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include "memsim.h"
+
+class	AXIMEMSIM {
+public:
+	typedef	MEMSIM::BUSW	BUSW;
+	typedef	MEMSIM::uchar	uchar;
+
+	typedef	struct	{
+		BUSW		m_addr;		// Next word address
+		unsigned	m_beats;	// Beats remaining
+		unsigned	m_id;
+		unsigned long	m_when;		// Clock when data/resp is due
+	} BURST;
+
+	MEMSIM			*m_mem;
+	unsigned		m_delay, m_maxout;
+	std::deque<BURST>	m_rdq, m_wrq, m_bq;
+
+	// Statistics
+	unsigned long		m_clocks, m_active, m_errors,
+				m_rd_bursts, m_rd_beats,
+				m_wr_bursts, m_wr_beats;
+
+	AXIMEMSIM(MEMSIM *mem, const unsigned delay=10,
+			const unsigned maxout=4);
+
+	// apply(...)
+	//	Called once per clock, with the master's current outputs.
+	//	Sets this slave's outputs for the next clock edge.  Addresses
+	//	are in bytes, and lengths are AXI (beats-1) lengths.
+	void	apply(
+			// Write address channel
+			const uchar awvalid, uchar &awready,
+			const unsigned awid, const BUSW awaddr,
+			const unsigned awlen,
+			// Write data channel
+			const uchar wvalid, uchar &wready,
+			const uint32_t *wdata, const uint64_t wstrb,
+			const uchar wlast,
+			// Write response channel
+			uchar &bvalid, const uchar bready,
+			uchar &bid, uchar &bresp,
+			// Read address channel
+			const uchar arvalid, uchar &arready,
+			const unsigned arid, const BUSW araddr,
+			const unsigned arlen,
+			// Read data channel
+			uchar &rvalid, const uchar rready,
+			uchar &rid, uint32_t *rdata, uchar &rlast,
+			uchar &rresp);
+
+	void	clear_stats(void);
+	void	report(FILE *fp = stdout) const;
+private:
+	bool	stall(void) const;
+	void	write(BURST &b, const uint32_t *wdata, const uint64_t wstrb);
+};
+
+#endif
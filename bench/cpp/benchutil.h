@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/benchutil.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Small helpers shared by the host driver benchmarks: a
+//		repeatable pseudorandom sequence, for choosing transfers and
+//	for filling buffers with data that can be checked later, and a wall
+//	clock, for reporting how long a run took.
+//
+//	Each benchmark is a single file, so these are static, and each
+//	benchmark gets its own random sequence.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	BENCHUTIL_H
+#define	BENCHUTIL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+static	uint32_t	bench_rand = 1;
+
+static inline	uint32_t	xrand(void) {
+	// xorshift32
+	bench_rand ^= bench_rand << 13;
+	bench_rand ^= bench_rand >> 17;
+	bench_rand ^= bench_rand << 5;
+	return bench_rand;
+}
+
+// Fill a buffer (a multiple of four bytes long) from xrand()
+static inline	void	fill(char *buf, unsigned nbytes) {
+	for(unsigned k=0; k<nbytes; k += 4) {
+		uint32_t	v = xrand();
+
+		memcpy(&buf[k], &v, 4);
+	}
+}
+
+// Wall clock time, in seconds, from an arbitrary starting point
+static inline	double	wall_now(void) {
+	struct timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,459 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/hostsched.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A cooperative scheduler for simulated host "threads", built
+//		from C++20 coroutines on top of TESTB::tick().
+//
+//	Each host thread is a coroutine returning a HOSTTASK<>.  Rather than
+//	calling tick() itself, a thread co_await's the scheduler: for a number
+//	of clocks, for a predicate on the core's outputs (such as an
+//	interrupt), or for a Wishbone transaction to complete.  While one
+//	thread is waiting, the others continue to run.  Threads may also call
+//	(and co_await) one another, so host operations may be composed from
+//	smaller ones.
+//
+//	Threads are only ever resumed from within HOSTSCHED::run(), once per
+//	clock, after the falling edge of the system clock.  A thread that
+//	calls a blocking TESTB/WB_TB method instead will still work, but
+//	holds up every other thread until it returns.
+//
+//	Shared resources, such as the Wishbone bus or the controller itself,
+//	are protected by a HOSTLOCK.  Waiters are granted the lock in the
+//	order they asked for it.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	HOSTSCHED_H
+#define	HOSTSCHED_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <utility>
+#include <vector>
+#include "testb.h"
+#include "wb_tb.h"
+
+// HOSTTASK<T>
+// {{{
+// The return type of every host thread coroutine.  A HOSTTASK starts out
+// suspended.  It either runs when co_await'ed by another task, whereupon the
+// awaiting task resumes once it completes, or when handed to
+// HOSTSCHED::spawn() as a top level thread.
+//
+struct	HOSTPROMISE {
+	std::coroutine_handle<>	m_continuation;
+
+	std::suspend_always	initial_suspend(void) noexcept { return {}; }
+
+	struct	FINAL {
+		bool	await_ready(void) noexcept { return false; }
+		template<class P> std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<P> h) noexcept {
+			std::coroutine_handle<> c = h.promise().m_continuation;
+			return (c) ? c : std::noop_coroutine();
+		}
+		void	await_resume(void) noexcept {}
+	};
+
+	FINAL	final_suspend(void) noexcept { return {}; }
+	void	unhandled_exception(void) { std::terminate(); }
+};
+
+template<typename T>	struct	HOSTRESULT {
+	T	m_value;
+	void	return_value(T v) { m_value = v; }
+	T	result(void) { return m_value; }
+};
+
+template<>	struct	HOSTRESULT<void> {
+	void	return_void(void) {}
+	void	result(void) {}
+};
+
+template<typename T = void>	class	HOSTTASK {
+public:
+	struct	promise_type : HOSTPROMISE, HOSTRESULT<T> {
+		HOSTTASK	get_return_object(void) {
+			return HOSTTASK(std::coroutine_handle<promise_type>
+					::from_promise(*this));
+		}
+	};
+
+	std::coroutine_handle<promise_type>	m_handle;
+
+	explicit HOSTTASK(std::coroutine_handle<promise_type> h)
+		: m_handle(h) {}
+	HOSTTASK(HOSTTASK &&t) noexcept : m_handle(std::exchange(t.m_handle, {})) {}
+	HOSTTASK(const HOSTTASK &) = delete;
+	HOSTTASK &operator=(const HOSTTASK &) = delete;
+	~HOSTTASK(void) { if (m_handle) m_handle.destroy(); }
+
+	bool	done(void) const { return !m_handle || m_handle.done(); }
+
+	// Awaiting a task runs it, and resumes the awaiting task when done
+	bool	await_ready(void) const { return done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) {
+		m_handle.promise().m_continuation = c;
+		return m_handle;
+	}
+	T	await_resume(void) { return m_handle.promise().result(); }
+};
+// }}}
+
+// HOSTLOCK
+// {{{
+// A first come, first served lock between host threads.  Use as:
+//	co_await lock.lock();
+//	...
+//	lock.unlock();
+//
+class	HOSTLOCK {
+public:
+	bool					m_locked;
+	std::deque<std::coroutine_handle<>>	m_waiting;
+	// Where to queue waiters as they're granted the lock
+	std::deque<std::coroutine_handle<>>	*m_ready;
+
+	HOSTLOCK(void) : m_locked(false), m_ready(NULL) {}
+
+	struct	AWAITER {
+		HOSTLOCK	*m_lock;
+		bool	await_ready(void) {
+			if (m_lock->m_locked)
+				return false;
+			m_lock->m_locked = true;
+			return true;
+		}
+		void	await_suspend(std::coroutine_handle<> h) {
+			m_lock->m_waiting.push_back(h);
+		}
+		void	await_resume(void) {}
+	};
+
+	AWAITER	lock(void) { return AWAITER{ this }; }
+
+	void	unlock(void) {
+		if (m_waiting.empty())
+			m_locked = false;
+		else {
+			// Hand the lock directly to the next waiter.  It'll
+			// be resumed by the scheduler, not from within here.
+			assert(m_ready);
+			m_ready->push_back(m_waiting.front());
+			m_waiting.pop_front();
+		}
+	}
+
+	bool	locked(void) const { return m_locked; }
+	unsigned queued(void) const { return m_waiting.size(); }
+};
+// }}}
+
+template <class VA>	class	HOSTSCHED {
+public:
+	typedef	typename TESTB<VA>::EVENT_PREDICATE	PREDICATE;
+
+	// WAITER: A suspended thread, and what it's waiting on
+	// {{{
+	typedef	struct	{
+		std::coroutine_handle<>	m_handle;
+		PREDICATE	m_predicate;	// Empty if waiting on m_wake
+		unsigned long	m_wake;		// Clock to wake up on
+		uint64_t	m_deadline_ps;	// Zero for none
+		bool		m_edge, m_last;
+		bool		*m_result;
+	} WAITER;
+	// }}}
+
+	TESTB<VA>				*m_tb;
+	std::list<WAITER>			m_waiters;
+	std::deque<std::coroutine_handle<>>	m_ready;
+	std::list<HOSTTASK<void>>		m_threads;
+	unsigned long				m_clocks;
+	HOSTLOCK				m_bus;	// The Wishbone bus
+	bool					m_bomb;
+
+	HOSTSCHED(TESTB<VA> *tb) : m_tb(tb), m_clocks(0), m_bomb(false) {
+		m_bus.m_ready = &m_ready;
+	}
+
+	// Locks must know where to queue waiters as they're granted the lock
+	void	attach(HOSTLOCK &lock) { lock.m_ready = &m_ready; }
+
+	// spawn(task)
+	// {{{
+	// Adds a top level thread.  It will start running the next time
+	// the scheduler runs.
+	void	spawn(HOSTTASK<void> &&task) {
+		m_ready.push_back(task.m_handle);
+		m_threads.push_back(std::move(task));
+	}
+	// }}}
+
+	unsigned	nthreads(void) const { return m_threads.size(); }
+	unsigned long	clocks(void) const { return m_clocks; }
+
+	// run(limit_ps)
+	// {{{
+	// Advance the simulation until all spawned threads have completed,
+	// or until limit_ps of simulation time (if non-zero) have passed.
+	// Returns true if all threads completed.
+	bool	run(uint64_t limit_ps = 0) {
+		uint64_t	deadline = (limit_ps) ? m_tb->m_time_ps + limit_ps : 0;
+
+		resume_ready();
+		while(!m_threads.empty() && !m_tb->done()
+				&& (!deadline || m_tb->m_time_ps < deadline)) {
+			m_tb->tick();
+			if (m_tb->m_clk.falling_edge()) {
+				m_clocks++;
+				poll();
+				resume_ready();
+			}
+		}
+
+		return m_threads.empty();
+	}
+	// }}}
+
+	// Awaitables
+	// {{{
+	// co_await sched.wait_clocks(n) -- wait n system clocks
+	struct	CLOCK_AWAITER {
+		HOSTSCHED	*m_sched;
+		unsigned long	m_count;
+
+		bool	await_ready(void) const { return m_count == 0; }
+		void	await_suspend(std::coroutine_handle<> h) {
+			WAITER	w;
+			w.m_handle = h;
+			w.m_wake = m_sched->m_clocks + m_count;
+			w.m_deadline_ps = 0;
+			w.m_edge = w.m_last = false;
+			w.m_result = NULL;
+			m_sched->m_waiters.push_back(w);
+		}
+		void	await_resume(void) {}
+	};
+
+	CLOCK_AWAITER	wait_clocks(unsigned long n) {
+		return CLOCK_AWAITER{ this, n };
+	}
+
+	// bool ok = co_await sched.until(predicate, timeout_ps, edge)
+	//	Wait for a predicate on the core's outputs.  Returns true if
+	//	the predicate fired, false if the timeout expired first.
+	struct	PREDICATE_AWAITER {
+		HOSTSCHED	*m_sched;
+		PREDICATE	m_predicate;
+		uint64_t	m_timeout_ps;
+		bool		m_edge, m_result;
+
+		bool	await_ready(void) {
+			// Level triggered waits complete at once if the
+			// predicate is already true
+			m_result = !m_edge && m_predicate(m_sched->m_tb->m_core);
+			return m_result;
+		}
+		void	await_suspend(std::coroutine_handle<> h) {
+			WAITER	w;
+			w.m_handle = h;
+			w.m_predicate = m_predicate;
+			w.m_wake = 0;
+			w.m_deadline_ps = (m_timeout_ps)
+				? m_sched->m_tb->m_time_ps + m_timeout_ps : 0;
+			w.m_edge = m_edge;
+			w.m_last = m_predicate(m_sched->m_tb->m_core);
+			w.m_result = &m_result;
+			m_sched->m_waiters.push_back(w);
+		}
+		bool	await_resume(void) { return m_result; }
+	};
+
+	PREDICATE_AWAITER	until(PREDICATE p, uint64_t timeout_ps = 0,
+				bool edge = false) {
+		return PREDICATE_AWAITER{ this, p, timeout_ps, edge, false };
+	}
+	// }}}
+
+	// Wishbone transactions
+	// {{{
+	// These mirror the blocking WB_TB methods, but wait on the scheduler
+	// rather than calling tick() directly.  Concurrent callers are
+	// serialized on m_bus.
+	HOSTTASK<unsigned>	wb_read(unsigned a) {
+		VA		*core = m_tb->m_core;
+		int		errcount = 0;
+		unsigned	result;
+
+		co_await m_bus.lock();
+
+		core->i_wb_cyc = 1;
+		core->i_wb_stb = 1;
+		core->i_wb_we  = 0;
+		core->i_wb_addr= a;
+
+		while((errcount++ < BOMBCOUNT)&&(core->o_wb_stall))
+			co_await wait_clocks(1);
+		co_await wait_clocks(1);
+
+		core->i_wb_stb = 0;
+		while((errcount++ < BOMBCOUNT)&&(!core->o_wb_ack))
+			co_await wait_clocks(1);
+
+		result = core->o_wb_data;
+		core->i_wb_cyc = 0;
+
+		if (errcount >= BOMBCOUNT) {
+			printf("HOST/SR-BOMB: NO RESPONSE AFTER %d CLOCKS\n", errcount);
+			m_bomb = true;
+		}
+
+		m_bus.unlock();
+		co_return result;
+	}
+
+	HOSTTASK<void>	wb_writev(std::vector<WBWRITE> list) {
+		VA		*core = m_tb->m_core;
+		unsigned	errcount = 0, nacks = 0;
+
+		co_await m_bus.lock();
+
+		core->i_wb_cyc = 1;
+		core->i_wb_stb = 1;
+		core->i_wb_we  = 1;
+		for(unsigned k=0; k<list.size(); k++) {
+			core->i_wb_addr = list[k].a;
+			core->i_wb_data = list[k].v;
+			core->i_wb_sel  = list[k].sel;
+
+			errcount = 0;
+			while((errcount++ < BOMBCOUNT)&&(core->o_wb_stall)) {
+				co_await wait_clocks(1);
+				if (core->o_wb_ack)
+					nacks++;
+			}
+			co_await wait_clocks(1);
+			if (core->o_wb_ack)
+				nacks++;
+		}
+
+		core->i_wb_stb = 0;
+		errcount = 0;
+		while((nacks < list.size())&&(errcount++ < BOMBCOUNT)) {
+			co_await wait_clocks(1);
+			if (core->o_wb_ack) {
+				nacks++;
+				errcount = 0;
+			}
+		}
+
+		core->i_wb_cyc = 0;
+
+		if (errcount >= BOMBCOUNT) {
+			printf("HOST/VW-BOMB: NO RESPONSE AFTER %d CLOCKS\n", errcount);
+			m_bomb = true;
+		}
+
+		m_bus.unlock();
+	}
+
+	HOSTTASK<void>	wb_write(unsigned a, unsigned v) {
+		std::vector<WBWRITE>	list(1);
+
+		list[0].a = a;
+		list[0].v = v;
+		list[0].sel = 0x0f;
+		co_await wb_writev(list);
+	}
+	// }}}
+
+private:
+	// poll()
+	// {{{
+	// Called once per clock.  Moves any waiters whose conditions have
+	// been met onto the ready queue.
+	void	poll(void) {
+		for(auto it = m_waiters.begin(); it != m_waiters.end(); ) {
+			bool	wake = false;
+
+			if (!it->m_predicate) {
+				wake = (m_clocks >= it->m_wake);
+			} else {
+				bool	v = it->m_predicate(m_tb->m_core);
+
+				wake = (it->m_edge) ? (v && !it->m_last) : v;
+				it->m_last = v;
+				if (wake)
+					*it->m_result = true;
+				else if (it->m_deadline_ps
+					&& m_tb->m_time_ps >= it->m_deadline_ps) {
+					*it->m_result = false;
+					wake = true;
+				}
+			}
+
+			if (wake) {
+				m_ready.push_back(it->m_handle);
+				it = m_waiters.erase(it);
+			} else
+				it++;
+		}
+	}
+	// }}}
+
+	// resume_ready()
+	// {{{
+	// Resumes every ready thread, in order.  Threads resumed here may
+	// make others ready, as when releasing a lock, so keep going until
+	// the queue is empty.  Then reap any top level threads that are done.
+	void	resume_ready(void) {
+		while(!m_ready.empty()) {
+			std::coroutine_handle<> h = m_ready.front();
+			m_ready.pop_front();
+			h.resume();
+		}
+
+		m_threads.remove_if([](const HOSTTASK<void> &t) {
+			return t.done(); });
+	}
+	// }}}
+};
+
+#endif
@@ -48,6 +48,10 @@
 #include <string.h>
 #include <stdint.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "memsim.h"
 #include "byteswap.h"
 
@@ -66,14 +70,39 @@ void byteswapbuf(unsigned int n, uint32_t *buf) {
 
 const int	MEMSIM::NWRDWIDTH = 1;
 
+static	bool	shmem(const char *shname) {
+	return (shname[0] == '/') && (NULL == strchr(&shname[1], '/'));
+}
+
 MEMSIM::MEMSIM(const unsigned int nbytes, const unsigned int delay) {
+	// {{{
+	init(nbytes, delay);
+
+	m_mem = new BUSW[m_len];
+	memset(m_mem, 0, sizeof(BUSW)*m_len);
+}
+// }}}
+
+MEMSIM::MEMSIM(const char *shname, const unsigned int nbytes,
+		const unsigned int delay, const bool unlink) {
+	// {{{
+	init(nbytes, delay);
+
+	m_unlink = unlink;
+	map(shname);
+}
+// }}}
+
+void	MEMSIM::init(const unsigned int nbytes, const unsigned int delay) {
 	// {{{
 	unsigned int	nxt;
 	for(nxt=1; nxt < nbytes; nxt<<=1)
 		;
 	m_len = nxt; m_mask = nxt-1;
-	m_mem = new BUSW[m_len];
-	memset(m_mem, 0, sizeof(BUSW)*m_len);
+	m_mem = NULL;
+	m_mapped = false;
+	m_unlink = false;
+	m_shname = NULL;
 
 	m_cleared = false;
 	m_delay = delay;
@@ -90,11 +119,90 @@ MEMSIM::MEMSIM(const unsigned int nbytes, const unsigned int delay) {
 }
 // }}}
 
+void	MEMSIM::map(const char *shname) {
+	// {{{
+	// Names of the form "/name", with no further slashes, are POSIX
+	// shared memory segments, as found (on Linux) in /dev/shm.  Anything
+	// else is a regular file.
+	// Either way, the segment is created if it doesn't exist, and grown
+	// to the size of the memory if it is too small.  Any existing
+	// contents are preserved, so a producer may fill the memory before
+	// the simulation starts.
+	const size_t	nbytes = sizeof(BUSW)*m_len;
+	struct stat	sb;
+	void		*ptr;
+	int		fd;
+
+	if (shmem(shname))
+		fd = shm_open(shname, O_RDWR | O_CREAT, 0644);
+	else
+		fd = open(shname, O_RDWR | O_CREAT, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "MEMSIM: Could not open shared memory \'%s\'\n",
+			shname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (0 != fstat(fd, &sb) || ((size_t)sb.st_size < nbytes
+			&& 0 != ftruncate(fd, nbytes))) {
+		fprintf(stderr, "MEMSIM: Could not size \'%s\' to %lu bytes\n",
+			shname, (unsigned long)nbytes);
+		perror("O/S Err:");
+		close(fd);
+		exit(EXIT_FAILURE);
+	}
+
+	ptr = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == ptr) {
+		fprintf(stderr, "MEMSIM: Could not map \'%s\'\n", shname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+
+	m_mem = (BUSW *)ptr;
+	m_mapped = true;
+	m_shname = strdup(shname);
+}
+// }}}
+
 MEMSIM::~MEMSIM(void) {
 	// {{{
-	delete[]	m_mem;
+	if (m_mapped) {
+		munmap(m_mem, sizeof(BUSW)*m_len);
+		if (m_unlink) {
+			if (shmem(m_shname))
+				shm_unlink(m_shname);
+			else
+				unlink(m_shname);
+		}
+		free(m_shname);
+	} else
+		delete[]	m_mem;
 	delete[] m_fifo_ack;
-    delete[] m_fifo_data;
+	delete[] m_fifo_data;
+}
+// }}}
+
+void	MEMSIM::sync(void) {
+	// {{{
+	// Only needed for file backed memories, to guarantee the file
+	// reflects the memory.  Shared memory segments are always coherent.
+	if (m_mapped)
+		msync(m_mem, sizeof(BUSW)*m_len, MS_SYNC);
+}
+// }}}
+
+bool	MEMSIM::compare(const BUSW a, const BUSW b, const BUSW nwords) const {
+	// {{{
+	// Compares two regions of memory, returning true if they match.  The
+	// regions are not allowed to wrap around the end of memory.
+	if (((a & m_mask) + nwords > m_len) || ((b & m_mask) + nwords > m_len))
+		return false;
+	return 0 == memcmp(&m_mem[a & m_mask], &m_mem[b & m_mask],
+						nwords * sizeof(BUSW));
 }
 // }}}
 
@@ -112,7 +220,9 @@ void	MEMSIM::load(const char *fname) {
 		nr = 0;
 	} else {
 		nr = fread(m_mem, sizeof(BUSW), m_len, fp);
+#ifndef	SATA_LITTLE_ENDIAN
 		byteswapbuf(nr, m_mem);
+#endif
 		fclose(fp);
 
 		if (nr != m_len) {
@@ -130,7 +240,10 @@ void	MEMSIM::load(const char *fname) {
 void	MEMSIM::load(const unsigned int addr, const char *buf, const size_t len) {
 	// {{{
 	memcpy(&m_mem[addr], buf, len);
+#ifndef	SATA_LITTLE_ENDIAN
+	// A big endian bus keeps the first byte in the MSB of each word
 	byteswapbuf(len/sizeof(BUSW), &m_mem[addr]);
+#endif
 }
 // }}}
 
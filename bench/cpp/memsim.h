@@ -13,6 +13,13 @@
 //	ZipCPU project in that there is a variable delay from request to
 //	completion.
 //
+//	The memory may optionally be backed by a named POSIX shared memory
+//	segment (names of the form "/name") or by a memory mapped file.  In
+//	that case, an external process may map the same segment and fill
+//	DMA source buffers, or consume DMA destination buffers, while the
+//	simulation runs.  Words within the segment are kept in host order,
+//	exactly as they are seen on the bus.
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -47,6 +54,7 @@
 #ifndef	MEMSIM_H
 #define	MEMSIM_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 class	MEMSIM {
@@ -58,10 +66,15 @@ public:
 	BUSW	*m_mem, m_len, m_mask, m_head, m_tail, m_delay_mask, m_delay;
 	int	*m_fifo_ack;
 	BUSW	*m_fifo_data;
-	bool	m_cleared;
+	bool	m_cleared, m_mapped, m_unlink;
+	char	*m_shname;
 
 	MEMSIM(const unsigned int nbytes, const unsigned int delay=27);
+	MEMSIM(const char *shname, const unsigned int nbytes,
+			const unsigned int delay=27, const bool unlink=false);
 	~MEMSIM(void);
+	bool	shared(void) const { return m_mapped; }
+	void	sync(void);
 	void	load(const char *fname);
 	void	load(const unsigned int addr, const char *buf,const size_t len);
 	void	apply(const uchar wb_cyc, const uchar wb_stb,
@@ -79,6 +92,11 @@ public:
 			o_stall, o_ack, o_data);
 	}
 	BUSW &operator[](const BUSW addr) { return m_mem[addr&m_mask]; }
+	BUSW	*data(const BUSW addr) { return &m_mem[addr&m_mask]; }
+	bool	compare(const BUSW a, const BUSW b, const BUSW nwords) const;
+private:
+	void	init(const unsigned int nbytes, const unsigned int delay);
+	void	map(const char *shname);
 };
 
 #endif
@@ -0,0 +1,354 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/satabench.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A file system benchmark for the software driver.  FatFS runs
+//		on top of the host build of sw/satadrv.c, which runs on top of
+//	the Verilated controller, which talks to a SATASIM holding a FAT
+//	formatted disk image.  Each file named on the command line is copied
+//	onto the simulated drive, and then back off of it again and compared
+//	with the original.  Without any files, a pseudo-random file is made
+//	up instead.  Throughput is reported both in simulated time, as the
+//	hardware would see it, and in wall clock time, as a measure of how
+//	long the simulation takes.
+//
+//	FatFS itself is not a part of this repository.  See the satabench
+//	target in the Makefile.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "satatb.h"
+#include "satadrv.h"
+
+// The size of the DMA memory, as given to MEMSIM.  The driver's rings, the
+// bounce buffer, and any sector cache take up only a small part of it.
+static	const unsigned	BENCH_MEMSIZE = 1024*1024;
+
+// FatFS' buffers are in host memory, out of the controller's reach, so all
+// transfers bounce through a buffer of this many sectors in DMA memory
+static	const unsigned	BOUNCE_SECTORS = 128;
+
+static	struct SATADRV_S	*bench_drv = NULL;
+static	char			*bench_bounce = NULL;
+
+// FatFS disk I/O layer
+// {{{
+DSTATUS	disk_initialize(BYTE pdrv) {
+	return (pdrv == 0 && bench_drv != NULL) ? 0 : STA_NOINIT;
+}
+
+DSTATUS	disk_status(BYTE pdrv) {
+	return disk_initialize(pdrv);
+}
+
+DRESULT	disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
+	// {{{
+	if (pdrv != 0 || NULL == bench_drv)
+		return RES_NOTRDY;
+
+	while(count > 0) {
+		UINT	n = (count > BOUNCE_SECTORS) ? BOUNCE_SECTORS : count;
+
+		if (RES_OK != sata_read(bench_drv, sector, n, bench_bounce))
+			return RES_ERROR;
+		memcpy(buff, bench_bounce, n * 512);
+		buff += n * 512; sector += n; count -= n;
+	}
+
+	return RES_OK;
+}
+// }}}
+
+DRESULT	disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count) {
+	// {{{
+	if (pdrv != 0 || NULL == bench_drv)
+		return RES_NOTRDY;
+
+	while(count > 0) {
+		UINT	n = (count > BOUNCE_SECTORS) ? BOUNCE_SECTORS : count;
+
+		memcpy(bench_bounce, buff, n * 512);
+		if (RES_OK != sata_write(bench_drv, sector, n, bench_bounce))
+			return RES_ERROR;
+		buff += n * 512; sector += n; count -= n;
+	}
+
+	return RES_OK;
+}
+// }}}
+
+DRESULT	disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+	if (pdrv != 0 || NULL == bench_drv)
+		return RES_NOTRDY;
+	return (DRESULT)sata_ioctl(bench_drv, cmd, (char *)buff);
+}
+
+DWORD	get_fattime(void) {
+	// 2025-01-01, 00:00:00
+	return ((DWORD)(2025-1980) << 25) | (1 << 21) | (1 << 16);
+}
+// }}}
+
+// Timing
+// {{{
+class	BENCHTIMER {
+	SATATB		*m_tb;
+	uint64_t	m_start_ps;
+	struct timespec	m_start;
+public:
+	BENCHTIMER(SATATB *tb) : m_tb(tb) { start(); }
+
+	void	start(void) {
+		m_start_ps = m_tb->get_time_ps();
+		clock_gettime(CLOCK_MONOTONIC, &m_start);
+	}
+
+	double	sim_seconds(void) const {
+		return (m_tb->get_time_ps() - m_start_ps) * 1e-12;
+	}
+
+	double	wall_seconds(void) const {
+		struct timespec	now;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (now.tv_sec - m_start.tv_sec)
+			+ (now.tv_nsec - m_start.tv_nsec) * 1e-9;
+	}
+
+	void	report(FILE *fp, const char *what, size_t nbytes) const {
+		double	sim = sim_seconds(), wall = wall_seconds();
+
+		fprintf(fp, "%-24s %9lu bytes, %8.3f ms simulated (%7.2f MB/s), %8.2f s wall (%7.2f kB/s)\n",
+			what, (unsigned long)nbytes, sim * 1e3,
+			(sim > 0) ? nbytes / sim / 1e6 : 0.0,
+			wall, (wall > 0) ? nbytes / wall / 1e3 : 0.0);
+	}
+};
+// }}}
+
+// Copy a buffer onto the drive, then back again, and check it
+// {{{
+static	bool	copy_test(FILE *rpt, SATATB *tb, const char *name,
+			const std::vector<char> &data) {
+	std::vector<char>	back(data.size());
+	std::string	path = std::string("/") + name;
+	BENCHTIMER	timer(tb);
+	FIL		fp;
+	UINT		nbytes;
+	FRESULT		fr;
+
+	// Copy to the drive
+	fr = f_open(&fp, path.c_str(), FA_WRITE | FA_CREATE_ALWAYS);
+	if (FR_OK == fr)
+		fr = f_write(&fp, data.data(), data.size(), &nbytes);
+	if (FR_OK == fr)	// Also flushes the sector cache, if any
+		fr = f_close(&fp);
+	if (FR_OK != fr || nbytes != data.size()) {
+		fprintf(rpt, "%s: Write failed, FatFS error %d\n", name, fr);
+		return false;
+	}
+	timer.report(rpt, (std::string(name) + " (to drive)").c_str(),
+							data.size());
+
+	// And back off of it again
+	timer.start();
+	fr = f_open(&fp, path.c_str(), FA_READ);
+	if (FR_OK == fr)
+		fr = f_read(&fp, back.data(), back.size(), &nbytes);
+	if (FR_OK == fr)
+		fr = f_close(&fp);
+	if (FR_OK != fr || nbytes != data.size()) {
+		fprintf(rpt, "%s: Read failed, FatFS error %d\n", name, fr);
+		return false;
+	}
+	timer.report(rpt, (std::string(name) + " (from drive)").c_str(),
+							data.size());
+
+	if (0 != memcmp(data.data(), back.data(), data.size())) {
+		fprintf(rpt, "%s: Data read back doesn't match\n", name);
+		return false;
+	} return true;
+}
+// }}}
+
+static	bool	load_file(const char *fname, std::vector<char> &data) {
+	FILE	*fp = fopen(fname, "rb");
+	long	len;
+
+	if (NULL == fp || 0 != fseek(fp, 0, SEEK_END) || (len = ftell(fp)) < 0) {
+		if (fp)
+			fclose(fp);
+		return false;
+	}
+
+	rewind(fp);
+	data.resize(len);
+	if (len > 0 && 1 != fread(data.data(), len, 1, fp)) {
+		fclose(fp);
+		return false;
+	} fclose(fp);
+	return true;
+}
+
+void	usage(void) {
+	fprintf(stderr, "USAGE: satabench [-v] [-i <image>] [-n <kB>] [file ...]\n"
+"\n"
+"\t-i <image>\tThe FAT formatted disk image to use.  (Default: sata.img)\n"
+"\t\tChanges are written back to the image.\n"
+"\t-n <kB>\tThe size of the pseudo-random file to use when no files are\n"
+"\t\tgiven.  (Default: 256kB)\n"
+"\t-v\tVerbose.  Leave the simulation's chatter on stdout.\n"
+"\n"
+"\tEach file is copied onto the drive, under its base name, and then\n"
+"\tread back and compared.\n");
+}
+
+int	main(int argc, char **argv) {
+	const char	*image = "sata.img";
+	unsigned	kbytes = 256;
+	bool		verbose = false, success = true;
+	FILE		*rpt = stdout;
+	struct stat	sb;
+	uint8_t		*img;
+	FATFS		fs;
+	int		fd, opt;
+
+	while((opt = getopt(argc, argv, "i:n:vh")) != -1) {
+		switch(opt) {
+		case 'i': image = optarg; break;
+		case 'n': kbytes = atoi(optarg); break;
+		case 'v': verbose = true; break;
+		case 'h': usage(); exit(EXIT_SUCCESS); break;
+		default: usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	// Map the disk image, so that the drive writes straight back to it
+	fd = open(image, O_RDWR);
+	if (fd < 0 || 0 != fstat(fd, &sb) || sb.st_size < 512) {
+		fprintf(stderr, "ERR: Cannot open %s\n", image);
+		exit(EXIT_FAILURE);
+	}
+
+	img = (uint8_t *)mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (MAP_FAILED == img) {
+		perror("O/S Err: mmap");
+		exit(EXIT_FAILURE);
+	}
+
+	// The bus models (and the driver) talk a lot.  Keep the report, and
+	// send everything else to /dev/null.
+	if (!verbose) {
+		rpt = fdopen(dup(STDOUT_FILENO), "w");
+		if (NULL == rpt || NULL == freopen("/dev/null", "w", stdout)) {
+			fprintf(stderr, "ERR: Cannot redirect stdout\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	SATATB	tb(NULL, BENCH_MEMSIZE);
+
+	tb.m_sata->attach_disk(img, sb.st_size / 512);
+
+	tb.reset_controller();
+	tb.wait_while_link_ready();
+	tb.wait(1000);
+
+	// Bring the driver up
+	{
+		BENCHTIMER	timer(&tb);
+
+		bench_drv = sata_init(satahost_attach(&tb, 0));
+		if (NULL == bench_drv) {
+			fprintf(rpt, "ERR: sata_init failed\n");
+			exit(EXIT_FAILURE);
+		}
+		bench_bounce = (char *)satahost_malloc(BOUNCE_SECTORS * 512);
+		timer.report(rpt, "sata_init", 512);
+	}
+
+	if (FR_OK != f_mount(&fs, "", 1)) {
+		fprintf(rpt, "ERR: No FAT file system found on %s\n", image);
+		exit(EXIT_FAILURE);
+	}
+
+	if (optind >= argc) {
+		std::vector<char>	data(kbytes * 1024);
+		uint32_t		lfsr = 1;
+
+		for(size_t k=0; k<data.size(); k++) {
+			lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? 0x80200003u : 0);
+			data[k] = lfsr;
+		}
+
+		success = copy_test(rpt, &tb, "BENCH.DAT", data);
+	} else for(int k=optind; k<argc; k++) {
+		std::vector<char>	data;
+		std::string		path = argv[k];
+
+		if (!load_file(argv[k], data)) {
+			fprintf(rpt, "ERR: Cannot read %s\n", argv[k]);
+			success = false;
+			continue;
+		}
+
+		success = copy_test(rpt, &tb, basename(&path[0]), data)
+				&& success;
+	}
+
+	f_unmount("");
+	tb.m_sata->report(rpt);
+
+	munmap(img, sb.st_size);
+	close(fd);
+
+	fprintf(rpt, "SATABENCH: %s\n", (success) ? "SUCCESS" : "FAILED");
+	fflush(rpt);
+	return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/satahost.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Connects the host build of the software driver to the
+//		Verilated controller of a SATATB.  See satahost.h.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+#include "satatb.h"
+#include "satahost.h"
+
+// How long to wait on the interrupt before giving up: long enough for the
+// largest command (65536 sectors) at Gen1 rates
+static	const uint64_t	SATAHOST_TIMEOUT_PS = 1000000000000ul;	// 1s
+
+// Every controller attached so far.  When there's more than one, they are
+// ticked together, so that none runs ahead of the others.
+static	std::vector<SATATB *>	satahost_tbs;
+
+// DMA memory
+// {{{
+// All drivers share the one memory.  Allocations come from the top of it,
+// down to the base given by satahost_attach().  Several controllers may
+// only share it if each maps the same named segment, since a MEMSIM serves
+// but one bus.
+static	MEMSIM		*satahost_mem = NULL;
+static	uint32_t	satahost_base = 0, satahost_next = 0;
+
+void	*satahost_malloc(size_t nbytes) {
+	// {{{
+	assert(satahost_mem != NULL);
+
+	nbytes = (nbytes + 31) & ~(size_t)31;
+	if (satahost_next < satahost_base
+			|| satahost_next - satahost_base < nbytes) {
+		fprintf(stderr, "ERR: Out of DMA memory, allocating %lu bytes\n",
+			(unsigned long)nbytes);
+		exit(EXIT_FAILURE);
+	}
+
+	satahost_next -= nbytes;
+	return (char *)satahost_mem->m_mem + satahost_next;
+}
+// }}}
+
+uint32_t	satahost_busaddr(const volatile void *ptr) {
+	// {{{
+	const volatile char	*base = (const volatile char *)satahost_mem->m_mem;
+	const volatile char	*p    = (const volatile char *)ptr;
+
+	if (p < base || p >= base + satahost_mem->m_len * sizeof(MEMSIM::BUSW)) {
+		fprintf(stderr, "ERR: %p is not in DMA memory\n", (const void *)ptr);
+		exit(EXIT_FAILURE);
+	}
+
+	return (uint32_t)(p - base);
+}
+// }}}
+// }}}
+
+// Lockstep simulation
+// {{{
+// Ticks whichever controller is furthest behind.  Register accesses tick
+// only their own controller, so this is how the others catch up.
+void	satahost_tick(void) {
+	// {{{
+	SATATB	*tb = NULL;
+
+	for(auto t : satahost_tbs)
+		if (NULL == tb || t->get_time_ps() < tb->get_time_ps())
+			tb = t;
+
+	if (tb)
+		tb->tick();
+}
+// }}}
+
+static	bool	satahost_any_int(void) {
+	for(auto t : satahost_tbs)
+		if (t->core()->o_int)
+			return true;
+	return false;
+}
+
+void	satahost_wait_any(void) {
+	// {{{
+	uint64_t	deadline;
+
+	if (satahost_tbs.empty() || satahost_any_int())
+		return;
+
+	deadline = satahost_tbs[0]->get_time_ps() + SATAHOST_TIMEOUT_PS;
+	while(!satahost_any_int()) {
+		if (satahost_tbs[0]->done()
+				|| satahost_tbs[0]->get_time_ps() >= deadline) {
+			fprintf(stderr, "ERR: Timeout waiting on the controllers\n");
+			exit(EXIT_FAILURE);
+		} satahost_tick();
+	}
+}
+// }}}
+// }}}
+
+// SATATBHOST: Register reads and writes become Wishbone transactions
+// {{{
+class	SATATBHOST : public SATAHOST {
+	SATATB	*m_tb;
+public:
+	SATATBHOST(SATATB *tb) : m_tb(tb) {}
+
+	uint32_t	readio(unsigned addr) { return m_tb->wb_read(addr); }
+	void		writeio(unsigned addr, uint32_t v) {
+		m_tb->wb_write(addr, v);
+	}
+
+	void	wait_int(void) {
+		uint64_t	deadline;
+
+		if (m_tb->core()->o_int)
+			return;
+		if (satahost_tbs.size() <= 1) {
+			if (!m_tb->tick_until(SATATB::int_asserted,
+						SATAHOST_TIMEOUT_PS))
+				timeout();
+			return;
+		}
+
+		// Keep every other controller moving while we wait
+		deadline = m_tb->get_time_ps() + SATAHOST_TIMEOUT_PS;
+		while(!m_tb->core()->o_int) {
+			if (m_tb->done() || m_tb->get_time_ps() >= deadline)
+				timeout();
+			satahost_tick();
+		}
+	}
+
+	void	timeout(void) {
+		fprintf(stderr, "ERR: Timeout waiting on the controller\n");
+		exit(EXIT_FAILURE);
+	}
+};
+// }}}
+
+SATA	*satahost_attach(SATATB *tb, uint32_t membase) {
+	// {{{
+	const uint32_t	memtop = tb->m_mem->m_len * sizeof(MEMSIM::BUSW);
+
+	if (NULL == satahost_mem) {
+		satahost_mem  = tb->m_mem;
+		satahost_next = memtop;
+	} else if (satahost_mem != tb->m_mem) {
+		// A second mapping of the same segment will do
+		assert(satahost_mem->shared() && tb->m_mem->shared());
+		assert(0 == strcmp(satahost_mem->m_shname, tb->m_mem->m_shname));
+		assert(satahost_mem->m_len == tb->m_mem->m_len);
+	}
+
+	assert(membase < memtop && (membase & 31) == 0);
+	if (membase > satahost_base)
+		satahost_base = membase;
+
+	satahost_tbs.push_back(tb);
+	return new SATA(new SATATBHOST(tb));
+}
+// }}}
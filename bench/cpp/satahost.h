@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/satahost.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Allows the software driver, sw/satadrv.c, to be built for and
+//		run on the host, against the Verilated controller.  Build the
+//	driver as C++, with SATA_HOST defined.  sw/satadrv.h will then include
+//	this file in place of its register definitions.
+//
+//	Each register of the SATA structure becomes a proxy.  Reading it
+//	issues a Wishbone read to the controller, writing it a Wishbone
+//	write, through a SATAHOST bridge.  Pointers written to the address
+//	registers are converted into bus addresses on the way.
+//
+//	DMA memory must come from satahost_malloc(), which hands out memory
+//	from within the simulated (MEMSIM) memory, so that the driver and the
+//	controller both see the same bytes.  Everything else the driver
+//	allocates comes from the regular heap.
+//
+//	Rather than poll, SATA_WAIT_INT() runs the simulation until the
+//	controller raises its interrupt, and then calls sata_isr().
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SATAHOST_H
+#define	SATAHOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class	SATATB;
+
+// SATAHOST: the bridge from the driver's registers to the controller
+// {{{
+class	SATAHOST {
+public:
+	virtual	~SATAHOST(void) {}
+	virtual	uint32_t	readio(unsigned addr) = 0;
+	virtual	void		writeio(unsigned addr, uint32_t v) = 0;
+	// Return once the interrupt is high
+	virtual	void		wait_int(void) = 0;
+};
+// }}}
+
+// DMA memory
+// {{{
+// satahost_malloc() returns memory the controller can reach, aligned to 32
+// bytes.  It is never freed.  satahost_busaddr() returns the (byte) address
+// the controller knows any such memory by.
+extern	void		*satahost_malloc(size_t nbytes);
+extern	uint32_t	satahost_busaddr(const volatile void *ptr);
+// }}}
+
+// Register proxies
+// {{{
+class	SATAREG {
+	SATAHOST	*m_host;
+	unsigned	m_addr;
+public:
+	SATAREG(SATAHOST *host, unsigned addr) : m_host(host), m_addr(addr) {}
+	SATAREG(const SATAREG &) = delete;
+
+	operator uint32_t() const { return m_host->readio(m_addr); }
+	SATAREG &operator=(uint32_t v) {
+		m_host->writeio(m_addr, v); return *this;
+	}
+};
+
+// An address register.  The controller's addresses are 32-bits, no matter
+// how wide the host's pointers are.
+class	SATAPTR {
+	SATAHOST	*m_host;
+	unsigned	m_addr;
+public:
+	SATAPTR(SATAHOST *host, unsigned addr) : m_host(host), m_addr(addr) {}
+	SATAPTR(const SATAPTR &) = delete;
+
+	operator uint32_t() const { return m_host->readio(m_addr); }
+	SATAPTR &operator=(const volatile void *ptr) {
+		m_host->writeio(m_addr, satahost_busaddr(ptr)); return *this;
+	}
+};
+
+typedef	struct	SATA_S {
+	SATAHOST	*s_host;
+	SATAREG	s_cmd, s_lbalo, s_lbahi, s_count;
+	SATAREG	s_perf, s_phy;
+	SATAPTR	s_dma;
+	SATAREG	s_unused_tail;
+	// Command queue
+	SATAREG	s_qctrl;
+	SATAPTR	s_sqbase, s_cqbase;
+	SATAREG	s_sqdoorbell, s_cqdoorbell;
+	SATAREG	s_qintr, s_qistat, s_qunused;
+
+	SATA_S(SATAHOST *host) : s_host(host),
+		s_cmd(host, 0), s_lbalo(host, 1), s_lbahi(host, 2),
+		s_count(host, 3), s_perf(host, 4), s_phy(host, 5),
+		s_dma(host, 6), s_unused_tail(host, 7),
+		s_qctrl(host, 8), s_sqbase(host, 9), s_cqbase(host, 10),
+		s_sqdoorbell(host, 11), s_cqdoorbell(host, 12),
+		s_qintr(host, 13), s_qistat(host, 14), s_qunused(host, 15) {}
+	~SATA_S(void) { delete s_host; }
+} SATA;
+// }}}
+
+// Connect a driver to the controller within tb.  DMA memory will be handed
+// out from tb's memory, from byte address membase upwards.  Free with delete
+// once done.
+extern	SATA	*satahost_attach(SATATB *tb, uint32_t membase);
+
+// With several controllers attached, these keep them all in step.
+// satahost_tick() ticks whichever has fallen furthest behind, and
+// satahost_wait_any() ticks them until any one interrupts.
+extern	void	satahost_tick(void);
+extern	void	satahost_wait_any(void);
+
+// Driver hooks
+// {{{
+#define	SATA_DMA_MALLOC(N)	satahost_malloc(N)
+#define	SATA_BUSADDR(P)		satahost_busaddr(P)
+#define	SATA_CACHE_POOL		((SATACACHE *)satahost_malloc(sizeof(SATACACHE)))
+#define	SATA_WAIT_INT(DEV)	((DEV)->d_dev->s_host->wait_int(), sata_isr(DEV))
+#define	SATA_STRIPE_WAIT(SET)	(satahost_wait_any(), sata_stripe_poll(SET))
+// }}}
+#endif
@@ -0,0 +1,265 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/sataraid.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A test, and throughput benchmark, of the striping (RAID-0)
+//		layer, sw/satastripe.c.  Several Verilated controllers are
+//	built, each with its own SATASIM and in-memory disk, and each with its
+//	own instance of the software driver.  All of their DMA engines reach
+//	the same memory, by mapping the same named shared memory segment.  The
+//	controllers are then striped together, and the set is written from
+//	one end to the other, read back, and checked.  A run of random
+//	transfers follows, checked against a copy of what the set should
+//	hold.  Finally, every drive is checked for the stripes it should
+//	hold.
+//
+//	Throughput is reported in simulated time and in wall clock time,
+//	together with how many commands each drive saw.  Run it once with a
+//	single drive (-n 1) to see how much striping gains.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <vector>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "satatb.h"
+#include "satadrv.h"
+#include "satastripe.h"
+#include "benchutil.h"
+
+// The size of the (shared) DMA memory.  Each driver takes its rings from
+// it, and the test its one buffer.
+static	const unsigned	RAID_MEMSIZE = 8*1024*1024;
+static	const unsigned	RAID_MAXDRIVES = 8;
+
+// The simulation has gotten as far as its slowest controller
+static	uint64_t	sim_time_ps(std::vector<SATATB *> &tbs) {
+	uint64_t	t = 0;
+
+	for(auto tb : tbs)
+		if (0 == t || tb->get_time_ps() < t)
+			t = tb->get_time_ps();
+	return t;
+}
+
+void	usage(void) {
+	fprintf(stderr, "USAGE: sataraid [-v] [-n <drives>] [-s <sectors>] [-c <sectors>] [-d <sectors>] [-r <transfers>]\n"
+"\n"
+"\t-n <drives>\tThe number of drives (and controllers).  (Default: 4)\n"
+"\t-s <sectors>\tThe stripe size.  (Default: 64)\n"
+"\t-c <sectors>\tThe size of each transfer.  (Default: 256)\n"
+"\t-d <sectors>\tThe size of each (in-memory) disk.  (Default: 4096)\n"
+"\t-r <transfers>\tThe number of random transfers.  (Default: 64)\n"
+"\t-v\tVerbose.  Leave the simulation's chatter on stdout.\n");
+}
+
+int	main(int argc, char **argv) {
+	unsigned	ndrives = 4, stripe = 64, count = 256, nsectors = 4096,
+			nrandom = 64, errors = 0;
+	DWORD		total = 0;
+	uint64_t	start_ps, nbytes = 0;
+	bool		verbose = false;
+	FILE		*rpt = stdout;
+	double		start_wall, sim, wall;
+	char		memname[64], *buf;
+	std::vector<SATATB *>			tbs;
+	std::vector<std::vector<uint8_t> >	disks;
+	std::vector<char>			copy;
+	struct SATADRV_S	*drv[RAID_MAXDRIVES];
+	struct SATASTRIPE_S	*set;
+	int		opt;
+
+	while((opt = getopt(argc, argv, "n:s:c:d:r:vh")) != -1) {
+		switch(opt) {
+		case 'n': ndrives  = atoi(optarg); break;
+		case 's': stripe   = atoi(optarg); break;
+		case 'c': count    = atoi(optarg); break;
+		case 'd': nsectors = atoi(optarg); break;
+		case 'r': nrandom  = atoi(optarg); break;
+		case 'v': verbose = true; break;
+		case 'h': usage(); exit(EXIT_SUCCESS); break;
+		default: usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	if (ndrives < 1 || ndrives > RAID_MAXDRIVES) {
+		fprintf(stderr, "ERR: Between 1 and %u drives, please\n",
+			RAID_MAXDRIVES);
+		exit(EXIT_FAILURE);
+	} if (stripe < 1 || nsectors < stripe) {
+		fprintf(stderr, "ERR: Each drive must hold at least one stripe\n");
+		exit(EXIT_FAILURE);
+	} if (count < 1 || count * 512 > RAID_MEMSIZE / 2) {
+		fprintf(stderr, "ERR: Transfers may be at most %u sectors\n",
+			RAID_MEMSIZE / 1024);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!verbose) {
+		rpt = fdopen(dup(STDOUT_FILENO), "w");
+		if (NULL == rpt || NULL == freopen("/dev/null", "w", stdout)) {
+			fprintf(stderr, "ERR: Cannot redirect stdout\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// One controller per drive, each mapping the same DMA memory
+	// {{{
+	snprintf(memname, sizeof(memname), "/sataraid.%d", (int)getpid());
+	disks.resize(ndrives);
+	for(unsigned k=0; k<ndrives; k++) {
+		SATATB	*tb = new SATATB(memname, RAID_MEMSIZE);
+
+		disks[k].resize((size_t)nsectors * 512, 0);
+		tb->m_sata->attach_disk(disks[k].data(), nsectors);
+		tbs.push_back(tb);
+	}
+
+	for(auto tb : tbs) {
+		tb->reset_controller();
+		tb->wait_while_link_ready();
+		tb->wait(1000);
+	}
+
+	for(unsigned k=0; k<ndrives; k++) {
+		drv[k] = sata_init(satahost_attach(tbs[k], 0));
+		if (NULL == drv[k]) {
+			fprintf(rpt, "ERR: sata_init failed, drive %u\n", k);
+			exit(EXIT_FAILURE);
+		}
+	}
+	// }}}
+
+	set = sata_stripe_init(drv, ndrives, stripe);
+	if (NULL == set || RES_OK != sata_stripe_ioctl(set, GET_SECTOR_COUNT,
+							(char *)&total)
+			|| total < count) {
+		fprintf(rpt, "ERR: Could not build the stripe set\n");
+		exit(EXIT_FAILURE);
+	}
+
+	buf = (char *)satahost_malloc(count * 512);
+	copy.resize((size_t)total * 512, 0);
+
+	start_ps   = sim_time_ps(tbs);
+	start_wall = wall_now();
+
+	// Sequential: write the whole set, then read it all back
+	// {{{
+	for(unsigned s=0; s<total; s += count) {
+		unsigned n = (total - s < count) ? total - s : count;
+
+		fill(buf, n * 512);
+		if (RES_OK != sata_stripe_write(set, s, n, buf))
+			errors++;
+		memcpy(&copy[(size_t)s * 512], buf, n * 512);
+		nbytes += n * 512;
+	}
+
+	for(unsigned s=0; s<total; s += count) {
+		unsigned n = (total - s < count) ? total - s : count;
+
+		if (RES_OK != sata_stripe_read(set, s, n, buf)
+			|| 0 != memcmp(buf, &copy[(size_t)s * 512], n * 512)) {
+			fprintf(rpt, "ERR: Sectors %u-%u don't match\n",
+				s, s + n - 1);
+			errors++;
+		} nbytes += n * 512;
+	}
+	// }}}
+
+	// Random: any length, anywhere, so the pieces land mid-stripe
+	// {{{
+	for(unsigned k=0; k<nrandom; k++) {
+		unsigned	r = xrand(),
+				n = 1 + (xrand() % count),
+				s = xrand() % (total - n + 1);
+
+		if (r & 1) {
+			fill(buf, n * 512);
+			if (RES_OK != sata_stripe_write(set, s, n, buf))
+				errors++;
+			memcpy(&copy[(size_t)s * 512], buf, n * 512);
+		} else if (RES_OK != sata_stripe_read(set, s, n, buf)
+			|| 0 != memcmp(buf, &copy[(size_t)s * 512], n * 512)) {
+			fprintf(rpt, "ERR: Sectors %u-%u don't match\n",
+				s, s + n - 1);
+			errors++;
+		} nbytes += n * 512;
+	}
+	// }}}
+
+	if (RES_OK != sata_stripe_ioctl(set, CTRL_SYNC, NULL))
+		errors++;
+	sim  = (sim_time_ps(tbs) - start_ps) * 1e-12;
+	wall = wall_now() - start_wall;
+
+	// Every stripe must have landed on the right drive
+	// {{{
+	for(unsigned s=0; s<total; s += stripe) {
+		unsigned	n = s / stripe,
+				d = n % ndrives,
+				lba = (n / ndrives) * stripe;
+
+		if (0 != memcmp(&disks[d][(size_t)lba * 512],
+				&copy[(size_t)s * 512], stripe * 512)) {
+			fprintf(rpt, "ERR: Stripe %u doesn't match drive %u\n",
+				n, d);
+			errors++;
+		}
+	}
+	// }}}
+
+	fprintf(rpt, "%u drives, %u sector stripes, %lu bytes, %8.3f ms simulated (%7.2f MB/s), %8.2f s wall (%7.2f kB/s)\n",
+		ndrives, stripe, (unsigned long)nbytes, sim * 1e3,
+		(sim > 0) ? nbytes / sim / 1e6 : 0.0,
+		wall, (wall > 0) ? nbytes / wall / 1e3 : 0.0);
+	for(unsigned k=0; k<ndrives; k++) {
+		fprintf(rpt, "Drive %u: ", k);
+		tbs[k]->m_sata->report(rpt);
+		delete tbs[k];
+	}
+	shm_unlink(memname);
+
+	fprintf(rpt, "SATARAID: %s\n", (0 == errors) ? "SUCCESS" : "FAILED");
+	fflush(rpt);
+	return (0 == errors) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
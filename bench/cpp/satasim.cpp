@@ -46,15 +46,46 @@ SATASIM::SATASIM() {
     
     // Initialize scrambler and CRC
     m_crc_matched = false;
+    m_crc_error = false;
     m_scrambler_fill = SCRAMBLER_INITIAL;
     m_crc = CRC_INITIAL;
     
     // Initialize data buffer
+    m_h2d = false;
+    m_fis_words = 0;
     m_lba = 0;
+    m_count = 0;
+    m_ticks = 0;
+    m_act_tick = 0;
+    m_act_pending = false;
+    m_act_latency = 0;
+    m_ncmds = m_nsectors = 0;
+    m_nflushes = m_ndsm = m_ntrimmed = 0;
+    m_features = 0;
+
+    // No flash model, and no write cache, until asked for
+    m_wcache_on = false;
+    m_ftl = false;
+    m_ftl_block = m_wcache_sectors = 0;
+    m_ftl_open = m_ftl_next = 0;
+    m_ftl_written = m_ftl_programs = m_ftl_erases = 0;
+    m_flash_until = m_ready_tick = 0;
     m_data_complete = false;
     reset_data_buffer();
     memset(m_received_data, 0, sizeof(m_received_data));
     m_sent_data = nullptr;
+
+    // No disk, until one is attached
+    m_disk = nullptr;
+    m_disk_sectors = 0;
+    m_command = 0;
+    m_devreg = 0;
+    m_rx_data = false;
+    m_xfer_err = false;
+    m_xfer_words = m_xfer_done = 0;
+    m_fis_len = SATA_SECTOR_SIZE/4;
+    m_identify = false;
+    build_identify();
 }
 
 // Destructor
@@ -323,17 +354,28 @@ void SATASIM::device_link_receives() {
             raw_data = scramble_data(swap_endian(m_txphy_data));
             fis_type = (raw_data >> 16) & 0xFF;
             cmd_type = (raw_data & 0xFF);
-            m_lba = (raw_data >> 8) & 0xFF;
+            m_h2d = (cmd_type == FIS_TYPE_REG_H2D);
+            m_rx_data = (cmd_type == FIS_TYPE_DATA);
+            if (m_h2d) {
+                m_command = fis_type;
+                m_features = raw_data >> 24;
+            }
+            m_fis_words = 1;
             m_data_count++;
             
             // Calculate expected CRC
             calculate_crc(raw_data);
             
             // Set command flags
-            if (fis_type == FIS_TYPE_DMA_WRITE && cmd_type == FIS_TYPE_REG_H2D) {
+            if ((fis_type == FIS_TYPE_DMA_WRITE
+                    || fis_type == FIS_TYPE_DMA_WRITE_EXT
+                    || fis_type == FIS_TYPE_DSM)
+                    && cmd_type == FIS_TYPE_REG_H2D) {
                 m_dma_act = true;
                 printf("DEVICE: DMA Write command received\n");
-            } else if (fis_type == FIS_TYPE_DMA_READ && cmd_type == FIS_TYPE_REG_H2D) {
+            } else if ((fis_type == FIS_TYPE_DMA_READ
+                    || fis_type == FIS_TYPE_DMA_READ_EXT)
+                    && cmd_type == FIS_TYPE_REG_H2D) {
                 m_dma_read = true;
                 printf("DEVICE: DMA Read command received\n");
             } else if (fis_type == FIS_TYPE_PIO_WRITE_BUFFER && cmd_type == FIS_TYPE_REG_H2D) {
@@ -343,6 +385,11 @@ void SATASIM::device_link_receives() {
                 m_pio_setup = true;
                 m_pio_read = true;
                 printf("DEVICE: PIO Read command received\n");
+            } else if (fis_type == FIS_TYPE_IDENTIFY && cmd_type == FIS_TYPE_REG_H2D) {
+                m_pio_setup = true;
+                m_pio_read = true;
+                m_identify = true;
+                printf("DEVICE: IDENTIFY DEVICE command received\n");
             } else if (cmd_type == FIS_TYPE_DATA) {
                 m_data_response = true;
                 printf("DEVICE: Data command received\n");
@@ -354,10 +401,30 @@ void SATASIM::device_link_receives() {
             
             if (m_crc_matched)
                 printf("DEVICE: CRC validation successful\n");
+
+            // Capture the LBA and count from a register FIS
+            if (m_h2d) {
+                if (m_fis_words == 1) {
+                    m_lba = raw_data & 0x0ffffff;
+                    m_devreg = raw_data >> 24;
+                } else if (m_fis_words == 2)
+                    m_lba |= (uint64_t)(raw_data & 0x0ffffff) << 24;
+                else if (m_fis_words == 3) {
+                    m_count = raw_data & 0x0ffff;
+                    start_command();
+                }
+            }
+            m_fis_words++;
             
-            // Store the data word
-            if (!m_crc_matched && m_data_response) {
+            // Store the data word.  A little endian controller sends the
+            // bytes in memory order, so they're kept as they arrived
+            if (!m_crc_matched && m_data_response
+                    && m_data_count <= MAX_DATA_WORDS) {
+#ifdef  SATA_LITTLE_ENDIAN
+                m_received_data[m_data_count-1] = raw_data;
+#else
                 m_received_data[m_data_count-1] = swap_endian(raw_data);
+#endif
                 m_data_count++;
             }
         }
@@ -434,6 +501,8 @@ void SATASIM::dma_activate() {
         m_data_count++;
     } else if (m_data_count == 2) {
         m_dma_act = false;
+        m_act_tick = m_ticks;
+        m_act_pending = true;
         device_link_sends(0, true);
         m_link_state = SEND_EOF;
         printf("DEVICE: Link state -> SEND_EOF\n");
@@ -457,24 +526,53 @@ void SATASIM::pio_setup_response() {
 
 void SATASIM::data_send() {
     if (m_data_count == 0) {
+        // Reads from a disk go out in DATA FISs of up to 2kB, the same
+        // size the controller uses for writes
+        m_fis_len = SATA_SECTOR_SIZE/4;
+        if (m_disk && m_dma_read)
+            m_fis_len = (m_xfer_words - m_xfer_done < MAX_DATA_WORDS)
+                ? m_xfer_words - m_xfer_done : MAX_DATA_WORDS;
         device_phy_sends(SOF_P, true);
         m_data_count++;
     } else if (m_data_count == 1) {
         device_link_sends(DATA_FIS_RESPONSE[0], false);
         m_data_count++;
-    } else if (m_data_count == (SATA_SECTOR_SIZE/4)+2) {
-        m_dma_read = false;
-        m_pio_read = false;
-        m_data_response = true;
+    } else if (m_data_count == m_fis_len+2) {
+        if (!m_disk || !m_dma_read || m_xfer_done >= m_xfer_words) {
+            m_dma_read = false;
+            m_pio_read = false;
+            m_identify = false;
+            m_data_response = true;
+        } // else there's another DATA FIS to follow this one
+        if (m_crc_error) {
+            m_crc ^= 1;
+            m_crc_error = false;
+            printf("DEVICE: Sending a bad CRC\n");
+        }
         device_link_sends(0, true);
         m_link_state = SEND_EOF;
         printf("DEVICE: Link state -> SEND_EOF\n");
     } else {
-        device_link_sends(m_sent_data[m_data_count-2], false);
+        device_link_sends(next_data_word(m_data_count-2), false);
         m_data_count++;
     }
 }
 
+// The next dword of the DATA FIS being sent
+uint32_t SATASIM::next_data_word(unsigned index) {
+    if (m_identify)
+        return m_identify_data[index];
+    else if (m_disk && m_dma_read) {
+        uint32_t word;
+
+        // Dwords go out least significant byte first, so on a little
+        // endian host the disk's bytes may be taken as they are
+        memcpy(&word, &m_disk[(m_lba * SATA_SECTOR_SIZE) + 4*m_xfer_done++],
+                sizeof(word));
+        return word;
+    } return m_sent_data[index];
+}
+
 void SATASIM::d2h_response() {
     if (m_data_count == 0) {
         device_phy_sends(SOF_P, true);
@@ -485,6 +583,10 @@ void SATASIM::d2h_response() {
             device_link_sends(0, true); // Data is not important here
             m_link_state = SEND_EOF;
             printf("DEVICE: Link state -> SEND_EOF\n");
+        } else if (m_data_count == 1 && m_xfer_err) {
+            // ERR status, with IDNF (ID not found) in the error register
+            device_link_sends(0x10510034, false);
+            m_data_count++;
         } else {
             device_link_sends(D2H_REG_FIS_RESPONSE[m_data_count-1], false);
             m_data_count++;
@@ -492,10 +594,321 @@ void SATASIM::d2h_response() {
     }
 }
 
+// Attach a disk image
+void SATASIM::attach_disk(uint8_t *img, uint64_t nsectors) {
+    m_disk = img;
+    m_disk_sectors = (img) ? nsectors : 0;
+    build_identify();
+}
+
+// Called once the LBA and count of a command have arrived.  With a disk
+// attached, this sets up the data transfer, or fails the command should it
+// reach beyond the end of the disk.
+void SATASIM::start_command() {
+    const bool ext = (m_command == FIS_TYPE_DMA_READ_EXT
+                || m_command == FIS_TYPE_DMA_WRITE_EXT
+                || m_command == FIS_TYPE_DSM);
+    uint64_t count;
+
+    // 28-bit commands keep LBA[27:24] in the device register, and have an
+    // 8-bit count
+    if (!ext && m_command != FIS_TYPE_IDENTIFY)
+        m_lba = (m_lba & 0x0ffffff) | ((uint64_t)(m_devreg & 0x0f) << 24);
+    if (ext)
+        count = (m_count == 0) ? 65536 : m_count;
+    else
+        count = ((m_count & 0x0ff) == 0) ? 256 : (m_count & 0x0ff);
+
+    // DATA SET MANAGEMENT counts 512 byte blocks of ranges, not sectors
+    if (m_command == FIS_TYPE_DSM)
+        m_ndsm++;
+    else if (m_dma_act || m_dma_read || m_pio_setup) {
+        m_ncmds++;
+        m_nsectors += count;
+    }
+
+    m_xfer_err = false;
+    m_xfer_words = count * (SATA_SECTOR_SIZE/4);
+    m_xfer_done = 0;
+    m_ready_tick = 0;
+
+    if (!m_dma_act && !m_dma_read && !m_pio_setup) {
+        // A non-data command.  Answer it with a register FIS, once done.
+        if (m_command == FIS_TYPE_FLUSH || m_command == FIS_TYPE_FLUSH_EXT) {
+            // Wait for the flash to catch up with the write cache
+            m_nflushes++;
+            m_ready_tick = m_flash_until;
+        } else if (m_command == FIS_TYPE_SET_FEATURES && m_wcache_sectors
+                && (m_features == SETFEATURES_WC_ON
+                    || m_features == SETFEATURES_WC_OFF)) {
+            // Turning the cache off writes it back first
+            m_wcache_on = (m_features == SETFEATURES_WC_ON);
+            if (!m_wcache_on)
+                m_ready_tick = m_flash_until;
+            build_identify();
+        }
+        m_data_response = true;
+        return;
+    }
+
+    if (!m_disk || (!m_dma_act && !m_dma_read) || m_command == FIS_TYPE_DSM)
+        return;
+    if (m_lba >= m_disk_sectors || count > m_disk_sectors - m_lba) {
+        printf("DEVICE: LBA %llu + %llu is beyond the end of the disk\n",
+            (unsigned long long)m_lba, (unsigned long long)count);
+        m_xfer_err = true;
+        m_dma_act = false;
+        m_dma_read = false;
+        m_data_response = true;
+    }
+}
+
+// Write the DATA FIS just received to the disk, or trim the ranges it
+// holds, and ask for the next one
+void SATASIM::commit_write() {
+    uint64_t nwords = m_data_count - 1;
+
+    if (m_command != FIS_TYPE_DMA_WRITE && m_command != FIS_TYPE_DMA_WRITE_EXT
+            && m_command != FIS_TYPE_DSM)
+        return;
+    if (nwords > m_xfer_words - m_xfer_done)
+        nwords = m_xfer_words - m_xfer_done;
+
+    if (m_command == FIS_TYPE_DSM) {
+        if (m_features & DSM_TRIM)
+            trim(m_received_data, nwords);
+    } else {
+        const uint64_t first = m_lba + m_xfer_done / (SATA_SECTOR_SIZE/4);
+        uint64_t cost = 0;
+
+        memcpy(&m_disk[m_lba * SATA_SECTOR_SIZE + 4*m_xfer_done],
+                m_received_data, nwords * sizeof(uint32_t));
+
+        // Hand every whole sector to the flash
+        if (m_ftl) {
+            const uint64_t last = m_lba
+                    + (m_xfer_done + nwords) / (SATA_SECTOR_SIZE/4);
+
+            for (uint64_t lba = first; lba < last; lba++)
+                cost += ftl_write(lba);
+            if (m_flash_until < m_ticks)
+                m_flash_until = m_ticks;
+            m_flash_until += cost;
+        }
+    }
+
+    m_xfer_done += nwords;
+    if (m_xfer_done >= m_xfer_words && m_ftl
+            && m_command != FIS_TYPE_DSM) {
+        // The command completes once whatever the cache can't hold is
+        // in the flash
+        const uint64_t room = (m_wcache_on)
+                ? (uint64_t)m_wcache_sectors * SATASIM_PROG_TICKS : 0;
+
+        m_ready_tick = (m_flash_until > room) ? m_flash_until - room : 0;
+    }
+
+    if (m_xfer_done < m_xfer_words) {
+        // Ask for the next DATA FIS, rather than ending the command
+        m_dma_act = true;
+        m_data_response = false;
+    }
+}
+
+// Trim the ranges within (part of) a DATA SET MANAGEMENT payload.  Each
+// range is eight bytes: a 48-bit LBA, then a 16-bit count, where a count of
+// zero means the entry is unused.  Trimmed sectors read back as zeros.
+void SATASIM::trim(const uint32_t *entries, unsigned nwords) {
+    for (unsigned k = 0; k + 1 < nwords; k += 2) {
+        const uint64_t lba = entries[k]
+                | ((uint64_t)(entries[k+1] & 0x0ffff) << 32);
+        const unsigned count = entries[k+1] >> 16;
+
+        if (count == 0)
+            continue;
+        if (m_disk && (lba >= m_disk_sectors
+                || count > m_disk_sectors - lba)) {
+            printf("DEVICE: TRIM of LBA %llu + %u is beyond the end of the disk\n",
+                (unsigned long long)lba, count);
+            m_xfer_err = true;
+            continue;
+        }
+
+        m_ntrimmed += count;
+        if (!m_disk)
+            continue;
+        memset(&m_disk[lba * SATA_SECTOR_SIZE], 0,
+                (size_t)count * SATA_SECTOR_SIZE);
+        if (m_ftl)
+            for (unsigned j = 0; j < count; j++)
+                ftl_trim(lba + j);
+    }
+}
+
+// Set up the flash model, empty
+void SATASIM::ftl(unsigned block_sectors, unsigned spare_blocks,
+        unsigned wcache_sectors) {
+    uint32_t nblocks;
+
+    assert(m_disk && block_sectors > 0);
+    // Collection needs its reserve, plus the open block, plus at least
+    // one more, so that some block always has a stale sector to reclaim
+    if (spare_blocks < SATASIM_FTL_RESERVE + 2)
+        spare_blocks = SATASIM_FTL_RESERVE + 2;
+
+    nblocks = (m_disk_sectors + block_sectors - 1) / block_sectors
+            + spare_blocks;
+    m_ftl = true;
+    m_ftl_block = block_sectors;
+    m_wcache_sectors = wcache_sectors;
+    m_wcache_on = false;
+    m_ftl_l2p.assign(m_disk_sectors, UINT32_MAX);
+    m_ftl_p2l.assign((size_t)nblocks * block_sectors, UINT32_MAX);
+    m_ftl_valid.assign(nblocks, 0);
+    m_ftl_isfree.assign(nblocks, true);
+    m_ftl_free.clear();
+    for (uint32_t b = 1; b < nblocks; b++)
+        m_ftl_free.push_back(b);
+    m_ftl_isfree[0] = false;
+    m_ftl_open = 0;
+    m_ftl_next = 0;
+    m_ftl_written = m_ftl_programs = m_ftl_erases = 0;
+    m_flash_until = 0;
+    build_identify();
+}
+
+// Program a sector into the next page of the open block, opening another
+// block if need be.  Returns the time it took.
+uint64_t SATASIM::ftl_append(uint32_t lba) {
+    uint32_t page;
+
+    if (m_ftl_next >= m_ftl_block) {
+        assert(!m_ftl_free.empty());
+        m_ftl_open = m_ftl_free.front();
+        m_ftl_free.pop_front();
+        m_ftl_isfree[m_ftl_open] = false;
+        m_ftl_next = 0;
+    }
+
+    page = m_ftl_open * m_ftl_block + m_ftl_next++;
+    m_ftl_p2l[page] = lba;
+    m_ftl_l2p[lba] = page;
+    m_ftl_valid[m_ftl_open]++;
+    m_ftl_programs++;
+
+    return SATASIM_PROG_TICKS;
+}
+
+// Greedy garbage collection: copy the live sectors out of whichever block
+// has the fewest, and erase it, until enough blocks are free
+uint64_t SATASIM::ftl_collect(void) {
+    uint64_t cost = 0;
+
+    while (m_ftl_free.size() < SATASIM_FTL_RESERVE) {
+        uint32_t victim = UINT32_MAX;
+
+        for (uint32_t b = 0; b < m_ftl_valid.size(); b++) {
+            if (b == m_ftl_open || m_ftl_isfree[b])
+                continue;
+            if (victim == UINT32_MAX || m_ftl_valid[b] < m_ftl_valid[victim])
+                victim = b;
+        }
+        assert(victim != UINT32_MAX && m_ftl_valid[victim] < m_ftl_block);
+
+        for (uint32_t k = 0; k < m_ftl_block; k++) {
+            const uint32_t page = victim * m_ftl_block + k,
+                    lba = m_ftl_p2l[page];
+
+            if (lba == UINT32_MAX)
+                continue;
+            m_ftl_p2l[page] = UINT32_MAX;
+            m_ftl_valid[victim]--;
+            cost += SATASIM_READ_TICKS + ftl_append(lba);
+        }
+
+        cost += SATASIM_ERASE_TICKS;
+        m_ftl_erases++;
+        m_ftl_isfree[victim] = true;
+        m_ftl_free.push_back(victim);
+    }
+
+    return cost;
+}
+
+// A sector written by the host.  Returns the time the flash spends on it,
+// including any garbage collection it sets off.
+uint64_t SATASIM::ftl_write(uint32_t lba) {
+    uint64_t cost = 0;
+
+    ftl_trim(lba);
+    if (m_ftl_next >= m_ftl_block)
+        cost += ftl_collect();
+    m_ftl_written++;
+
+    return cost + ftl_append(lba);
+}
+
+// Mark a sector's copy in the flash as stale
+void SATASIM::ftl_trim(uint32_t lba) {
+    const uint32_t page = m_ftl_l2p[lba];
+
+    if (page == UINT32_MAX)
+        return;
+    m_ftl_p2l[page] = UINT32_MAX;
+    m_ftl_valid[page / m_ftl_block]--;
+    m_ftl_l2p[lba] = UINT32_MAX;
+}
+
+// Build the IDENTIFY DEVICE data, from the size of the disk
+void SATASIM::build_identify() {
+    uint16_t id[SATA_SECTOR_SIZE/2];
+    const uint64_t nsectors = m_disk_sectors;
+    const uint32_t lba28 = (nsectors > 0x0fffffff) ? 0x0fffffff : nsectors;
+
+    memset(id, 0, sizeof(id));
+
+    // ATA strings hold two characters per word, the first in the MSB
+    auto ata_string = [&id](unsigned word, unsigned nwords, const char *str) {
+        for (unsigned k = 0; k < 2*nwords; k++) {
+            uint16_t ch = (*str) ? *str++ : ' ';
+
+            id[word + k/2] |= (k & 1) ? ch : (ch << 8);
+        }
+    };
+
+    id[0] = 0x0040;                     // Fixed device
+    ata_string(10, 10, "WBSATA0001");   // Serial number
+    ata_string(23, 4, "1.0");           // Firmware revision
+    ata_string(27, 20, "WBSATA SATASIM Simulated Drive");
+    id[49] = 0x0300;                    // LBA and DMA supported
+    id[53] = 0x0006;                    // Words 64-70, 88 are valid
+    id[60] = lba28 & 0x0ffff;
+    id[61] = lba28 >> 16;
+    id[69] = 0x4020;                    // Trimmed sectors read as zero
+    id[80] = 0x01f0;                    // ATA8-ACS and earlier
+    id[82] = (m_wcache_sectors) ? 0x0020 : 0;  // Volatile write cache
+    id[83] = 0x7400;                    // 48-bit addressing, FLUSH CACHE (EXT)
+    id[84] = 0x4000;
+    id[85] = (m_wcache_on) ? 0x0020 : 0;
+    id[86] = 0x3400;                    // 48-bit addressing enabled
+    id[87] = 0x4000;
+    id[88] = 0x407f;                    // UDMA 6
+    for (unsigned k = 0; k < 4; k++)
+        id[100 + k] = (nsectors >> (16*k)) & 0x0ffff;
+    id[105] = 8;                        // DSM: up to 8 blocks of ranges
+    id[106] = 0x4000;                   // One logical sector per physical
+    id[169] = 0x0001;                   // DSM TRIM supported
+
+    // Sent as dwords, the first byte in bits [7:0], as with all data
+    for (unsigned k = 0; k < SATA_SECTOR_SIZE/4; k++)
+        m_identify_data[k] = id[2*k] | ((uint32_t)id[2*k+1] << 16);
+}
+
 // Link layer state machine for DMA activation
 LinkState SATASIM::link_layer_model() {
     static int align_cnt = 0;
 
+    m_ticks++;
     if (m_oob_done) {
         // Use a state machine to handle the link layer protocol
         switch (m_link_state) {
@@ -514,8 +927,16 @@ LinkState SATASIM::link_layer_model() {
                 device_phy_sends(SYNC_P, true);
                 // Host asks; if device is ready to accept data
                 if (wait_for_primitive(XRDY_P)) {
+                    if (m_act_pending) {
+                        m_act_latency = m_ticks - m_act_tick;
+                        m_act_pending = false;
+                    }
                     m_link_state = RCV_CHKRDY;
                     printf("DEVICE: Link state -> RCV_CHKRDY\n");
+                } else if (m_data_response && !m_dma_act && !m_dma_read
+                        && !m_pio_setup && !m_pio_read
+                        && m_ticks < m_ready_tick) {
+                    // Still busy with the flash: hold the status back
                 } else if (m_dma_act || m_dma_read || m_pio_setup || m_pio_read || m_data_response) {
                     m_link_state = SEND_CHKRDY;
                     printf("DEVICE: Link state -> SEND_CHKRDY\n");
@@ -579,6 +1000,9 @@ LinkState SATASIM::link_layer_model() {
 
             case RCVEOF:
                 device_phy_sends(R_IP_P, true);
+                if (m_crc_matched && m_rx_data
+                        && (m_disk || m_command == FIS_TYPE_DSM))
+                    commit_write();
                 if (m_crc_matched) {
                     m_link_state = GOODEND;
                     printf("DEVICE: Link state -> GOODEND\n");
@@ -626,3 +1050,20 @@ LinkState SATASIM::link_layer_model() {
 
     return m_link_state;
 }
+
+// Report what the device has been asked to do
+void SATASIM::report(FILE *fp) const {
+    if (m_ncmds > 0)
+        fprintf(fp, "SATA: %lu commands, %lu sectors (%.1f sectors/command)\n",
+            (unsigned long)m_ncmds, (unsigned long)m_nsectors,
+            (double)m_nsectors / m_ncmds);
+    if (m_nflushes > 0 || m_ndsm > 0)
+        fprintf(fp, "SATA: %lu FLUSH CACHE, %lu DSM commands, %lu sectors trimmed\n",
+            (unsigned long)m_nflushes, (unsigned long)m_ndsm,
+            (unsigned long)m_ntrimmed);
+    if (m_ftl)
+        fprintf(fp, "FTL: %lu sectors written, %lu programmed (write amplification %.2f), %lu erases\n",
+            (unsigned long)m_ftl_written, (unsigned long)m_ftl_programs,
+            (m_ftl_written) ? (double)m_ftl_programs / m_ftl_written : 0.0,
+            (unsigned long)m_ftl_erases);
+}
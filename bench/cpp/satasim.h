@@ -1,9 +1,11 @@
 #ifndef SATASIM_H
 #define SATASIM_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <deque>
 
 // SATA sector size in bytes
 #define SATA_SECTOR_SIZE 512
@@ -16,9 +18,61 @@
 #define	SATA_LBALO_ADDR		1
 #define	SATA_LBAHI_ADDR		2
 #define	SATA_COUNT_ADDR		3
+#define	SATA_PERF_ADDR		4
 #define	SATA_PHY_ADDR		5
 #define SATA_DMA_ADDR_LO	6
 #define SATA_DMA_ADDR_HI	7
+#define	SATA_QCTRL_ADDR		8
+#define	SATA_SQBASE_ADDR	9
+#define	SATA_CQBASE_ADDR	10
+#define	SATA_SQDB_ADDR		11
+#define	SATA_CQDB_ADDR		12
+#define	SATA_QINTR_ADDR		13
+#define	SATA_QISTAT_ADDR	14
+
+// SATA_CMD_ADDR bits
+#define	SATA_CMD_ICRC		0x80000000	// Interface CRC error
+#define	SATA_CMD_ERR		0x00010000
+
+// SATA_PHY_ADDR bits
+#define	SATA_PHY_SGMODE		0x0100	// DMA address is a descriptor chain
+
+// Scatter-gather descriptor flags, in the second (length) word
+#define	SATA_SG_LAST		0x80000000
+#define	SATA_SG_LINK		0x40000000
+
+// SATA_PERF_ADDR: writes select a counter (or clear them all), reads
+// return the selected counter and advance to the next
+#define	SATA_PERF_CLEAR		0x80000000
+#define	SATA_PERF_CMDS		0
+#define	SATA_PERF_RDSECTORS	1
+#define	SATA_PERF_WRSECTORS	2
+#define	SATA_PERF_DMABUSY	3	// 64-bits
+#define	SATA_PERF_DMASTALL	5	// 64-bits
+#define	SATA_PERF_LATENCY	7	// 64-bits
+#define	SATA_PERF_MAXLAT	9
+#define	SATA_PERF_RXHWM		10
+#define	SATA_PERF_TXHWM		11
+#define	SATA_PERF_RERR		12
+#define	SATA_PERF_TXFAIL	13
+#define	SATA_PERF_HOLDTX	14
+#define	SATA_PERF_HOLDRX	15
+#define	SATA_PERF_ALIGN		16
+#define	SATA_PERF_RXWAIT	17	// DMA arbitration stalls
+#define	SATA_PERF_TXWAIT	18
+#define	SATA_NPERF		19
+
+// SATA_QCTRL_ADDR bits
+#define	SATA_QCTRL_ENABLE	0x80000000
+#define	SATA_QCTRL_ERR		0x40000000
+#define	SATA_QCTRL_ACTIVE	0x20000000
+
+// SATA_QINTR_ADDR: interrupt moderation, timeout (clocks) and threshold
+#define	SATA_QINTR(CLOCKS, COUNT)	(((CLOCKS) << 8) | ((COUNT) & 0x0ff))
+
+// SATA_QISTAT_ADDR bits
+#define	SATA_QISTAT_INT		0x80000000	// Write 1 to acknowledge
+#define	SATA_QISTAT_TIMEOUT	0x40000000
 
 // SATA Primitives
 #define ALIGN_P     0xBC4A4A7B
@@ -39,8 +93,29 @@
 #define FIS_TYPE_DMA_ACT           0x39
 #define FIS_TYPE_DMA_READ          0xC8
 #define FIS_TYPE_DMA_WRITE         0xCA
+#define FIS_TYPE_DMA_READ_EXT      0x25
+#define FIS_TYPE_DMA_WRITE_EXT     0x35
 #define FIS_TYPE_PIO_READ_BUFFER   0xE4
 #define FIS_TYPE_PIO_WRITE_BUFFER  0xE8
+#define FIS_TYPE_IDENTIFY          0xEC
+#define FIS_TYPE_DSM               0x06
+#define FIS_TYPE_FLUSH             0xE7
+#define FIS_TYPE_FLUSH_EXT         0xEA
+#define FIS_TYPE_SET_FEATURES      0xEF
+
+// DATA SET MANAGEMENT and SET FEATURES, as given in the features register
+#define DSM_TRIM                   0x01
+#define SETFEATURES_WC_ON          0x02
+#define SETFEATURES_WC_OFF         0x82
+
+// Flash timing for the FTL model, in (PHY clock) ticks: to program a
+// sector, to read one back while collecting garbage, and to erase a block.
+// A sector takes 128 ticks to cross the link.
+#define SATASIM_PROG_TICKS         96
+#define SATASIM_READ_TICKS         32
+#define SATASIM_ERASE_TICKS        4096
+// Erase blocks the FTL keeps free, for garbage collection to write into
+#define SATASIM_FTL_RESERVE        2
 
 // Link Layer State Machine States
 enum LinkState {
@@ -151,17 +226,83 @@ private:
     uint64_t scramble_function(uint16_t prior);
     uint32_t advance_crc(uint32_t prior, uint32_t dword);
     
+    // The most recent register FIS received from the controller
+    bool m_h2d;
+    unsigned m_fis_words;
+    uint64_t m_lba;
+    uint32_t m_count;
+    uint8_t m_features;
+
+    // Write latency: clocks from the end of our DMA Activate FIS until
+    // the controller asks to send us the DATA FIS
+    uint64_t m_ticks, m_act_tick;
+    bool m_act_pending;
+    unsigned m_act_latency;
+
+    // Commands received, and the sectors they asked for, to measure how
+    // well the driver merges requests
+    uint64_t m_ncmds, m_nsectors;
+    // FLUSH CACHE and DATA SET MANAGEMENT commands received, and the
+    // sectors the latter trimmed
+    uint64_t m_nflushes, m_ndsm, m_ntrimmed;
+
+    // A volatile write cache, and a (very) simple flash translation layer
+    // behind it.  Both only model time: the data always goes straight to
+    // the disk image.  Sectors are written to the open erase block, in
+    // order, leaving their old copies stale.  Once too few blocks are free,
+    // the block with the fewest live sectors is copied forward and erased.
+    // TRIM marks sectors stale without writing anything, leaving less to
+    // copy.  m_flash_until is the tick the flash will finish everything
+    // it has been given.  With the write cache on, writes complete once
+    // what's left fits in the cache.  Otherwise, as with FLUSH CACHE, they
+    // wait for the flash.
+    bool m_wcache_on;
+    bool m_ftl;
+    unsigned m_ftl_block, m_wcache_sectors;
+    std::vector<uint32_t> m_ftl_l2p, m_ftl_p2l, m_ftl_valid;
+    std::vector<bool> m_ftl_isfree;
+    std::deque<uint32_t> m_ftl_free;
+    uint32_t m_ftl_open, m_ftl_next;
+    uint64_t m_ftl_written, m_ftl_programs, m_ftl_erases;
+    uint64_t m_flash_until, m_ready_tick;
+
+    uint64_t ftl_append(uint32_t lba);
+    uint64_t ftl_collect(void);
+    uint64_t ftl_write(uint32_t lba);
+    void ftl_trim(uint32_t lba);
+    void trim(const uint32_t *entries, unsigned nwords);
+
+    // An attached disk image.  Without one, reads return m_sent_data and
+    // writes are left in m_received_data, a single sector at a time.
+    // With one, commands move data to and from the image, any number of
+    // sectors at a time, and out of range commands fail.
+    uint8_t *m_disk;
+    uint64_t m_disk_sectors;
+    uint8_t m_command;
+    uint8_t m_devreg;
+    bool m_rx_data;         // The frame being received is a DATA FIS
+    bool m_xfer_err;        // The command failed, report it in the D2H FIS
+    uint64_t m_xfer_words, m_xfer_done;
+    unsigned m_fis_len;     // Payload dwords in the DATA FIS being sent
+    bool m_identify;
+    uint32_t m_identify_data[SATA_SECTOR_SIZE/4];
+
+    void start_command();
+    void build_identify();
+    uint32_t next_data_word(unsigned index);
+    void commit_write();
+
     // Data buffer for received data
-    uint32_t m_lba;
     uint32_t m_received_data[MAX_DATA_WORDS];
     uint32_t *m_sent_data;
     size_t m_data_count;
     bool m_crc_matched;
+    bool m_crc_error;	// Corrupt the CRC of the next DATA FIS we send
     bool m_data_complete;
 
     // Responses
     uint32_t D2H_REG_FIS_RESPONSE[4] = {
-		0x00770034,     // FIS TYPE (0x34) | RIRR,PMPORT | STATUS | ERROR
+		0x00500034,     // FIS TYPE (0x34) | RIRR,PMPORT | STATUS (DRDY) | ERROR
 		0x00000000,		// DEVICE | LBA[23:0]
 		0x00000000,		// FEATURES[15:8] | LBA[47:24]
 		0x00000000		// CONTROL | ICC | COUNT[15:0]
@@ -237,6 +378,39 @@ public:
     void set_sent_data(uint32_t* data) { m_sent_data = data; }
     uint32_t get_sent_data(uint32_t index) { return m_sent_data[index]; }
 
+    // Attach a disk image of nsectors sectors, which must remain valid
+    // (e.g. mapped) for as long as the simulation runs.  Each dword
+    // carries four bytes of the image, the first in bits [7:0].
+    void attach_disk(uint8_t *img, uint64_t nsectors);
+    uint64_t disk_sectors() const { return m_disk_sectors; }
+
+    // Model flash behind the disk image: erase blocks of block_sectors
+    // sectors, spare_blocks more of them than the disk needs, and a write
+    // cache of wcache_sectors (none if zero).  The FTL starts out empty,
+    // as a new drive would.  The write cache starts out off, and may be
+    // turned on with SET FEATURES.
+    void ftl(unsigned block_sectors, unsigned spare_blocks,
+            unsigned wcache_sectors);
+
+    // Sectors trimmed by DATA SET MANAGEMENT, and FLUSH CACHE (EXT)
+    // commands seen, so far
+    uint64_t trimmed() const { return m_ntrimmed; }
+    uint64_t flushes() const { return m_nflushes; }
+    bool wcache_on() const { return m_wcache_on; }
+
+    // The LBA and sector count of the last command received
+    uint64_t get_lba() const { return m_lba; }
+    uint32_t get_count() const { return m_count; }
+
+    // Send the next DATA FIS with a bad CRC
+    void inject_crc_error() { m_crc_error = true; }
+
+    // Clocks between our last DMA Activate and the host's DATA FIS
+    unsigned get_activate_latency() const { return m_act_latency; }
+
+    // Commands and sectors seen, and the FTL's write amplification
+    void report(FILE *fp = stdout) const;
+
     // Responses
     void dma_activate();
     void data_send();
@@ -0,0 +1,313 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/satastress.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A multi-threaded stress test, and throughput benchmark, for
+//		the software driver built with SATA_THREADS.  Several threads
+//	share the one driver, on top of the Verilated controller and a
+//	SATASIM holding an in-memory disk.  Each thread owns its own slice of
+//	the disk, and keeps a copy of what that slice should hold.  It then
+//	reads and writes runs of sectors, some following on from its last one
+//	and some at random, and checks every read against its copy.  With -a,
+//	half of its writes are split in two and submitted asynchronously, so
+//	the driver has more to merge.  Once all threads are done, the whole
+//	disk is checked as well.
+//
+//	Throughput is reported in simulated time and in wall clock time,
+//	together with how many commands the drive saw.  Run it once with a
+//	single thread (-t 1) to see how much more the driver merges when
+//	several threads keep it busy.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <vector>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "satatb.h"
+#include "satadrv.h"
+#include "benchutil.h"
+
+// The size of the DMA memory, as given to MEMSIM.  Each thread takes a
+// buffer of its longest transfer from it.
+static	const unsigned	STRESS_MEMSIZE = 4*1024*1024;
+
+static	struct SATADRV_S	*stress_drv = NULL;
+
+// STRESSTHREAD: one client of the driver
+// {{{
+class	STRESSTHREAD {
+	unsigned	m_span, m_maxcount, m_nreqs;
+	uint32_t	m_rand;
+	char		*m_buf;
+	bool		m_async;
+public:
+	unsigned	m_id, m_base;
+	std::vector<char>	m_copy;	// What our slice should hold
+	pthread_t	m_thread;
+	unsigned	m_reads, m_writes, m_errors;
+	uint64_t	m_nbytes;
+
+	STRESSTHREAD(unsigned id, unsigned base, unsigned span,
+			unsigned maxcount, unsigned nreqs, bool async)
+		: m_span(span), m_maxcount(maxcount), m_nreqs(nreqs),
+		m_rand(id * 0x9e3779b9u + 1), m_async(async),
+		m_id(id), m_base(base),
+		m_copy(span * 512, 0), m_thread(0), m_reads(0), m_writes(0),
+		m_errors(0), m_nbytes(0) {
+		// DMA memory must be claimed before any threads start
+		m_buf = (char *)satahost_malloc(maxcount * 512);
+	}
+
+	uint32_t	rand(void) {
+		// xorshift32
+		m_rand ^= m_rand << 13;
+		m_rand ^= m_rand >> 17;
+		m_rand ^= m_rand << 5;
+		return m_rand;
+	}
+
+	// Write count sectors from offset (within our slice), as two
+	// asynchronous requests when split is set
+	bool	write(unsigned offset, unsigned count, bool split) {
+		// {{{
+		char	*buf = m_buf;
+
+		for(unsigned k=0; k<count * 512; k += 4) {
+			uint32_t	v = rand();
+
+			memcpy(&buf[k], &v, 4);
+		}
+
+		if (split && count > 1) {
+			unsigned	half = count / 2;
+			struct SATAREQ_S	*lo, *hi;
+			int		slo, shi;
+
+			while(NULL == (lo = sata_submit_write(stress_drv,
+					m_base + offset, half, buf, NULL, NULL)))
+				sched_yield();
+			while(NULL == (hi = sata_submit_write(stress_drv,
+					m_base + offset + half, count - half,
+					buf + half * 512, NULL, NULL)))
+				sched_yield();
+			slo = sata_wait(stress_drv, lo);
+			shi = sata_wait(stress_drv, hi);
+			if (RES_OK != slo || RES_OK != shi)
+				return false;
+		} else if (RES_OK != sata_write(stress_drv, m_base + offset,
+							count, buf))
+			return false;
+
+		memcpy(&m_copy[offset * 512], buf, count * 512);
+		return true;
+	}
+	// }}}
+
+	bool	read(unsigned offset, unsigned count) {
+		// {{{
+		if (RES_OK != sata_read(stress_drv, m_base + offset, count, m_buf))
+			return false;
+		if (0 != memcmp(m_buf, &m_copy[offset * 512], count * 512)) {
+			fprintf(stderr, "ERR: Thread %u, sectors %u-%u don't match\n",
+				m_id, m_base + offset, m_base + offset + count - 1);
+			return false;
+		} return true;
+	}
+	// }}}
+
+	void	run(void) {
+		// {{{
+		unsigned	next = 0;
+
+		for(unsigned k=0; k<m_nreqs; k++) {
+			unsigned	r = rand(), offset, count;
+			bool		ok;
+
+			// Half of all requests continue where the last left
+			// off, the rest go anywhere in the slice
+			count  = 1 + (rand() % m_maxcount);
+			offset = (r & 1) ? next : (rand() % m_span);
+			if (offset + count > m_span) {
+				offset = 0;
+				if (count > m_span)
+					count = m_span;
+			}
+
+			if (r & 2) {
+				ok = write(offset, count, m_async && (r & 4));
+				m_writes++;
+			} else {
+				ok = read(offset, count);
+				m_reads++;
+			}
+
+			if (!ok)
+				m_errors++;
+			m_nbytes += count * 512;
+			next = offset + count;
+		}
+	}
+	// }}}
+
+	static void *entry(void *arg) {
+		((STRESSTHREAD *)arg)->run();
+		return NULL;
+	}
+};
+// }}}
+
+void	usage(void) {
+	fprintf(stderr, "USAGE: satastress [-av] [-t <threads>] [-n <requests>] [-c <sectors>] [-d <sectors>]\n"
+"\n"
+"\t-t <threads>\tThe number of threads to share the driver.  (Default: 4)\n"
+"\t-n <requests>\tThe number of requests each thread makes.  (Default: 256)\n"
+"\t-c <sectors>\tThe longest request, in sectors.  (Default: 32)\n"
+"\t-d <sectors>\tThe size of the (in-memory) disk.  (Default: 16384)\n"
+"\t-a\tSplit half of all writes into two asynchronous requests.  These\n"
+"\t\tbypass the driver's sector cache, so don't use this with one.\n"
+"\t-v\tVerbose.  Leave the simulation's chatter on stdout.\n");
+}
+
+int	main(int argc, char **argv) {
+	unsigned	nthreads = 4, nreqs = 256, maxcount = 32,
+			nsectors = 16384, errors = 0, span;
+	uint64_t	nbytes = 0, start_ps;
+	bool		verbose = false, async = false;
+	FILE		*rpt = stdout;
+	double		start_wall, sim, wall;
+	std::vector<STRESSTHREAD *>	threads;
+	std::vector<uint8_t>		disk;
+	int		opt;
+
+	while((opt = getopt(argc, argv, "t:n:c:d:avh")) != -1) {
+		switch(opt) {
+		case 't': nthreads = atoi(optarg); break;
+		case 'n': nreqs    = atoi(optarg); break;
+		case 'c': maxcount = atoi(optarg); break;
+		case 'd': nsectors = atoi(optarg); break;
+		case 'a': async = true; break;
+		case 'v': verbose = true; break;
+		case 'h': usage(); exit(EXIT_SUCCESS); break;
+		default: usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	// Each thread holds at most two of the driver's 32 request handles
+	if (nthreads < 1 || nthreads > 16) {
+		fprintf(stderr, "ERR: Between 1 and 16 threads, please\n");
+		exit(EXIT_FAILURE);
+	} if (maxcount < 1 || nsectors / nthreads < maxcount) {
+		fprintf(stderr, "ERR: Each thread needs a slice of at least %u sectors\n", maxcount);
+		exit(EXIT_FAILURE);
+	} span = nsectors / nthreads;
+
+	if (!verbose) {
+		rpt = fdopen(dup(STDOUT_FILENO), "w");
+		if (NULL == rpt || NULL == freopen("/dev/null", "w", stdout)) {
+			fprintf(stderr, "ERR: Cannot redirect stdout\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	SATATB	tb(NULL, STRESS_MEMSIZE);
+
+	disk.resize((size_t)nsectors * 512, 0);
+	tb.m_sata->attach_disk(disk.data(), nsectors);
+
+	tb.reset_controller();
+	tb.wait_while_link_ready();
+	tb.wait(1000);
+
+	stress_drv = sata_init(satahost_attach(&tb, 0));
+	if (NULL == stress_drv) {
+		fprintf(rpt, "ERR: sata_init failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(unsigned k=0; k<nthreads; k++)
+		threads.push_back(new STRESSTHREAD(k, k * span, span,
+						maxcount, nreqs, async));
+
+	// Run them all at once
+	start_ps   = tb.get_time_ps();
+	start_wall = wall_now();
+	for(auto t : threads) {
+		if (0 != pthread_create(&t->m_thread, NULL,
+						STRESSTHREAD::entry, t)) {
+			perror("O/S Err: pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for(auto t : threads)
+		pthread_join(t->m_thread, NULL);
+
+	// Flush any sector cache, before checking the disk
+	if (RES_OK != sata_ioctl(stress_drv, CTRL_SYNC, NULL))
+		errors++;
+	sim  = (tb.get_time_ps() - start_ps) * 1e-12;
+	wall = wall_now() - start_wall;
+
+	for(auto t : threads) {
+		fprintf(rpt, "Thread %2u: %5u reads, %5u writes, %u errors\n",
+			t->m_id, t->m_reads, t->m_writes, t->m_errors);
+		errors += t->m_errors;
+		nbytes += t->m_nbytes;
+
+		if (0 != memcmp(&disk[(size_t)t->m_base * 512], t->m_copy.data(),
+						t->m_copy.size())) {
+			fprintf(rpt, "Thread %2u: Disk contents don't match\n",
+				t->m_id);
+			errors++;
+		}
+		delete t;
+	}
+
+	fprintf(rpt, "%u threads, %lu bytes, %8.3f ms simulated (%7.2f MB/s), %8.2f s wall (%7.2f kB/s)\n",
+		nthreads, (unsigned long)nbytes, sim * 1e3,
+		(sim > 0) ? nbytes / sim / 1e6 : 0.0,
+		wall, (wall > 0) ? nbytes / wall / 1e3 : 0.0);
+	tb.m_sata->report(rpt);
+
+	fprintf(rpt, "SATASTRESS: %s\n", (0 == errors) ? "SUCCESS" : "FAILED");
+	fflush(rpt);
+	return (0 == errors) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
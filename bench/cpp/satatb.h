@@ -0,0 +1,364 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/satatb.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	The common test harness around the Verilated sata_controller:
+//		the simulated drive (SATASIM), the DMA memory (MEMSIM, behind
+//	an XBARSIM or an AXIMEMSIM), the host thread scheduler, and the helpers
+//	for issuing commands and waiting on the controller.  tb_sata.cpp
+//	builds its tests on top of this, as does the host build of the
+//	software driver (satahost.cpp).
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SATATB_H
+#define	SATATB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+#include <iostream>
+
+#include <Vsata_controller.h>
+#include "testb.h"
+#include "wb_tb.h"
+#include "satasim.h"
+#include "memsim.h"
+#include "xbarsim.h"
+#include "aximemsim.h"
+#include "hostsched.h"
+
+class SATATB : public WB_TB<Vsata_controller> {
+public:
+	// Default time to wait on the core before giving up, about 10k ticks
+	static const uint64_t	TIMEOUT_PS = 30000000ul;	// 30us
+	// ... plus this much more for every sector a command moves.  A
+	// sector takes about 3.4us on a Gen1 link, so this leaves room for
+	// the DMA and for the drive.  A 65536 sector EXT transfer is allowed
+	// about 0.66s of simulated time.
+	static const uint64_t	SECTOR_TIMEOUT_PS = 10000000ul;	// 10us
+
+	// How long to wait on a command moving count sectors
+	static uint64_t	timeout_ps(uint32_t count) {
+		return TIMEOUT_PS + (uint64_t)count * SECTOR_TIMEOUT_PS;
+	}
+
+	// Predicates on the core's outputs, for use with on_event()
+	static bool int_asserted(Vsata_controller *c) { return c->o_int != 0; }
+	static bool link_is_ready(Vsata_controller *c) { return c->o_lnk_ready != 0; }
+
+	SATASIM	*m_sata;
+	MEMSIM  *m_mem;
+	XBARSIM *m_xbar;
+	AXIMEMSIM *m_axi;
+	HOSTSCHED<Vsata_controller>	*m_sched;
+	// The controller can only process one command at a time.  Host
+	// threads must hold this lock from issuing a command until it
+	// completes.
+	HOSTLOCK	m_device;
+	WB_TB<Vsata_controller>* m_tb;
+
+	uint32_t m_dma_addr;
+
+	SATATB(const char *memname = NULL, unsigned membytes = 1024*1024)
+			: WB_TB<Vsata_controller>() {
+		// {{{
+		// Initialize DMA address
+		m_dma_addr = 0x80100;
+
+		// Initialize MEMSIM for DMA memory operations.  If a memory
+		// name is given, the memory is shared with other processes
+		// via either a POSIX shared memory segment or a mapped file.
+		if (memname)
+			m_mem = new MEMSIM(memname, membytes, 10);
+		else
+			m_mem = new MEMSIM(membytes, 10); // 1MB memory by default, with a 10-cycle delay
+
+		// The DMA reaches memory through a (model of a) crossbar, so
+		// that it can be made to compete with other bus masters
+		m_xbar = new XBARSIM(m_mem);
+
+		// When built with OPT_AXI, data moves through the AXI4 port
+		// instead.  Both ports reach the same memory.
+		m_axi = new AXIMEMSIM(m_mem, 10, 4);
+
+		// Host threads are scheduled (as coroutines) on top of tick()
+		m_sched = new HOSTSCHED<Vsata_controller>(this);
+		m_sched->attach(m_device);
+		
+		// Initialize SATASIM for disk operations
+		m_sata = new SATASIM();
+
+		// Set this testbench as its own testbench reference
+		m_tb = this;
+		// }}}
+	}
+	
+	virtual ~SATATB() {
+		delete m_sata;
+		delete m_sched;
+		delete m_axi;
+		delete m_xbar;
+		delete m_mem;
+	}
+
+	Vsata_controller *core(void) {
+		return m_core;
+	}
+
+	// Override simulator clock callbacks to interact with SATASIM
+	virtual	void sim_clk_tick(void) {
+		// Call parent's simulation clock callback
+		TESTB<Vsata_controller>::sim_clk_tick();
+
+		// RAM to device
+		deploy_test_data();
+	}
+	
+	virtual	void sim_rx_clk_tick(void) {
+		// Get signals from SATASIM to apply to core
+		bool rxphy_cominit, rxphy_comwake, rxphy_elecidle, rxphy_valid;
+		bool rxphy_primitive, phy_ready;
+		uint64_t rxphy_data;
+
+		// Call parent's simulation RX clock callback
+		TESTB<Vsata_controller>::sim_rx_clk_tick();
+		
+		// Get values from SATASIM
+		m_sata->process_rx_signals(rxphy_cominit, rxphy_comwake, rxphy_elecidle, 
+		                         rxphy_valid, rxphy_primitive, rxphy_data,
+		                         phy_ready);
+		
+		// Update link layer state machine
+		m_sata->link_layer_model();
+
+		// Apply to core
+		m_core->i_rxphy_cominit = rxphy_cominit;
+		m_core->i_rxphy_comwake = rxphy_comwake;
+		m_core->i_rxphy_elecidle = rxphy_elecidle;
+		m_core->i_rxphy_valid = rxphy_valid;
+		m_core->i_rxphy_data = rxphy_data; // 33-bit value
+		m_core->i_phy_ready = phy_ready;
+	}
+	
+	virtual	void sim_tx_clk_tick(void) {
+		// Call parent's implementation first
+		WB_TB<Vsata_controller>::sim_tx_clk_tick();
+		
+		// Create local variables to receive output values
+		bool txphy_comfinish;
+		bool txphy_ready;
+		bool oob_done;
+		
+		// Process OOB signals from controller
+		if (!m_core->o_lnk_ready) {
+			oob_done = m_sata->process_oob();
+			m_sata->set_oob_done(oob_done);
+		}
+
+		// Update SATASIM with core signals
+		m_sata->process_tx_signals(
+		    m_core->i_reset,
+		    m_core->o_txphy_cominit,
+		    m_core->o_txphy_comwake,
+		    m_core->o_txphy_elecidle,
+		    m_core->o_txphy_primitive,
+		    m_core->o_txphy_data,
+		    txphy_comfinish,
+		    txphy_ready,
+		    m_core->o_lnk_ready
+		);
+		
+		// Apply outputs back to core
+		m_core->i_txphy_comfinish = txphy_comfinish;
+		m_core->i_txphy_ready = txphy_ready;
+	}
+
+	// Add a getter method to access m_time_ps from the parent TESTB class
+	uint64_t get_time_ps(void) {
+		return m_time_ps;
+	}
+
+	// Direct memory access for testing purposes
+	void write_memory(uint32_t addr, uint32_t* data, uint32_t count) {
+		m_mem->load(addr, (char*)data, count*sizeof(uint32_t));
+	}
+
+	void wait(int n) {
+		for (int i = 0; i < n; i++)
+			tick();
+	}
+
+	void reset_controller() {
+		// Reset our SATA simulator
+		m_sata->reset();
+
+		// Assert reset for 100 cycles at the very start
+		m_core->i_reset = 1;
+		for (int i = 0; i < 100; i++)
+			tick();
+		m_core->i_reset = 0;
+		tick();
+		
+		// Print status
+		printf("HOST: SATA controller reset complete\n");
+	}
+
+	void wait_while_busy(uint32_t count = 0) {
+		// Wait for interrupt indicating operation complete
+		if (!tick_until(int_asserted, timeout_ps(count)))
+			printf("ERROR: Timeout waiting for busy to clear\n");
+	}
+
+	// Wishbone register read
+	uint32_t wb_read_reg(uint32_t addr) {
+		if (!m_tb) {
+			std::cerr << "Cannot read register: Testbench not set" << std::endl;
+			return 0;
+		}
+		
+		return m_tb->wb_read(addr);
+	}
+
+	// Wishbone register write
+	void wb_write_reg(uint32_t addr, uint32_t data) {
+		if (!m_tb) {
+			std::cerr << "Cannot write register: Testbench not set" << std::endl;
+			return;
+		}
+		
+		m_tb->wb_write(addr, data);
+	}
+
+	// Build the list of register writes required to issue a command
+	//
+	// The command register must be written last, since it is the write
+	// that starts the command.  Its top byte holds the features.
+	std::vector<WBWRITE> command_list(uint64_t lba, uint32_t count,
+			uint32_t dma_addr, uint8_t command,
+			uint8_t features = 0) {
+		// LBA mode.  28-bit commands keep LBA[27:24] in the device
+		// register, 48-bit (EXT) commands use LBA[47:24] instead.
+		uint32_t device = 0x40;
+		if (command != FIS_TYPE_DMA_READ_EXT
+				&& command != FIS_TYPE_DMA_WRITE_EXT)
+			device |= (lba >> 24) & 0x0F;
+
+		uint32_t lbalo = (device << 24) | (uint32_t)(lba & 0x0FFFFFF);
+		uint32_t lbahi = (uint32_t)((lba >> 24) & 0x0FFFFFF);
+		// A count of 65536 is encoded as zero
+		uint32_t count16 = count & 0x0FFFF;
+
+		// Construct the command FIS word.  Bit 14 clears any
+		// pending interrupt.
+		uint32_t fis_cmd = ((uint32_t)features << 24) | (command << 16) |
+						(0x40 << 8) | FIS_TYPE_REG_H2D;
+
+		return std::vector<WBWRITE> {
+			{ SATA_LBAHI_ADDR,  lbahi,        0x0f },	// LBA[47:24]
+			{ SATA_LBALO_ADDR,  lbalo,        0x0f },	// Device, LBA[23:0]
+			{ SATA_COUNT_ADDR,  count16,      0x0f },	// Count
+			{ SATA_DMA_ADDR_LO, dma_addr<<2,  0x0f },	// DMA address low
+			{ SATA_DMA_ADDR_HI, 0,            0x0f },	// DMA address high
+			{ SATA_CMD_ADDR,    fis_cmd,      0x0f }	// Command
+		};
+	}
+
+	// Program the shadow registers and issue a command
+	//
+	// All six register writes are issued back to back in a single
+	// Wishbone cycle.
+	void issue_command(uint64_t lba, uint32_t count, uint32_t dma_addr,
+			uint8_t command, uint8_t features = 0) {
+		std::vector<WBWRITE>	cmd = command_list(lba, count, dma_addr,
+							command, features);
+
+		m_tb->wb_writev(cmd.data(), cmd.size());
+	}
+
+	// Wait for link to be ready
+	void wait_while_link_ready(void) {
+		if (!tick_until(link_is_ready, TIMEOUT_PS))
+			printf("ERROR: Timeout waiting for link ready\n");
+		else
+			printf("HOST: Link ready\n");
+	}
+
+	// Wait for interrupt, from a command moving count sectors
+	void wait_for_int(uint32_t count = 0) {
+		if (!tick_until(int_asserted, timeout_ps(count)))
+			printf("ERROR: Timeout waiting for interrupt\n");
+	}
+
+	// Non-blocking versions of the above.  The handler is called with
+	// true once the interrupt rises (or the link comes up), or with false
+	// should the timeout expire first.  Meanwhile, the caller is free to
+	// go on and do other things.
+	unsigned on_int(EVENT_HANDLER handler, uint64_t timeout_ps = TIMEOUT_PS) {
+		return on_event(int_asserted, handler, timeout_ps, true);
+	}
+
+	unsigned on_link_ready(EVENT_HANDLER handler,
+			uint64_t timeout_ps = TIMEOUT_PS) {
+		return on_event(link_is_ready, handler, timeout_ps);
+	}
+
+	// SATA Controller pulls data from memory
+	void deploy_test_data() {
+		// Use XBARSIM::apply to handle the memory transaction
+		m_xbar->apply(m_core->o_dma_cyc, m_core->o_dma_stb, m_core->o_dma_we,
+			m_core->o_dma_addr, &m_core->o_dma_data, m_core->o_dma_sel, 
+			m_core->i_dma_stall, m_core->i_dma_ack, &m_core->i_dma_data);
+
+		// The AXI4 DMA port, idle unless built with OPT_AXI
+		m_axi->apply(
+			m_core->M_AXI_AWVALID, m_core->M_AXI_AWREADY,
+			m_core->M_AXI_AWID, m_core->M_AXI_AWADDR,
+			m_core->M_AXI_AWLEN,
+			m_core->M_AXI_WVALID, m_core->M_AXI_WREADY,
+			&m_core->M_AXI_WDATA, m_core->M_AXI_WSTRB,
+			m_core->M_AXI_WLAST,
+			m_core->M_AXI_BVALID, m_core->M_AXI_BREADY,
+			m_core->M_AXI_BID, m_core->M_AXI_BRESP,
+			m_core->M_AXI_ARVALID, m_core->M_AXI_ARREADY,
+			m_core->M_AXI_ARID, m_core->M_AXI_ARADDR,
+			m_core->M_AXI_ARLEN,
+			m_core->M_AXI_RVALID, m_core->M_AXI_RREADY,
+			m_core->M_AXI_RID, &m_core->M_AXI_RDATA,
+			m_core->M_AXI_RLAST, m_core->M_AXI_RRESP);
+	}
+};
+
+#endif
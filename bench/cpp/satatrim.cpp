@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/satatrim.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A test, and throughput benchmark, of TRIM and FLUSH CACHE, as
+//		issued by the software driver through CTRL_TRIM and CTRL_SYNC.
+//	The SATASIM behind the Verilated controller models an SSD: a write
+//	cache in front of a flash translation layer, with a little spare
+//	flash, and greedy garbage collection.  The disk is first filled, and
+//	its upper half is then deleted--with -t, by trimming it, otherwise by
+//	simply forgetting about it, as a file system without TRIM would.  Short
+//	writes then land at random across the lower half.
+//
+//	Without TRIM, the drive must keep copying the deleted half around as
+//	it collects its garbage, and the random writes run at the speed of
+//	that copying.  With TRIM, the deleted half costs nothing.  Run it both
+//	ways, and compare the throughput and write amplification reported.
+//
+//	Afterwards, the lower half is read back and checked, and the upper
+//	half must read back as zeros if it was trimmed, or unchanged if not.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "satatb.h"
+#include "satadrv.h"
+#include "benchutil.h"
+
+// The size of the DMA memory, as given to MEMSIM.  The test takes a single
+// buffer from it, for its longest transfer.
+static	const unsigned	TRIM_MEMSIZE = 4*1024*1024;
+static	const unsigned	TRIM_FILL = 256;	// Sectors per fill write
+
+void	usage(void) {
+	fprintf(stderr, "USAGE: satatrim [-tv] [-d <sectors>] [-n <writes>] [-c <sectors>] [-b <sectors>] [-s <blocks>] [-w <sectors>]\n"
+"\n"
+"\t-t\tTrim the deleted half of the disk.  (Default: don't)\n"
+"\t-d <sectors>\tThe size of the (in-memory) disk.  (Default: 16384)\n"
+"\t-n <writes>\tThe number of random writes.  (Default: 2048)\n"
+"\t-c <sectors>\tThe size of each random write.  (Default: 8)\n"
+"\t-b <sectors>\tThe size of each flash erase block.  (Default: 64)\n"
+"\t-s <blocks>\tThe spare flash, in erase blocks.  (Default: 8)\n"
+"\t-w <sectors>\tThe size of the drive's write cache.  (Default: 1024)\n"
+"\t-v\tVerbose.  Leave the simulation's chatter on stdout.\n");
+}
+
+int	main(int argc, char **argv) {
+	unsigned	nsectors = 16384, nwrites = 2048, count = 8,
+			block = 64, spare = 8, wcache = 1024, errors = 0, half;
+	uint64_t	nbytes = 0, start_ps;
+	bool		verbose = false, trim = false;
+	FILE		*rpt = stdout;
+	double		start_wall, sim, wall;
+	std::vector<uint8_t>	disk;
+	std::vector<char>	copy;
+	struct SATADRV_S	*drv;
+	char		*buf;
+	int		opt;
+
+	while((opt = getopt(argc, argv, "d:n:c:b:s:w:tvh")) != -1) {
+		switch(opt) {
+		case 'd': nsectors = atoi(optarg); break;
+		case 'n': nwrites  = atoi(optarg); break;
+		case 'c': count    = atoi(optarg); break;
+		case 'b': block    = atoi(optarg); break;
+		case 's': spare    = atoi(optarg); break;
+		case 'w': wcache   = atoi(optarg); break;
+		case 't': trim = true; break;
+		case 'v': verbose = true; break;
+		case 'h': usage(); exit(EXIT_SUCCESS); break;
+		default: usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	half = nsectors / 2;
+	if (block < 1 || nsectors < 2 * TRIM_FILL
+				|| (nsectors % TRIM_FILL) != 0) {
+		fprintf(stderr, "ERR: The disk must be a multiple of %u sectors, at least two of them\n", TRIM_FILL);
+		exit(EXIT_FAILURE);
+	} if (count < 1 || count > half) {
+		fprintf(stderr, "ERR: Random writes must fit within half the disk\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!verbose) {
+		rpt = fdopen(dup(STDOUT_FILENO), "w");
+		if (NULL == rpt || NULL == freopen("/dev/null", "w", stdout)) {
+			fprintf(stderr, "ERR: Cannot redirect stdout\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	SATATB	tb(NULL, TRIM_MEMSIZE);
+
+	disk.resize((size_t)nsectors * 512, 0);
+	tb.m_sata->attach_disk(disk.data(), nsectors);
+	tb.m_sata->ftl(block, spare, wcache);
+
+	tb.reset_controller();
+	tb.wait_while_link_ready();
+	tb.wait(1000);
+
+	drv = sata_init(satahost_attach(&tb, 0));
+	if (NULL == drv) {
+		fprintf(rpt, "ERR: sata_init failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	buf = (char *)satahost_malloc(TRIM_FILL * 512);
+	copy.resize((size_t)nsectors * 512, 0);
+
+	// Fill the disk, then delete its upper half
+	// {{{
+	for(unsigned s=0; s<nsectors; s += TRIM_FILL) {
+		fill(buf, TRIM_FILL * 512);
+		if (RES_OK != sata_write(drv, s, TRIM_FILL, buf))
+			errors++;
+		memcpy(&copy[(size_t)s * 512], buf, TRIM_FILL * 512);
+	}
+
+	if (trim) {
+		LBA_t	range[2] = { half, nsectors - 1 };
+
+		if (RES_OK != sata_ioctl(drv, CTRL_TRIM, (char *)range)) {
+			fprintf(rpt, "ERR: CTRL_TRIM failed\n");
+			errors++;
+		}
+		memset(&copy[(size_t)half * 512], 0,
+					(size_t)(nsectors - half) * 512);
+	}
+
+	if (RES_OK != sata_ioctl(drv, CTRL_SYNC, NULL))
+		errors++;
+	// }}}
+
+	// Random writes, across the lower half
+	// {{{
+	start_ps   = tb.get_time_ps();
+	start_wall = wall_now();
+	for(unsigned k=0; k<nwrites; k++) {
+		unsigned	s = xrand() % (half - count + 1);
+
+		fill(buf, count * 512);
+		if (RES_OK != sata_write(drv, s, count, buf))
+			errors++;
+		memcpy(&copy[(size_t)s * 512], buf, count * 512);
+		nbytes += count * 512;
+	}
+
+	// Nothing counts as written until it's out of the drive's cache
+	if (RES_OK != sata_ioctl(drv, CTRL_SYNC, NULL))
+		errors++;
+	sim  = (tb.get_time_ps() - start_ps) * 1e-12;
+	wall = wall_now() - start_wall;
+	// }}}
+
+	// Everything must read back as expected, trimmed sectors as zeros
+	// {{{
+	for(unsigned s=0; s<nsectors; s += TRIM_FILL) {
+		if (RES_OK != sata_read(drv, s, TRIM_FILL, buf)
+			|| 0 != memcmp(buf, &copy[(size_t)s * 512],
+							TRIM_FILL * 512)) {
+			fprintf(rpt, "ERR: Sectors %u-%u don't match\n",
+				s, s + TRIM_FILL - 1);
+			errors++;
+		}
+	}
+
+	if (0 != memcmp(disk.data(), copy.data(), copy.size())) {
+		fprintf(rpt, "ERR: Disk contents don't match\n");
+		errors++;
+	}
+	// }}}
+
+	fprintf(rpt, "%s, %u writes of %u sectors, %lu bytes, %8.3f ms simulated (%7.2f MB/s), %8.2f s wall (%7.2f kB/s)\n",
+		(trim) ? "TRIM" : "No TRIM", nwrites, count,
+		(unsigned long)nbytes, sim * 1e3,
+		(sim > 0) ? nbytes / sim / 1e6 : 0.0,
+		wall, (wall > 0) ? nbytes / wall / 1e3 : 0.0);
+	tb.m_sata->report(rpt);
+
+	fprintf(rpt, "SATATRIM: %s\n", (0 == errors) ? "SUCCESS" : "FAILED");
+	fflush(rpt);
+	return (0 == errors) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -41,24 +41,18 @@
 // {{{
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <assert.h>
 #include <vector>
 #include <iostream>
 #include <fstream>
 
-#include <Vsata_controller.h>
-#include "testb.h"
-#include "wb_tb.h"
-#include "satasim.h"
-#include "memsim.h"
+#include "satatb.h"
 // }}}
 
-class SATA_TB : public WB_TB<Vsata_controller> {
+class SATA_TB : public SATATB {
 public:
-	SATASIM	*m_sata;
-	MEMSIM  *m_mem;
-	WB_TB<Vsata_controller>* m_tb;
-
 	uint64_t m_current_lba;
     uint32_t m_sector_count;
     uint64_t m_disk_size;
@@ -67,9 +61,8 @@ public:
     std::string m_disk_filename;
     std::fstream m_disk_file;
 
-	uint32_t m_dma_addr;
-
-	SATA_TB(const char *filesystem_image) : WB_TB<Vsata_controller>() {
+	SATA_TB(const char *filesystem_image, const char *memname = NULL)
+			: SATATB(memname) {
 		// {{{
 		if (0 != access(filesystem_image, R_OK)) {
 			fprintf(stderr, "Cannot open %s for reading\n", filesystem_image);
@@ -80,212 +73,33 @@ public:
 			exit(EXIT_FAILURE);
 		}
 
-		// Initialize DMA address
-		m_dma_addr = 0x80100;
-
-		// Initialize MEMSIM for DMA memory operations
-		m_mem = new MEMSIM(1024*1024, 10); // 1MB memory with 10-cycle delay
-		
-		// Initialize SATASIM for disk operations
-		m_sata = new SATASIM();
-		// m_mem->load(filesystem_image);
-
 		// Initialize other member variables
 		m_current_lba = 0;
 		m_sector_count = 0;
 		m_disk_size = 0;
 		m_disk_filename = filesystem_image; // Initialize m_disk_filename
-
-		// Set this testbench as its own testbench reference
-		m_tb = this;
 		// }}}
 	}
-	
-	virtual ~SATA_TB() {
-		delete m_sata;
-		delete m_mem;
-	}
-
-	Vsata_controller *core(void) {
-		return m_core;
-	}
-
-	// Override simulator clock callbacks to interact with SATASIM
-	virtual	void sim_clk_tick(void) {
-		// Call parent's simulation clock callback
-		TESTB<Vsata_controller>::sim_clk_tick();
-
-		// RAM to device
-		deploy_test_data();
-	}
-	
-	virtual	void sim_rx_clk_tick(void) {
-		// Get signals from SATASIM to apply to core
-		bool rxphy_cominit, rxphy_comwake, rxphy_elecidle, rxphy_valid;
-		bool rxphy_primitive, phy_ready;
-		uint64_t rxphy_data;
-
-		// Call parent's simulation RX clock callback
-		TESTB<Vsata_controller>::sim_rx_clk_tick();
-		
-		// Get values from SATASIM
-		m_sata->process_rx_signals(rxphy_cominit, rxphy_comwake, rxphy_elecidle, 
-		                         rxphy_valid, rxphy_primitive, rxphy_data,
-		                         phy_ready);
-		
-		// Update link layer state machine
-		m_sata->link_layer_model();
-
-		// Apply to core
-		m_core->i_rxphy_cominit = rxphy_cominit;
-		m_core->i_rxphy_comwake = rxphy_comwake;
-		m_core->i_rxphy_elecidle = rxphy_elecidle;
-		m_core->i_rxphy_valid = rxphy_valid;
-		m_core->i_rxphy_data = rxphy_data; // 33-bit value
-		m_core->i_phy_ready = phy_ready;
-	}
-	
-	virtual	void sim_tx_clk_tick(void) {
-		// Call parent's implementation first
-		WB_TB<Vsata_controller>::sim_tx_clk_tick();
-		
-		// Create local variables to receive output values
-		bool txphy_comfinish;
-		bool txphy_ready;
-		bool oob_done;
-		
-		// Process OOB signals from controller
-		if (!m_core->o_lnk_ready) {
-			oob_done = m_sata->process_oob();
-			m_sata->set_oob_done(oob_done);
-		}
-
-		// Update SATASIM with core signals
-		m_sata->process_tx_signals(
-		    m_core->i_reset,
-		    m_core->o_txphy_cominit,
-		    m_core->o_txphy_comwake,
-		    m_core->o_txphy_elecidle,
-		    m_core->o_txphy_primitive,
-		    m_core->o_txphy_data,
-		    txphy_comfinish,
-		    txphy_ready,
-		    m_core->o_lnk_ready
-		);
-		
-		// Apply outputs back to core
-		m_core->i_txphy_comfinish = txphy_comfinish;
-		m_core->i_txphy_ready = txphy_ready;
-	}
-
-	// Add a getter method to access m_time_ps from the parent TESTB class
-	uint64_t get_time_ps(void) {
-		return m_time_ps;
-	}
-
-	// Direct memory access for testing purposes
-	void write_memory(uint32_t addr, uint32_t* data, uint32_t count) {
-		m_mem->load(addr, (char*)data, count*sizeof(uint32_t));
-	}
-
-	void wait(int n) {
-		for (int i = 0; i < n; i++)
-			tick();
-	}
-
-	void reset_controller() {
-		// Reset our SATA simulator
-		m_sata->reset();
-
-		// Assert reset for 100 cycles at the very start
-		m_core->i_reset = 1;
-		for (int i = 0; i < 100; i++)
-			tick();
-		m_core->i_reset = 0;
-		tick();
-		
-		// Print status
-		printf("HOST: SATA controller reset complete\n");
-	}
-
-	void wait_while_busy(void) {
-		// Wait for interrupt indicating operation complete
-		int timeout = 10000;
-		while(!m_core->o_int && --timeout > 0)
-			tick();
-			
-		if (timeout <= 0)
-			printf("ERROR: Timeout waiting for busy to clear\n");
-	}
-
-	// Wishbone register read
-	uint32_t wb_read_reg(uint32_t addr) {
-		if (!m_tb) {
-			std::cerr << "Cannot read register: Testbench not set" << std::endl;
-			return 0;
-		}
-		
-		return m_tb->wb_read(addr);
-	}
-
-	// Wishbone register write
-	void wb_write_reg(uint32_t addr, uint32_t data) {
-		if (!m_tb) {
-			std::cerr << "Cannot write register: Testbench not set" << std::endl;
-			return;
-		}
-		
-		m_tb->wb_write(addr, data);
-	}
-
-	// Wait for link to be ready
-	void wait_while_link_ready(void) {
-		int timeout = 10000;
-		
-		while(!m_core->o_lnk_ready && --timeout > 0)
-			tick();
-			
-		if (timeout <= 0)
-			printf("ERROR: Timeout waiting for link ready\n");
-		else
-			printf("HOST: Link ready\n");
-	}
-
-	// Wait for interrupt
-	void wait_for_int(void) {
-		int timeout = 10000;
-		
-		while(!m_core->o_int && --timeout > 0)
-			tick();
-			
-		if (timeout <= 0)
-			printf("ERROR: Timeout waiting for interrupt\n");
-	}
-
-	// SATA Controller pulls data from memory
-	void deploy_test_data() {
-		// Use MEMSIM::apply to handle the memory transaction
-		m_mem->apply(m_core->o_dma_cyc, m_core->o_dma_stb, m_core->o_dma_we,
-			m_core->o_dma_addr, &m_core->o_dma_data, m_core->o_dma_sel, 
-			m_core->i_dma_stall, m_core->i_dma_ack, &m_core->i_dma_data);
-	}
 
 	// Verify data from memory
 	bool verify_data(uint32_t w_addr, uint32_t r_addr) {
-		bool success = true;
-		
+		const uint32_t	nwords = SATA_SECTOR_SIZE/4;
+
 		// Verify data directly from memory
-		for (uint32_t i = 0; i < SATA_SECTOR_SIZE/4; i++) {
-			if (m_mem->operator[](r_addr + i) != m_mem->operator[](w_addr + i)) {
-				printf("TB: Data verification FAILED\n");
-				printf("TB: Received data[%u] = %08x, Sent data[%u] = %08x\n", 
-					i, m_mem->operator[](r_addr + i), i, m_mem->operator[](w_addr + i));
-				return false;
+		if (!m_mem->compare(r_addr, w_addr, nwords)) {
+			for (uint32_t i = 0; i < nwords; i++) {
+				if ((*m_mem)[r_addr + i] != (*m_mem)[w_addr + i]) {
+					printf("TB: Data verification FAILED\n");
+					printf("TB: Received data[%u] = %08x, Sent data[%u] = %08x\n", 
+						i, (*m_mem)[r_addr + i], i, (*m_mem)[w_addr + i]);
+					break;
+				}
 			}
+			return false;
 		}
 		printf("TB: Data verification PASSED\n");
 		
-		return success;
+		return true;
 	}
 
 	// Write received data to disk
@@ -301,17 +115,10 @@ public:
 		uint64_t offset = lba * SATA_SECTOR_SIZE;
 		m_disk_file.seekp(offset);
 
-		// Write data to disk (count is number of sectors, each sector is 128 words)
-		uint32_t words_to_write = count * (SATA_SECTOR_SIZE / 4);  // Convert sectors to words
-		for (uint32_t i = 0; i < words_to_write; i++) {
-			// Convert each 32-bit word to bytes and write
-			uint32_t word = data[i];
-			// printf("DEVICE: Writing word %08x to disk\n", word);
-			for (int j = 0; j < 4; j++) {
-				uint8_t byte = (word >> (j * 8)) & 0xFF;
-				m_disk_file.write(reinterpret_cast<char*>(&byte), 1);
-			}
-		}
+		// Sector data is the same byte for byte in memory as on disk,
+		// at least on a little endian host
+		m_disk_file.write(reinterpret_cast<const char*>(data),
+					count * SATA_SECTOR_SIZE);
 
 		// Close the file
 		m_disk_file.close();
@@ -330,18 +137,8 @@ public:
 		uint64_t offset = lba * SATA_SECTOR_SIZE;
 		m_disk_file.seekg(offset);
 
-		// Read data from disk (count is number of sectors, each sector is 128 words)
-		uint32_t words_to_read = count * (SATA_SECTOR_SIZE / 4);  // Convert sectors to words
-		for (uint32_t i = 0; i < words_to_read; i++) {
-			uint32_t word = 0;
-			// Read 4 bytes to form a 32-bit word
-			for (int j = 0; j < 4; j++) {
-				uint8_t byte;
-				m_disk_file.read(reinterpret_cast<char*>(&byte), 1);
-				word |= (byte << (j * 8));
-			}
-			data[i] = word;
-		}
+		m_disk_file.read(reinterpret_cast<char*>(data),
+					count * SATA_SECTOR_SIZE);
 
 		// Close the file
 		m_disk_file.close();
@@ -354,31 +151,23 @@ public:
 			return;
 		}
 
-		// Only 28-bit LBA and 8-bit count supported for now
-		uint32_t lba24 = (uint32_t)(lba & 0xFFFFFF); // lower 24 bits
-		uint32_t lba_hi = 0; // upper bits not used
-		uint32_t count8 = count & 0xFF; // lower 8 bits
-		
-		// Setup Wishbone registers for the DMA write
-		wb_write_reg(SATA_LBAHI_ADDR, lba_hi);             // Upper bits
-		wb_write_reg(SATA_LBALO_ADDR, lba24);              // Lower 24 bits
-		wb_write_reg(SATA_COUNT_ADDR, count8);             // Count
-		wb_write_reg(SATA_DMA_ADDR_LO, dma_addr<<2);       // DMA address low
-		wb_write_reg(SATA_DMA_ADDR_HI, uint32_t(0));       // DMA address high
-		
-		// Construct the command FIS word for DMA write
-		uint32_t fis_cmd = (0x00 << 24) | (FIS_TYPE_DMA_WRITE << 16) | 
-						((0x40 | ((lba >> 24) & 0x0F)) << 8) | FIS_TYPE_REG_H2D;
-		wb_write_reg(SATA_CMD_ADDR, fis_cmd);            // Command
+		// Set up the registers for the DMA write, and issue the command
+		issue_command(lba, count, dma_addr, FIS_TYPE_DMA_WRITE_EXT);
 		
 		// Wait for operation to complete (interrupt)
-		wait_for_int();
+		wait_for_int(count);
 		
 		// Write the received data to disk
 		write_to_disk(lba, m_sata->get_received_data(), count);
 		
 		printf("TB: DMA Write complete: LBA=%llu, Count=%u, DMA Addr=0x%08x\n", 
 			(unsigned long long)lba, count, dma_addr);
+		// With write prefetch, the data is already waiting in the TX
+		// FIFO when DMA Activate arrives, so this should be little
+		// more than the clock crossing.  Without it, it includes a
+		// full memory read.
+		printf("TB: DMA Activate to DATA FIS latency: %u clocks\n",
+			m_sata->get_activate_latency());
 	}
 
 	// Execute DMA read operation
@@ -388,22 +177,8 @@ public:
 			return;
 		}
 		
-		// Only 28-bit LBA and 8-bit count supported for now
-		uint32_t lba24 = (uint32_t)(lba & 0xFFFFFF); // lower 24 bits
-		uint32_t lba_hi = 0; // upper bits not used
-		uint32_t count8 = count & 0xFF; // lower 8 bits
-		
-		// Setup Wishbone registers for the DMA read
-		wb_write_reg(SATA_LBAHI_ADDR, lba_hi);             // Upper bits
-		wb_write_reg(SATA_LBALO_ADDR, lba24);              // Lower 24 bits
-		wb_write_reg(SATA_COUNT_ADDR, count8);             // Count
-		wb_write_reg(SATA_DMA_ADDR_LO, dma_addr<<2);       // DMA address low
-		wb_write_reg(SATA_DMA_ADDR_HI, uint32_t(0));       // DMA address high
-		
-		// Construct the command FIS word for DMA read
-		uint32_t fis_cmd = (0x00 << 24) | (FIS_TYPE_DMA_READ << 16) | 
-						((0x40 | ((lba >> 24) & 0x0F)) << 8) | FIS_TYPE_REG_H2D;
-		wb_write_reg(SATA_CMD_ADDR, fis_cmd);            // Command
+		// Set up the registers for the DMA read, and issue the command
+		issue_command(lba, count, dma_addr, FIS_TYPE_DMA_READ_EXT);
 
 		// Read data from disk
 		uint32_t* read_data = new uint32_t[count * (SATA_SECTOR_SIZE/4)];  // Allocate space for all sectors
@@ -411,16 +186,28 @@ public:
 		m_sata->set_sent_data(read_data);
 		
 		// Wait for operation to complete (interrupt)
-		wait_for_int();
+		wait_for_int(count);
 		
 		printf("TB: DMA Read complete: LBA=%llu, Count=%u, DMA Addr=0x%08x\n", 
 			(unsigned long long)lba, count, dma_addr);
 	}
 
+	// Check that the device received the LBA and count we asked for
+	bool check_command(uint64_t lba, uint32_t count) {
+		if (m_sata->get_lba() != lba
+				|| m_sata->get_count() != (count & 0x0ffff)) {
+			printf("TB: Device received LBA=%llu, Count=%u, expected LBA=%llu, Count=%u\n",
+				(unsigned long long)m_sata->get_lba(),
+				m_sata->get_count(),
+				(unsigned long long)lba, count & 0x0ffff);
+			return false;
+		} return true;
+	}
+
 	// Test DMA write and read
 	// For DMA Write: Memory (dma_addr) -> SATA Controller -> Disk (LBA)
 	// For DMA Read:  Disk (LBA) -> SATA Controller -> Memory (dma_addr)
-	bool dma_test(uint32_t lba, uint32_t count, uint32_t dma_addr) {
+	bool dma_test(uint64_t lba, uint32_t count, uint32_t dma_addr) {
 		uint32_t w_addr = dma_addr;
 		uint32_t r_addr = dma_addr + SATA_SECTOR_SIZE;
 		uint32_t *test_data = new uint32_t[SATA_SECTOR_SIZE/4];
@@ -435,6 +222,7 @@ public:
 		// Perform DMA write (RAM to disk via SATA controller)
 		printf("TB: Issue DMA Write\n");
 		dma_write(lba, count, w_addr);
+		bool success = check_command(lba, count);
 		
 		// Wait some time after DMA write
 		wait(1000);
@@ -442,15 +230,391 @@ public:
 		// DMA Read
 		printf("TB: Issue DMA Read\n");
 		dma_read(lba, count, r_addr);
+		success = check_command(lba, count) && success;
 		
 		// Verify read data equals written data
 		printf("TB: Verifying read data matches written data...\n");
-		bool success = verify_data(w_addr, r_addr);
+		success = verify_data(w_addr, r_addr) && success;
 
 		delete[] test_data;
 		return success;
 	}
 
+	// Test the performance counters
+	// {{{
+	// Clears the counters, runs one DMA write and one DMA read, and then
+	// reads every counter back in a single burst
+	bool perf_test(uint64_t lba, uint32_t dma_addr) {
+		static const char *const names[SATA_NPERF] = {
+			"Commands", "Sectors read", "Sectors written",
+			"DMA busy (lo)", "DMA busy (hi)",
+			"DMA stalls (lo)", "DMA stalls (hi)",
+			"Latency (lo)", "Latency (hi)", "Max latency",
+			"RX FIFO HWM", "TX FIFO HWM", "R_ERRs",
+			"TX failures", "HOLDs sent", "HOLDs received",
+			"ALIGNs sent", "DMA RX arb waits",
+			"DMA TX arb waits" };
+		unsigned	perf[SATA_NPERF];
+		bool		success;
+
+		m_tb->wb_write(SATA_PERF_ADDR, SATA_PERF_CLEAR);
+		success = dma_test(lba, 1, dma_addr);
+
+		// Let the PHY clock counters catch up
+		wait(100);
+
+		m_tb->wb_write(SATA_PERF_ADDR, SATA_PERF_CMDS);
+		m_tb->wb_read(SATA_PERF_ADDR, SATA_NPERF, perf, 0);
+		for(unsigned k=0; k<SATA_NPERF; k++)
+			printf("TB: PERF %-16s %10u\n", names[k], perf[k]);
+
+		if (perf[SATA_PERF_CMDS] != 2
+				|| perf[SATA_PERF_RDSECTORS] != 1
+				|| perf[SATA_PERF_WRSECTORS] != 1) {
+			printf("TB: Wrong command or sector counts\n");
+			success = false;
+		}
+
+		if (perf[SATA_PERF_DMABUSY] == 0
+				|| perf[SATA_PERF_TXHWM] == 0
+				|| perf[SATA_PERF_MAXLAT] == 0
+				|| perf[SATA_PERF_LATENCY] < perf[SATA_PERF_MAXLAT]) {
+			printf("TB: Performance counters failed to count\n");
+			success = false;
+		}
+
+		if (success)
+			printf("TB: Performance counter verification PASSED\n");
+		return success;
+	}
+	// }}}
+
+	// Test CRC error reporting
+	// {{{
+	// In cut-through mode, a DATA FIS with a bad CRC is still written
+	// to memory, but the command's status must flag the error.  The
+	// next command must then come back clean.
+	bool crc_test(uint64_t lba, uint32_t dma_addr) {
+		const uint32_t	good_addr = dma_addr,
+				bad_addr  = dma_addr + SATA_SECTOR_SIZE;
+		unsigned	status;
+		bool		success = true;
+
+		dma_read(lba, 1, good_addr);
+		if (m_tb->wb_read(SATA_CMD_ADDR) & SATA_CMD_ICRC) {
+			printf("TB: ICRC set on a clean read\n");
+			success = false;
+		}
+
+		m_sata->inject_crc_error();
+		dma_read(lba, 1, bad_addr);
+		status = m_tb->wb_read(SATA_CMD_ADDR);
+		printf("TB: Status after a bad CRC: %08x\n", status);
+		if ((status & (SATA_CMD_ICRC | SATA_CMD_ERR))
+				!= (SATA_CMD_ICRC | SATA_CMD_ERR)) {
+			printf("TB: CRC error not reported\n");
+			success = false;
+		}
+
+		// The data went through anyway
+		success = verify_data(good_addr, bad_addr) && success;
+
+		dma_read(lba, 1, bad_addr);
+		if (m_tb->wb_read(SATA_CMD_ADDR) & SATA_CMD_ICRC) {
+			printf("TB: ICRC error failed to clear\n");
+			success = false;
+		}
+
+		if (success)
+			printf("TB: CRC error verification PASSED\n");
+		return success;
+	}
+	// }}}
+
+	// Select (or deselect) scatter-gather DMA mode
+	void set_sgmode(bool enable) {
+		// Only touch the SG mode byte, lest we reset the PHY
+		WBWRITE	w = { SATA_PHY_ADDR, (enable) ? SATA_PHY_SGMODE : 0u,
+				0x02 };
+
+		m_tb->wb_writev(&w, 1);
+	}
+
+	// Write a descriptor to memory.  Addresses are in words, as
+	// elsewhere in this bench, lengths are in bytes.
+	void write_descriptor(uint32_t desc, uint32_t addr, uint32_t len,
+			uint32_t flags) {
+		(*m_mem)[desc  ] = addr << 2;
+		(*m_mem)[desc+1] = len | flags;
+	}
+
+	// Build a descriptor chain, scattering nseg segments of seglen
+	// bytes each, in reverse order, starting at base.  The chain is
+	// split in two tables, joined by a LINK descriptor, so both tables
+	// and links get exercised.
+	void build_chain(uint32_t table, uint32_t link, uint32_t base,
+			unsigned nseg, uint32_t seglen) {
+		const uint32_t	stride = 2*seglen/4;
+		uint32_t	desc = table;
+
+		for(unsigned k=0; k<nseg; k++) {
+			if (k == nseg/2) {
+				write_descriptor(desc, link, 0, SATA_SG_LINK);
+				desc = link;
+			}
+
+			write_descriptor(desc, base + (nseg-1-k)*stride, seglen,
+				(k == nseg-1) ? SATA_SG_LAST : 0);
+			desc += 2;
+		}
+	}
+
+	// Test scatter-gather DMA
+	// {{{
+	// Writes count sectors, gathered from nseg separate segments, and
+	// then reads them back, scattered into a different set of nseg
+	// segments.
+	bool dma_sg_test(uint32_t lba, uint32_t count, uint32_t dma_addr,
+			unsigned nseg) {
+		const uint32_t	nwords = count * (SATA_SECTOR_SIZE/4),
+				seglen = count * SATA_SECTOR_SIZE / nseg,
+				w_table = dma_addr, r_table = dma_addr + 0x100,
+				w_base = dma_addr + 0x1000,
+				r_base = dma_addr + 0x1000 + nwords*2;
+		bool	success = true;
+
+		assert(nseg >= 2 && (seglen & 3) == 0
+				&& seglen * nseg == count * SATA_SECTOR_SIZE);
+
+		build_chain(w_table, w_table + 0x80, w_base, nseg, seglen);
+		build_chain(r_table, r_table + 0x80, r_base, nseg, seglen);
+
+		// Fill the write segments with our test pattern, and clear
+		// the read segments
+		for(unsigned k=0; k<nseg; k++) {
+			uint32_t	wseg = w_base + (nseg-1-k) * 2*seglen/4,
+					rseg = r_base + (nseg-1-k) * 2*seglen/4;
+
+			for(unsigned w=0; w<seglen/4; w++) {
+				(*m_mem)[wseg + w] = 0xc5000000 + k*seglen/4 + w;
+				(*m_mem)[rseg + w] = 0;
+			}
+		}
+
+		set_sgmode(true);
+
+		printf("TB: Issue scatter-gather DMA Write, %u segments\n", nseg);
+		dma_write(lba, count, w_table);
+
+		wait(1000);
+
+		printf("TB: Issue scatter-gather DMA Read, %u segments\n", nseg);
+		dma_read(lba, count, r_table);
+
+		set_sgmode(false);
+
+		// Verify that each segment landed where its descriptor said
+		// it should.  Since the pattern counts up across the whole
+		// transfer, this also checks that the write gathered its
+		// segments in order.
+		for(unsigned k=0; k<nseg && success; k++) {
+			uint32_t	rseg = r_base + (nseg-1-k) * 2*seglen/4;
+
+			for(unsigned w=0; w<seglen/4; w++) {
+				uint32_t	expected = 0xc5000000 + k*seglen/4 + w;
+
+				if ((*m_mem)[rseg + w] != expected) {
+					printf("TB: SG segment %u, data[%u] = %08x, expected %08x\n",
+						k, w, (*m_mem)[rseg + w], expected);
+					success = false;
+					break;
+				}
+			}
+		}
+
+		if (success)
+			printf("TB: Scatter-gather verification PASSED\n");
+		return success;
+	}
+	// }}}
+
+	// Test the command queue
+	// {{{
+	// Queues npairs of DMA write/read pairs in a submission ring, rings
+	// the doorbell once, and waits for all of them to complete.  The
+	// device model returns the data from the last write on every read,
+	// so each read should return the data written by the write before
+	// it.
+	//
+	// The interrupt is moderated, so that it should only rise once all
+	// of the commands have completed.  A final command then checks the
+	// moderation timeout.
+	bool queue_test(unsigned npairs, uint32_t lba, uint32_t dma_addr) {
+		const unsigned	LGSIZE = 4, NCMDS = 2*npairs,
+				SQ_WORDS = 8, CQ_WORDS = 4,
+				NWORDS = SATA_SECTOR_SIZE/4;
+		const uint32_t	sq = dma_addr, cq = dma_addr + 0x100,
+				wbuf = dma_addr + 0x1000,
+				rbuf = dma_addr + 0x1000 + npairs * NWORDS;
+		const unsigned	TIMEOUT = 400;
+		bool		success = true, early = false;
+		unsigned	tries = 0, tail;
+
+		assert(NCMDS+1 < (1u<<LGSIZE));
+
+		// Build the submission ring
+		for(unsigned k=0; k<NCMDS; k++) {
+			bool		wr = (k & 1) == 0;
+			uint32_t	buf = (wr ? wbuf : rbuf) + (k/2) * NWORDS;
+			std::vector<WBWRITE>	cmd = command_list(lba, 1, buf,
+					wr ? FIS_TYPE_DMA_WRITE : FIS_TYPE_DMA_READ);
+			uint32_t	*entry = &(*m_mem)[sq + k * SQ_WORDS];
+
+			memset(entry, 0, SQ_WORDS * sizeof(uint32_t));
+			for(unsigned r=0; r<cmd.size(); r++) {
+				switch(cmd[r].a) {
+				case SATA_CMD_ADDR:	entry[0] = cmd[r].v; break;
+				case SATA_LBALO_ADDR:	entry[1] = cmd[r].v; break;
+				case SATA_LBAHI_ADDR:	entry[2] = cmd[r].v; break;
+				case SATA_COUNT_ADDR:	entry[3] = cmd[r].v; break;
+				case SATA_DMA_ADDR_LO:	entry[4] = cmd[r].v; break;
+				case SATA_DMA_ADDR_HI:	entry[5] = cmd[r].v; break;
+				default: break;
+				}
+			}
+			entry[6] = 0xc0de0000 | k;
+
+			if (wr) for(unsigned w=0; w<NWORDS; w++) {
+				(*m_mem)[buf + w] = 0xd0000000 | (k << 16) | w;
+			} else
+				memset(&(*m_mem)[buf], 0, NWORDS*sizeof(uint32_t));
+		}
+		// Fill the ring with garbage, so every word of every entry must
+		// be written
+		memset(&(*m_mem)[cq], 0xa5, (1u<<LGSIZE)*CQ_WORDS*sizeof(uint32_t));
+
+		// Reads return whatever was last written
+		m_sata->set_sent_data(m_sata->get_received_data());
+
+		printf("TB: Queueing %u commands\n", NCMDS);
+		{
+			WBWRITE	setup[] = {
+				{ SATA_SQBASE_ADDR, sq << 2, 0x0f },
+				{ SATA_CQBASE_ADDR, cq << 2, 0x0f },
+				{ SATA_QCTRL_ADDR, SATA_QCTRL_ENABLE | LGSIZE, 0x0f },
+				{ SATA_QINTR_ADDR, SATA_QINTR(0, NCMDS), 0x0f },
+				{ SATA_SQDB_ADDR,  NCMDS, 0x0f }
+			};
+
+			m_tb->wb_writev(setup, sizeof(setup)/sizeof(setup[0]));
+		}
+
+		// Wait for the completions to arrive
+		while((tail = (m_tb->wb_read(SATA_CQDB_ADDR) >> 16) & 0x0ffff)
+								!= NCMDS) {
+			if (m_core->o_int && tail < NCMDS && !early) {
+				printf("TB: Interrupt with only %u of %u completions\n",
+					tail, NCMDS);
+				early = true;
+				success = false;
+			}
+
+			if (++tries > 2000) {
+				printf("TB: Timeout waiting on the queue, QCTRL = %08x, SQ = %08x, CQ = %08x\n",
+					m_tb->wb_read(SATA_QCTRL_ADDR),
+					m_tb->wb_read(SATA_SQDB_ADDR),
+					m_tb->wb_read(SATA_CQDB_ADDR));
+				return false;
+			} wait(100);
+		}
+
+		if (!m_core->o_int) {
+			printf("TB: No interrupt with completions pending\n");
+			success = false;
+		}
+
+		// Check the completions
+		for(unsigned k=0; k<NCMDS; k++) {
+			const uint32_t	*cqe = &(*m_mem)[cq + k * CQ_WORDS];
+
+			if (cqe[0] != (0xc0de0000 | k)
+					|| (cqe[2] & 1) != 1
+					|| (cqe[2] >> 16) != k+1
+					|| (cqe[1] & 0x40ff) != FIS_TYPE_REG_D2H
+					|| cqe[3] != 0) {
+				printf("TB: Bad completion %u: %08x %08x %08x %08x\n",
+					k, cqe[0], cqe[1], cqe[2], cqe[3]);
+				success = false;
+			}
+		}
+
+		// Check the data
+		for(unsigned k=0; k<npairs; k++) {
+			if (!m_mem->compare(rbuf + k*NWORDS, wbuf + k*NWORDS,
+								NWORDS)) {
+				printf("TB: Queued read %u returned the wrong data\n", k);
+				success = false;
+			}
+		}
+
+		// Acknowledge the interrupt, without reaping anything
+		if (m_tb->wb_read(SATA_QISTAT_ADDR) != (SATA_QISTAT_INT | NCMDS)) {
+			printf("TB: Bad interrupt status, %08x\n",
+				m_tb->wb_read(SATA_QISTAT_ADDR));
+			success = false;
+		}
+		m_tb->wb_write(SATA_QISTAT_ADDR, SATA_QISTAT_INT);
+		tick();
+		if (m_core->o_int) {
+			printf("TB: Interrupt remains after acknowledgment\n");
+			success = false;
+		}
+
+		// Release the completions
+		m_tb->wb_write(SATA_CQDB_ADDR, NCMDS);
+		tick();
+		if (m_core->o_int) {
+			printf("TB: Interrupt remains after completions released\n");
+			success = false;
+		}
+
+		// Repeat the first command, with a threshold that will never be
+		// reached.  The timeout should raise the interrupt instead.
+		memcpy(&(*m_mem)[sq + NCMDS * SQ_WORDS], &(*m_mem)[sq],
+				SQ_WORDS * sizeof(uint32_t));
+		(*m_mem)[sq + NCMDS * SQ_WORDS + 6] = 0xc0de0000 | NCMDS;
+		m_tb->wb_write(SATA_QINTR_ADDR, SATA_QINTR(TIMEOUT, 0xff));
+		m_tb->wb_write(SATA_SQDB_ADDR, NCMDS+1);
+
+		tries = 0;
+		while(((m_tb->wb_read(SATA_CQDB_ADDR) >> 16) & 0x0ffff)
+							!= NCMDS+1) {
+			if (++tries > 2000) {
+				printf("TB: Timeout waiting on the last command\n");
+				return false;
+			} wait(100);
+		}
+
+		tries = 0;
+		while(!m_core->o_int && ++tries < 4*TIMEOUT)
+			tick();
+		if (!m_core->o_int || !(m_tb->wb_read(SATA_QISTAT_ADDR)
+						& SATA_QISTAT_TIMEOUT)) {
+			printf("TB: No interrupt after the moderation timeout\n");
+			success = false;
+		}
+
+		// Release the last completion, and turn the queue off
+		m_tb->wb_write(SATA_CQDB_ADDR, NCMDS+1);
+		m_tb->wb_write(SATA_QINTR_ADDR, 0);
+		m_tb->wb_write(SATA_QCTRL_ADDR, 0);
+
+		if (success)
+			printf("TB: Command queue verification PASSED\n");
+		return success;
+	}
+	// }}}
+
 	// Execute PIO write operation
 	void pio_write(uint64_t lba, uint32_t count, uint32_t dma_addr) {
 		if (!m_core || !m_tb) {
@@ -458,25 +622,11 @@ public:
 			return;
 		}
 
-		// Only 28-bit LBA and 8-bit count supported for now
-		uint32_t lba24 = (uint32_t)(lba & 0xFFFFFF); // lower 24 bits
-		uint32_t lba_hi = 0; // upper bits not used
-		uint32_t count8 = count & 0xFF; // lower 8 bits
-		
-		// Setup Wishbone registers for the PIO write
-		wb_write_reg(SATA_LBAHI_ADDR, lba_hi);             // Upper bits
-		wb_write_reg(SATA_LBALO_ADDR, lba24);              // Lower 24 bits
-		wb_write_reg(SATA_COUNT_ADDR, count8);             // Count
-		wb_write_reg(SATA_DMA_ADDR_LO, dma_addr<<2);       // DMA address low
-		wb_write_reg(SATA_DMA_ADDR_HI, uint32_t(0));       // DMA address high
-		
-		// Construct the command FIS word for PIO write
-		uint32_t fis_cmd = (0x00 << 24) | (FIS_TYPE_PIO_WRITE_BUFFER << 16) | 
-						((0x40 | ((lba >> 24) & 0x0F)) << 8) | FIS_TYPE_REG_H2D;
-		wb_write_reg(SATA_CMD_ADDR, fis_cmd);            // Command
+		// Set up the registers for the PIO write, and issue the command
+		issue_command(lba, count, dma_addr, FIS_TYPE_PIO_WRITE_BUFFER);
 
 		// Wait for operation to complete (interrupt)
-		wait_for_int();
+		wait_for_int(count);
 
 		// Write the received data to disk
 		write_to_disk(lba, m_sata->get_received_data(), count);
@@ -492,22 +642,8 @@ public:
 			return;
 		}
 		
-		// Only 28-bit LBA and 8-bit count supported for now
-		uint32_t lba24 = (uint32_t)(lba & 0xFFFFFF); // lower 24 bits
-		uint32_t lba_hi = 0; // upper bits not used
-		uint32_t count8 = count & 0xFF; // lower 8 bits
-		
-		// Setup Wishbone registers for the PIO read
-		wb_write_reg(SATA_LBAHI_ADDR, lba_hi);             // Upper bits
-		wb_write_reg(SATA_LBALO_ADDR, lba24);              // Lower 24 bits
-		wb_write_reg(SATA_COUNT_ADDR, count8);             // Count
-		wb_write_reg(SATA_DMA_ADDR_LO, dma_addr<<2);       // DMA address low
-		wb_write_reg(SATA_DMA_ADDR_HI, uint32_t(0));       // DMA address high
-		
-		// Construct the command FIS word for PIO read
-		uint32_t fis_cmd = (0x00 << 24) | (FIS_TYPE_PIO_READ_BUFFER << 16) | 
-						((0x40 | ((lba >> 24) & 0x0F)) << 8) | FIS_TYPE_REG_H2D;
-		wb_write_reg(SATA_CMD_ADDR, fis_cmd);            // Command
+		// Set up the registers for the PIO read, and issue the command
+		issue_command(lba, count, dma_addr, FIS_TYPE_PIO_READ_BUFFER);
 
 		// Read data from disk
 		uint32_t* read_data = new uint32_t[count * (SATA_SECTOR_SIZE/4)];  // Allocate space for all sectors
@@ -515,7 +651,7 @@ public:
 		m_sata->set_sent_data(read_data);
 
 		// Wait for operation to complete (interrupt)
-		wait_for_int();
+		wait_for_int(count);
 		
 		printf("TB: PIO Read complete: LBA=%llu, Count=%u\n", 
 			(unsigned long long)lba, count);
@@ -553,12 +689,246 @@ public:
 		delete[] test_data;
 		return success;
 	}
+
+	// Test FLUSH CACHE EXT and DATA SET MANAGEMENT (TRIM)
+	// {{{
+	// FLUSH CACHE EXT moves no data.  DSM is a DMA write of one block of
+	// ranges, each a 48-bit LBA and a 16-bit count.  Every range here
+	// reads the same in either byte order, so the count the device trims
+	// doesn't depend upon the DMA's byte order.
+	bool dsm_test(uint32_t dma_addr) {
+		const unsigned	NRANGES = 3, COUNT = 0x0101,
+				NWORDS = SATA_SECTOR_SIZE/4;
+		const uint64_t	flushes = m_sata->flushes(),
+				trimmed = m_sata->trimmed();
+		unsigned	status;
+		bool		success = true;
+
+		printf("TB: Issue FLUSH CACHE EXT\n");
+		issue_command(0, 0, 0, FIS_TYPE_FLUSH_EXT);
+		wait_for_int();
+		status = m_tb->wb_read(SATA_CMD_ADDR);
+		if ((status & SATA_CMD_ERR) || m_sata->flushes() != flushes + 1) {
+			printf("TB: FLUSH CACHE EXT failed, status %08x\n", status);
+			success = false;
+		}
+
+		// The rest of the block is left unused, with counts of zero
+		memset(&(*m_mem)[dma_addr], 0, NWORDS * sizeof(uint32_t));
+		for(unsigned k=0; k<NRANGES; k++) {
+			(*m_mem)[dma_addr + 2*k  ] = 0x10101010 * (k+1);
+			(*m_mem)[dma_addr + 2*k+1] = (COUNT << 16) | COUNT;
+		}
+
+		printf("TB: Issue DATA SET MANAGEMENT (TRIM)\n");
+		issue_command(0, 1, dma_addr, FIS_TYPE_DSM, DSM_TRIM);
+		wait_for_int();
+		status = m_tb->wb_read(SATA_CMD_ADDR);
+		if (status & SATA_CMD_ERR) {
+			printf("TB: DSM failed, status %08x\n", status);
+			success = false;
+		} if (m_sata->trimmed() != trimmed + NRANGES * COUNT) {
+			printf("TB: DSM trimmed %llu sectors, expected %u\n",
+				(unsigned long long)(m_sata->trimmed() - trimmed),
+				NRANGES * COUNT);
+			success = false;
+		}
+
+		if (success)
+			printf("TB: FLUSH and TRIM verification PASSED\n");
+		return success;
+	}
+	// }}}
+
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Concurrent host threads
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Each host thread is a coroutine, scheduled by m_sched.  Threads
+	// compete for the controller (m_device) and the Wishbone bus, so the
+	// time spent waiting for each measures the queueing effects of a
+	// multi-threaded workload.
+
+	typedef	struct {
+		unsigned	m_ios, m_errors;
+		unsigned long	m_wait_clocks,	// Waiting for the controller
+				m_busy_clocks,	// Issue to completion
+				m_max_latency;	// Worst case, including wait
+	} HOSTSTATS;
+
+	// A single DMA command, issued from a host thread
+	HOSTTASK<bool> host_io(bool write, uint64_t lba, uint32_t count,
+			uint32_t dma_addr, HOSTSTATS &st) {
+		std::vector<uint32_t>	sent;
+		unsigned long	queued = m_sched->clocks(), started;
+		bool		ok;
+
+		co_await m_device.lock();
+		started = m_sched->clocks();
+
+		if (!write) {
+			sent.resize(count * (SATA_SECTOR_SIZE/4));
+			read_from_disk(lba, sent.data(), count);
+			m_sata->set_sent_data(sent.data());
+		}
+
+		co_await m_sched->wb_writev(command_list(lba, count, dma_addr,
+			(write) ? FIS_TYPE_DMA_WRITE : FIS_TYPE_DMA_READ));
+		ok = co_await m_sched->until(int_asserted, timeout_ps(count),
+							true);
+		if (ok && write)
+			write_to_disk(lba, m_sata->get_received_data(), count);
+		if (!ok)
+			printf("HOST: Timeout waiting on %s, LBA=%llu\n",
+				(write) ? "write" : "read",
+				(unsigned long long)lba);
+
+		m_device.unlock();
+
+		st.m_ios++;
+		st.m_wait_clocks += started - queued;
+		st.m_busy_clocks += m_sched->clocks() - started;
+		if (m_sched->clocks() - queued > st.m_max_latency)
+			st.m_max_latency = m_sched->clocks() - queued;
+
+		co_return ok;
+	}
+
+	// A host thread writing, reading back, and checking nios sectors
+	HOSTTASK<void> host_thread(unsigned id, unsigned nios, uint64_t lba,
+			uint32_t buf, unsigned think, HOSTSTATS &st,
+			unsigned &active) {
+		const uint32_t	nw = SATA_SECTOR_SIZE/4;
+
+		for(unsigned k=0; k<nios; k++) {
+			bool	ok;
+
+			for(uint32_t i=0; i<nw; i++)
+				(*m_mem)[buf+i] = (id << 24) | (k << 16) | i;
+
+			ok = co_await host_io(true, lba+k, 1, buf, st);
+			if (ok)
+				ok = co_await host_io(false, lba+k, 1, buf+nw, st);
+			if (!ok || !m_mem->compare(buf, buf+nw, nw)) {
+				printf("HOST[%d]: I/O #%d FAILED\n", id, k);
+				st.m_errors++;
+			}
+
+			// Time spent by the thread doing other things
+			co_await m_sched->wait_clocks(think);
+		}
+
+		active--;
+	}
+
+	// A CPU polling the status register while the I/O threads run
+	HOSTTASK<void> poll_thread(unsigned interval, HOSTSTATS &st,
+			unsigned &active) {
+		while(active > 0) {
+			unsigned long	start = m_sched->clocks();
+
+			(void)co_await m_sched->wb_read(SATA_CMD_ADDR);
+			st.m_ios++;
+			st.m_busy_clocks += m_sched->clocks() - start;
+			co_await m_sched->wait_clocks(interval);
+		}
+	}
+
+	bool	concurrent_test(unsigned nthreads, unsigned nios,
+			uint64_t lba, uint32_t dma_addr) {
+		std::vector<HOSTSTATS>	st(nthreads+1);
+		unsigned	active = nthreads, errors = 0;
+		unsigned long	start = m_sched->clocks();
+		bool		complete;
+
+		for(unsigned k=0; k<nthreads; k++)
+			m_sched->spawn(host_thread(k, nios, lba + k*nios,
+				dma_addr + k * 2 * (SATA_SECTOR_SIZE/4),
+				50 + 37*k, st[k], active));
+		m_sched->spawn(poll_thread(200, st[nthreads], active));
+
+		complete = m_sched->run(TIMEOUT_PS * 4 * nthreads * nios);
+
+		printf("HOST: %u threads, %u I/Os each, %lu clocks\n",
+			nthreads, 2*nios, m_sched->clocks() - start);
+		for(unsigned k=0; k<nthreads; k++) {
+			unsigned	n = (st[k].m_ios) ? st[k].m_ios : 1;
+
+			printf("HOST[%u]: %3u I/Os, %u errors, avg wait %6lu, avg service %6lu, max latency %6lu clocks\n",
+				k, st[k].m_ios, st[k].m_errors,
+				st[k].m_wait_clocks / n,
+				st[k].m_busy_clocks / n, st[k].m_max_latency);
+			errors += st[k].m_errors;
+		}
+		printf("HOST[poll]: %u status reads, %lu clocks on the bus\n",
+			st[nthreads].m_ios, st[nthreads].m_busy_clocks);
+
+		if (!complete)
+			printf("HOST: Threads did not complete\n");
+		return complete && errors == 0 && !m_sched->m_bomb;
+	}
+	// }}}
 };
 
+void	usage(void) {
+	fprintf(stderr, "USAGE: tb_sata [-m <memname>] [-t <nthreads>[,<nios>]]\n"
+"\t\t[-x <rate>[,<burst>[,<wrfrac>]]]\n"
+"\n"
+"\t-m <memname>\tBack the DMA memory with a shared memory segment (if\n"
+"\t\t<memname> is of the form /name) or a memory mapped file, so that\n"
+"\t\tanother process may produce or consume DMA buffers\n"
+"\t-t <nthreads>,<nios>\n"
+"\t\tFollow the DMA and PIO tests with <nthreads> concurrent host\n"
+"\t\tthreads, each writing and reading back <nios> (default 4)\n"
+"\t\tsectors, while another thread polls the controller\n"
+"\t-x <rate>,<burst>,<wrfrac>\n"
+"\t\tAdd a synthetic bus master, competing with the DMA for memory.\n"
+"\t\tThe master will use <rate> (0-1) of the memory bandwidth, in\n"
+"\t\tbursts of <burst> (default 8) words, <wrfrac> (default 0.5) of\n"
+"\t\twhich will be writes.  May be given more than once.\n");
+}
+
 int	main(int argc, char **argv) {
 	const char	IMG_FILENAME[] = "sata.img";
 	const char	VCD_FILENAME[] = "trace.vcd";
-	SATA_TB	tb(IMG_FILENAME);
+	const char	*memname = NULL;
+	std::vector<const char *>	masters;
+	unsigned	nthreads = 0, nios = 4;
+	int		opt;
+
+	while((opt = getopt(argc, argv, "m:t:x:h")) != -1) {
+		switch(opt) {
+		case 'm': memname = optarg; break;
+		case 't':
+			if (sscanf(optarg, "%u,%u", &nthreads, &nios) < 1
+					|| nios == 0) {
+				usage();
+				exit(EXIT_FAILURE);
+			} break;
+		case 'x': masters.push_back(optarg); break;
+		case 'h': usage(); exit(EXIT_SUCCESS); break;
+		default: usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	SATA_TB	tb(IMG_FILENAME, memname);
+
+	for(unsigned k=0; k<masters.size(); k++) {
+		double		rate = 0.0, wrfrac = 0.5;
+		unsigned	burst = 8;
+
+		if (sscanf(masters[k], "%lf,%u,%lf", &rate, &burst, &wrfrac) < 1
+				|| rate <= 0.0 || rate > 1.0 || burst == 0) {
+			fprintf(stderr, "ERR: Bad master specification, %s\n",
+				masters[k]);
+			usage();
+			exit(EXIT_FAILURE);
+		}
+
+		tb.m_xbar->add_master(rate, burst, wrfrac);
+	}
 
 	// Now open trace and continue with the rest of the test
 	tb.opentrace(VCD_FILENAME);
@@ -593,6 +963,71 @@ int	main(int argc, char **argv) {
 	// Wait between tests
 	tb.wait(1000);
 
+	// Test DMA beyond the reach of 28-bit commands
+	printf("\n=== Testing 48-bit LBA DMA Operations ===\n");
+	success = tb.dma_test(0x012345678ull, test_count, dma_addr);
+	if (success)
+		printf("LBA48 DMA TEST SUMMARY: SUCCESS!\n");
+	else {
+		printf("LBA48 DMA TEST SUMMARY: FAILED!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tb.wait(1000);
+
+	// Test the performance counters
+	printf("\n=== Testing Performance Counters ===\n");
+	success = tb.perf_test(test_lba, dma_addr);
+	if (success)
+		printf("PERF TEST SUMMARY: SUCCESS!\n");
+	else {
+		printf("PERF TEST SUMMARY: FAILED!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tb.wait(1000);
+
+#ifdef	SATA_CUTTHROUGH
+	// Test CRC error reporting.  (Without OPT_CUTTHROUGH, a bad CRC
+	// aborts the command instead.)
+	printf("\n=== Testing CRC Error Reporting ===\n");
+	success = tb.crc_test(test_lba, dma_addr);
+	if (success)
+		printf("CRC TEST SUMMARY: SUCCESS!\n");
+	else {
+		printf("CRC TEST SUMMARY: FAILED!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tb.wait(1000);
+#endif
+
+#ifndef	AXI_DMA
+	// Test scatter-gather DMA.  (The AXI DMA doesn't support it.)
+	printf("\n=== Testing Scatter-Gather DMA Operations ===\n");
+	success = tb.dma_sg_test(test_lba, test_count, 0x20000, 4);
+	if (success)
+		printf("SG DMA TEST SUMMARY: SUCCESS!\n");
+	else {
+		printf("SG DMA TEST SUMMARY: FAILED!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tb.wait(1000);
+#endif
+
+	// Test the command queue
+	printf("\n=== Testing Command Queue ===\n");
+	success = tb.queue_test(3, test_lba, 0x30000);
+	if (success)
+		printf("QUEUE TEST SUMMARY: SUCCESS!\n");
+	else {
+		printf("QUEUE TEST SUMMARY: FAILED!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tb.wait(1000);
+
 	// Test PIO operations
 	printf("\n=== Testing PIO Operations ===\n");
 	success = tb.pio_test(test_lba + SATA_SECTOR_SIZE, test_count, 0); // Use different LBA
@@ -607,6 +1042,38 @@ int	main(int argc, char **argv) {
 
 
 	tb.wait(1000);
-		
+
+	// Test FLUSH CACHE and TRIM
+	printf("\n=== Testing FLUSH CACHE and DATA SET MANAGEMENT ===\n");
+	success = tb.dsm_test(dma_addr);
+	if (success)
+		printf("DSM TEST SUMMARY: SUCCESS!\n");
+	else {
+		printf("DSM TEST SUMMARY: FAILED!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	tb.wait(1000);
+
+	// Test concurrent host threads
+	if (nthreads > 0) {
+		printf("\n=== Testing %u concurrent host threads ===\n", nthreads);
+		success = tb.concurrent_test(nthreads, nios, 64, 0x40000);
+		if (success)
+			printf("CONCURRENT TEST SUMMARY: SUCCESS!\n");
+		else {
+			printf("CONCURRENT TEST SUMMARY: FAILED!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	tb.m_xbar->report();
+	tb.m_sata->report();
+#ifdef	AXI_DMA
+	tb.m_axi->report();
+	if (tb.m_axi->m_errors)
+		success = false;
+#endif
+
 	return success ? 0 : 1;
 }
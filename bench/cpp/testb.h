@@ -44,6 +44,8 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <functional>
+#include <list>
 #ifdef	TRACE_FST
 #define	TRACECLASS	VerilatedFstC
 #include <verilated_fst_c.h>
@@ -60,6 +62,13 @@
 	// closetrace() methods for handling VCD tracefile generation.  To
 	// use a non-VCD trace, redefine TRACECLASS before calling this
 	// function to the trace class you wish to use.
+	//
+	// Rather than spinning on tick() waiting for some output of the core,
+	// a test may also register an event: a predicate on the core's
+	// outputs, together with a handler to be called once the predicate
+	// becomes true (or once an optional deadline passes).  Events are
+	// checked once per (system) clock, so several may be outstanding at
+	// once.
 //
 template <class VA>	class TESTB {
 public:
@@ -76,6 +85,24 @@ public:
 	// Tick count to track simulation time
 	unsigned long m_tickcount;
 
+	// Events
+	// {{{
+	typedef	std::function<bool(VA *)>	EVENT_PREDICATE;
+	// The handler is called with true when the predicate fires, or false
+	// if the deadline passes first
+	typedef	std::function<void(bool)>	EVENT_HANDLER;
+	typedef	struct	{
+		unsigned	m_id;
+		EVENT_PREDICATE	m_predicate;
+		EVENT_HANDLER	m_handler;
+		uint64_t	m_deadline_ps;	// Zero for no deadline
+		bool		m_edge, m_last, m_fired;
+	} TBEVENT;
+
+	std::list<TBEVENT>	m_events;
+	unsigned		m_last_event_id;
+	// }}}
+
 	TESTB(void) {
 		// {{{
 		m_core = new VA;
@@ -84,6 +111,7 @@ public:
 		m_done     = false;
 		m_paused_trace = false;
 		m_tickcount = 0;
+		m_last_event_id = 0;
 		Verilated::traceEverOn(true);
 // Set the initial clock periods in ps
 		m_clk.init(10000);	//  100.00 MHz
@@ -224,6 +252,8 @@ public:
 		if (m_clk.falling_edge()) {
 			m_changed = true;
 			sim_clk_tick();
+			if (!m_events.empty())
+				sim_events();
 		}
 		if (m_rx.falling_edge()) {
 			m_changed = true;
@@ -272,6 +302,118 @@ public:
 		m_changed = false;
 	}
 	// }}}
+
+	//
+	// on_event(predicate, handler, timeout_ps, edge)
+	// {{{
+	// Registers an event.  Once per clock, predicate(m_core) will be
+	// evaluated.  When it returns true (or, if edge is set, when it
+	// changes from false to true), handler(true) will be called and the
+	// event removed.  If timeout_ps is non-zero and that much simulated
+	// time passes first, handler(false) is called instead.  Handlers may
+	// register further events.  Returns an ID that may be used to cancel
+	// the event.
+	unsigned	on_event(EVENT_PREDICATE predicate,
+			EVENT_HANDLER handler, uint64_t timeout_ps = 0,
+			bool edge = false) {
+		TBEVENT	ev;
+
+		ev.m_id = ++m_last_event_id;
+		ev.m_predicate = predicate;
+		ev.m_handler   = handler;
+		ev.m_deadline_ps = (timeout_ps) ? m_time_ps + timeout_ps : 0;
+		ev.m_edge  = edge;
+		ev.m_last  = (edge) ? predicate(m_core) : false;
+		ev.m_fired = false;
+		m_events.push_back(ev);
+
+		return ev.m_id;
+	}
+	// }}}
+
+	//
+	// cancel_event(id)
+	// {{{
+	// Removes an event without calling its handler.  Returns false if the
+	// event has already fired, expired, or been cancelled.
+	bool	cancel_event(unsigned id) {
+		for(auto it = m_events.begin(); it != m_events.end(); it++) {
+			if (it->m_id == id) {
+				m_events.erase(it);
+				return true;
+			}
+		} return false;
+	}
+	// }}}
+
+	unsigned	pending_events(void) const {
+		// {{{
+		return m_events.size();
+	}
+	// }}}
+
+	//
+	// sim_events()
+	// {{{
+	// Called once per clock from tick().  Checks every pending event, and
+	// calls the handlers of any that have fired or expired.  Handlers are
+	// only called once the list has been fully scanned, so that they may
+	// freely register or cancel other events.
+	virtual	void	sim_events(void) {
+		std::list<TBEVENT>	ready;
+
+		for(auto it = m_events.begin(); it != m_events.end(); ) {
+			bool	v = it->m_predicate(m_core);
+
+			it->m_fired = (it->m_edge) ? (v && !it->m_last) : v;
+			it->m_last  = v;
+
+			if (it->m_fired || (it->m_deadline_ps
+					&& m_time_ps >= it->m_deadline_ps))
+				ready.splice(ready.end(), m_events, it++);
+			else
+				it++;
+		}
+
+		for(auto it = ready.begin(); it != ready.end(); it++)
+			it->m_handler(it->m_fired);
+	}
+	// }}}
+
+	//
+	// tick_until(predicate, timeout_ps, edge)
+	// {{{
+	// A blocking convenience on top of on_event(): ticks until the
+	// predicate fires, returning true, or the timeout expires, returning
+	// false.  Any other pending events continue to be serviced meanwhile.
+	bool	tick_until(EVENT_PREDICATE predicate, uint64_t timeout_ps = 0,
+			bool edge = false) {
+		bool		complete = false, success = false;
+		unsigned	id;
+
+		id = on_event(predicate, [&](bool ok) {
+				complete = true; success = ok; },
+			timeout_ps, edge);
+
+		while(!complete && !done())
+			tick();
+
+		if (!complete)
+			cancel_event(id);
+		return success;
+	}
+	// }}}
+
+	//
+	// run_events()
+	// {{{
+	// Tick until every pending event has either fired or expired
+	void	run_events(void) {
+		while(!m_events.empty() && !done())
+			tick();
+	}
+	// }}}
+
 	virtual bool	done(void) {
 		// {{{
 		if (m_done)
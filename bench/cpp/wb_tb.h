@@ -36,6 +36,9 @@
 ////////////////////////////////////////////////////////////////////////////////
 //
 // }}}
+#ifndef	WB_TB_H
+#define	WB_TB_H
+
 #include <stdio.h>
 
 #include <verilated.h>
@@ -45,6 +48,11 @@
 const int	BOMBCOUNT = 32,
 		LGMEMSIZE = 15;
 
+// WBWRITE is one element of a scatter list of writes, as used by wb_writev()
+typedef	struct	{
+	unsigned	a, v, sel;
+} WBWRITE;
+
 template <class VA>	class	WB_TB : public TESTB<VA> {
 public:
 	bool	m_bomb;
@@ -265,9 +273,64 @@ public:
 	}
 	// }}}
 
+	//
+	// wb_writev(list, ln)
+	// {{{
+	// Issues a scatter list of writes, to arbitrary addresses, all within
+	// a single bus cycle.  Requests are issued back to back, one per clock
+	// unless stalled, and their acknowledgments are collected as they
+	// return rather than waiting on each one in turn.  The bus is
+	// released as soon as the last ack returns, without any further
+	// clocks.
+	void	wb_writev(const WBWRITE *list, unsigned ln) {
+		unsigned errcount = 0, nacks = 0;
+
+		printf("WB-WRITEV(%d, ...)\n", ln);
+		TESTB<VA>::m_core->i_wb_cyc = 1;
+		TESTB<VA>::m_core->i_wb_stb = 1;
+		TESTB<VA>::m_core->i_wb_we  = 1;
+		for(unsigned stbcnt=0; stbcnt<ln; stbcnt++) {
+			TESTB<VA>::m_core->i_wb_addr= list[stbcnt].a;
+			TESTB<VA>::m_core->i_wb_data= list[stbcnt].v;
+			TESTB<VA>::m_core->i_wb_sel = list[stbcnt].sel;
+			errcount = 0;
+
+			while((errcount++ < BOMBCOUNT)&&(TESTB<VA>::m_core->o_wb_stall)) {
+				TICK();
+				if (TESTB<VA>::m_core->o_wb_ack)
+					nacks++;
+			}
+			// Tick, now that we're not stalled.  This is the tick
+			// that gets accepted.
+			TICK();
+			if (TESTB<VA>::m_core->o_wb_ack) nacks++;
+		}
+
+		TESTB<VA>::m_core->i_wb_stb = 0;
+
+		errcount = 0;
+		while((nacks < ln)&&(errcount++ < BOMBCOUNT)) {
+			TICK();
+			if (TESTB<VA>::m_core->o_wb_ack) {
+				nacks++;
+				errcount = 0;
+			}
+		}
+
+		// Release the bus
+		TESTB<VA>::m_core->i_wb_cyc = 0;
+
+		if(errcount >= BOMBCOUNT) {
+			printf("WB/VW-BOMB: NO RESPONSE AFTER %d CLOCKS (LINE=%d)\n",errcount,__LINE__);
+			m_bomb = true;
+		}
+	}
+	// }}}
+
 	bool	bombed(void) const { return m_bomb; }
 
 	// bool	debug(void) const	{ return m_debug; }
 	// bool	debug(bool nxtv)	{ return m_debug = nxtv; }
 };
 
+#endif
@@ -0,0 +1,263 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/xbarsim.cpp
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Models a shared memory, such as one sitting behind a Wishbone
+//		crossbar (wbxbar), for the purpose of measuring how the SATA
+//	DMA performs when it must compete with other bus masters.  See
+//	xbarsim.h for more details.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include "xbarsim.h"
+
+const int	XBARSIM::OWNER_NONE = -2,
+		XBARSIM::OWNER_DMA  = -1;
+
+XBARSIM::XBARSIM(MEMSIM *mem) {
+	// {{{
+	m_mem = mem;
+	m_owner = OWNER_NONE;
+	m_last  = 0;
+	m_switching = false;
+	clear_stats();
+}
+// }}}
+
+int	XBARSIM::add_master(const double rate, const unsigned burst,
+		const double wrfrac, const BUSW base, const BUSW span) {
+	// {{{
+	MASTER	m;
+
+	assert(burst > 0);
+	m.m_rate   = rate;
+	m.m_wrfrac = wrfrac;
+	m.m_burst  = burst;
+	if (span == 0) {
+		// By default, keep to the top quarter of memory, well away
+		// from the DMA buffers used by the test bench
+		m.m_base = (m_mem->m_len >> 2) * 3;
+		m.m_span = (m_mem->m_len >> 2);
+	} else {
+		m.m_base = base;
+		m.m_span = span;
+	}
+
+	m.m_request = false;
+	m.m_we      = false;
+	m.m_nreq = m.m_nack = 0;
+	m.m_addr = m.m_base;
+	m.m_offset = 0;
+	m.m_seed = 0x9e3779b9u * (m_masters.size() + 1);
+	m.m_bursts = m.m_beats = m.m_waits = 0;
+
+	m_masters.push_back(m);
+	return m_masters.size()-1;
+}
+// }}}
+
+void	XBARSIM::clear_stats(void) {
+	// {{{
+	m_clocks = m_dma_cycles = m_dma_beats = m_dma_waits = 0;
+	for(unsigned k=0; k<m_masters.size(); k++)
+		m_masters[k].m_bursts = m_masters[k].m_beats
+					= m_masters[k].m_waits = 0;
+}
+// }}}
+
+uint32_t XBARSIM::random(MASTER &m) {
+	// {{{
+	// A simple xorshift generator, so that each master has its own
+	// repeatable random sequence
+	m.m_seed ^= m.m_seed << 13;
+	m.m_seed ^= m.m_seed >> 17;
+	m.m_seed ^= m.m_seed << 5;
+	return m.m_seed;
+}
+// }}}
+
+void	XBARSIM::generate(MASTER &m) {
+	// {{{
+	// Each idle master starts a new burst with a probability chosen so
+	// that, on average, it will use m_rate of the memory's bandwidth.
+	const	double	SCALE = 1.0 / 4294967296.0;
+
+	if (m.m_request)
+		return;
+
+	if (random(m) * SCALE < m.m_rate / m.m_burst) {
+		m.m_request = true;
+		m.m_we   = (random(m) * SCALE < m.m_wrfrac);
+		m.m_nreq = m.m_nack = 0;
+		m.m_addr = m.m_base + (m.m_offset % m.m_span);
+	}
+}
+// }}}
+
+void	XBARSIM::arbitrate(const bool dma_cyc) {
+	// {{{
+	// Round robin arbitration between the DMA and all synthetic masters.
+	// Candidate N is the DMA, candidates 0..N-1 are the synthetic masters.
+	const unsigned	N = m_masters.size();
+
+	for(unsigned k=1; k<=N+1; k++) {
+		unsigned	c = (m_last + k) % (N+1);
+		bool		want;
+
+		want = (c == N) ? dma_cyc : m_masters[c].m_request;
+		if (want) {
+			m_owner = (c == N) ? OWNER_DMA : (int)c;
+			m_last  = c;
+			m_switching = true;
+			return;
+		}
+	}
+}
+// }}}
+
+void	XBARSIM::drive(MASTER &m) {
+	// {{{
+	uchar		stall, ack, stb;
+	uint32_t	odata, idata;
+
+	stb = (m.m_nreq < m.m_burst) ? 1:0;
+	odata = 0x5a000000 | (m.m_addr & 0x0ffffff);
+	m_mem->apply(1, stb, m.m_we, m.m_addr, &odata, 0x0f,
+			stall, ack, &idata);
+
+	if (stb && !stall) {
+		m.m_nreq++;
+		m.m_offset++;
+		m.m_addr = m.m_base + (m.m_offset % m.m_span);
+	}
+
+	if (ack) {
+		m.m_nack++;
+		m.m_beats++;
+	}
+
+	if (m.m_nack >= m.m_burst) {
+		// Burst complete.  Drop CYC, and release the bus
+		m.m_request = false;
+		m.m_bursts++;
+		m_owner = OWNER_NONE;
+	}
+}
+// }}}
+
+void	XBARSIM::apply(const uchar wb_cyc, const uchar wb_stb,
+		const uchar wb_we, const BUSW wb_addr, const uint32_t *wb_data,
+		const uint64_t wb_sel,
+		uchar &o_stall, uchar &o_ack, uint32_t *o_data) {
+	// {{{
+	m_clocks++;
+	if (wb_cyc)
+		m_dma_cycles++;
+
+	if (m_masters.empty()) {
+		// No contention, so connect the DMA directly to memory
+		m_mem->apply(wb_cyc, wb_stb, wb_we, wb_addr, wb_data, wb_sel,
+			o_stall, o_ack, o_data);
+		if (wb_stb && !o_stall)
+			m_dma_beats++;
+		return;
+	}
+
+	for(unsigned k=0; k<m_masters.size(); k++) {
+		generate(m_masters[k]);
+		if (m_masters[k].m_request && m_owner != (int)k)
+			m_masters[k].m_waits++;
+	}
+
+	if (m_owner == OWNER_NONE)
+		arbitrate(wb_cyc);
+
+	if (m_owner == OWNER_NONE || m_switching) {
+		// {{{
+		// Idle clock between bus owners.  The memory sees no cycle.
+		uchar		stall, ack;
+		uint32_t	data;
+
+		m_mem->apply(0, 0, 0, 0, wb_data, 0, stall, ack, &data);
+		m_switching = false;
+
+		o_stall = wb_cyc;
+		o_ack   = 0;
+		if (wb_stb)
+			m_dma_waits++;
+		// }}}
+	} else if (m_owner == OWNER_DMA) {
+		// {{{
+		m_mem->apply(wb_cyc, wb_stb, wb_we, wb_addr, wb_data, wb_sel,
+			o_stall, o_ack, o_data);
+		if (wb_stb && !o_stall)
+			m_dma_beats++;
+		if (!wb_cyc)
+			m_owner = OWNER_NONE;
+		// }}}
+	} else {
+		// {{{
+		// A synthetic master owns the bus, the DMA must wait
+		o_stall = wb_cyc;
+		o_ack   = 0;
+		if (wb_stb)
+			m_dma_waits++;
+
+		drive(m_masters[m_owner]);
+		// }}}
+	}
+}
+// }}}
+
+void	XBARSIM::report(FILE *fp) const {
+	// {{{
+	unsigned long	total = m_dma_beats;
+
+	for(unsigned k=0; k<m_masters.size(); k++)
+		total += m_masters[k].m_beats;
+
+	fprintf(fp, "XBAR: %lu clocks, %lu beats (%5.1f%% utilization)\n",
+		m_clocks, total,
+		(m_clocks) ? 100.0 * total / m_clocks : 0.0);
+	fprintf(fp, "XBAR: DMA     %8lu beats, %8lu clocks w/ CYC, %8lu clocks lost to arbitration\n",
+		m_dma_beats, m_dma_cycles, m_dma_waits);
+	for(unsigned k=0; k<m_masters.size(); k++) {
+		const MASTER	&m = m_masters[k];
+		fprintf(fp, "XBAR: Master%d %8lu beats, %8lu bursts, %8lu clocks waiting (rate %4.2f)\n",
+			k, m.m_beats, m.m_bursts, m.m_waits, m.m_rate);
+	}
+}
+// }}}
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	bench/cpp/xbarsim.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Models a shared memory, such as one sitting behind a Wishbone
+//		crossbar (wbxbar), for the purpose of measuring how the SATA
+//	DMA performs when it must compete with other bus masters.
+//
+//	The SATA DMA port is one master.  Any number of synthetic masters may
+//	be added to it, each issuing bursts of reads or writes to their own
+//	region of memory at a programmable rate.  As with the wbxbar, the
+//	memory is granted to one master at a time, and only released once that
+//	master drops CYC.  Switching masters costs one idle clock.
+//
+//	With no synthetic masters, the DMA port is connected directly to the
+//	memory, and the memory behaves exactly as a MEMSIM would.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	XBARSIM_H
+#define	XBARSIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "memsim.h"
+
+class	XBARSIM {
+public:
+	typedef	MEMSIM::BUSW	BUSW;
+	typedef	MEMSIM::uchar	uchar;
+
+	// A synthetic bus master, generating traffic in the background
+	// {{{
+	typedef	struct	{
+		// Configuration
+		double		m_rate;		// Fraction of memory bandwidth
+		double		m_wrfrac;	// Fraction of bursts that write
+		unsigned	m_burst;	// Words per burst
+		BUSW		m_base, m_span;	// Region used, in words
+		// State
+		bool		m_request, m_we;
+		unsigned	m_nreq, m_nack;
+		BUSW		m_addr, m_offset;
+		uint32_t	m_seed;
+		// Statistics
+		unsigned long	m_bursts, m_beats, m_waits;
+	} MASTER;
+	// }}}
+
+	MEMSIM			*m_mem;
+	std::vector<MASTER>	m_masters;
+	int			m_owner, m_last;
+	bool			m_switching;
+
+	// DMA statistics
+	unsigned long		m_clocks, m_dma_cycles, m_dma_beats,
+				m_dma_waits;
+
+	XBARSIM(MEMSIM *mem);
+
+	// add_master(rate, burst, wrfrac, base, span)
+	//	Adds a synthetic bus master, consuming approximately "rate"
+	//	(0..1) of the memory's bandwidth in bursts of "burst" words.
+	//	"wrfrac" of these bursts will be writes, the rest reads.  All
+	//	accesses are made to the "span" words starting at "base", so
+	//	as not to disturb the DMA buffers.  Returns the master's ID.
+	int	add_master(const double rate, const unsigned burst=8,
+			const double wrfrac=0.5,
+			const BUSW base=0, const BUSW span=0);
+	unsigned nmasters(void) const { return m_masters.size(); }
+
+	void	apply(const uchar wb_cyc, const uchar wb_stb,
+				const uchar wb_we,
+			const BUSW wb_addr, const uint32_t *wb_data,
+				const uint64_t wb_sel,
+			uchar &o_stall, uchar &o_ack, uint32_t *o_data);
+	void	operator()(const uchar wb_cyc, const uchar wb_stb,
+				const uchar wb_we,
+			const BUSW wb_addr, const uint32_t *wb_data,
+				const uint64_t wb_sel,
+			uchar &o_stall, uchar &o_ack, uint32_t *o_data) {
+
+		apply(wb_cyc, wb_stb, wb_we, wb_addr, wb_data, wb_sel,
+			o_stall, o_ack, o_data);
+	}
+
+	void	clear_stats(void);
+	void	report(FILE *fp = stdout) const;
+private:
+	static	const int	OWNER_NONE, OWNER_DMA;
+	uint32_t	random(MASTER &m);
+	void		generate(MASTER &m);
+	void		arbitrate(const bool dma_cyc);
+	void		drive(MASTER &m);
+};
+
+#endif
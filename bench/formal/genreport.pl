@@ -63,6 +63,7 @@ $dir = ".";
 	"satadma_s2mm",
 	"satadma_rxgears",
 	"satadma_txgears",
+	"satadma_sgwalk",
 	"sata_afifo",
 	"sata_sfifo",
 	"sata_skid"
@@ -70,7 +71,9 @@ $dir = ".";
 	## ============================================================
 	## sata_reset,
 	## satalnk_fsm,
-	## satatrn_fsm
+	## satatrn_fsm,
+	## satatrn_queue,
+	## satatrn_perf
 	##
 	## Contains vendor macro black boxes:
 	## ============================================================
@@ -110,6 +113,7 @@ $dir = ".";
 	"satadma_s2mm"		=> "SATA DMA to memory",
 	"satadma_rxgears"	=> "SATA DMA RX Gearbox",
 	"satadma_txgears"	=> "SATA DMA TX Gearbox",
+	"satadma_sgwalk"	=> "SATA DMA scatter-gather walker",
 	"sata_afifo"		=> "Asynchronous FIFO",
 	"sata_sfifo"		=> "Synchronous FIFO",
 	"sata_skid"		=> "Skidbuffer"
@@ -75,7 +75,7 @@ module	satatb_top;
 			MEM_MASK  = { 1'b1,    {(ADDRESS_WIDTH- 1){1'b0}} },
 			ZDBG_MASK = { 4'b1111, {(ADDRESS_WIDTH-11){1'b1}}, 7'h0 },
 			CONS_MASK = { 4'b1111, {(ADDRESS_WIDTH- 4){1'b0}} },
-			SATA_MASK = { 4'b1111, {(ADDRESS_WIDTH- 9){1'b1}}, 5'h0 },
+			SATA_MASK = { 4'b1111, {(ADDRESS_WIDTH-10){1'b1}}, 6'h0 },
 			DRP_MASK  = { 4'b1111, {(ADDRESS_WIDTH-16){1'b1}}, 12'h0 };
 	//	SCOPE_TRAN_MASK   = { 6'b111111,{(ADDRESS_WIDTH-6){1'b0}} },
 	//	SCOPE_LINK_MASK   = { 6'b111111,{(ADDRESS_WIDTH-6){1'b0}} },
@@ -123,6 +123,9 @@ module	satatb_top;
 	// {{{
 	localparam	CTRL_AW = ($clog2(DW/8) >= 5) ? 1 : (5 - $clog2(DW/8)),
 			CTRL_ADDRESS_WIDTH = CTRL_AW + $clog2(DW/8);
+	// The SATA controller has 16 32-bit registers, 64 bytes
+	localparam	SATA_AW = ($clog2(DW/8) >= 6) ? 1 : (6 - $clog2(DW/8)),
+			SATA_ADDRESS_WIDTH = SATA_AW + $clog2(DW/8);
 
 	wire			sata_ctrlw_cyc, sata_ctrlw_stb, sata_ctrlw_we,
 				sata_ctrlw_stall, sata_ctrlw_ack,sata_ctrlw_err;
@@ -133,7 +136,7 @@ module	satatb_top;
 
 	wire			sata_ctrl_cyc, sata_ctrl_stb, sata_ctrl_we,
 				sata_ctrl_stall, sata_ctrl_ack, sata_ctrl_err;
-	wire	[CTRL_ADDRESS_WIDTH-3:0]	sata_ctrl_addr;
+	wire	[SATA_ADDRESS_WIDTH-3:0]	sata_ctrl_addr;
 	wire	[32-1:0]	sata_ctrl_data, sata_ctrl_idata;
 	wire	[32/8-1:0]	sata_ctrl_sel;
 
@@ -479,21 +482,21 @@ module	satatb_top;
 	(* keep *)	wire	[31:0]	w_phy_debug;
 
 	wbdown #(
-		.ADDRESS_WIDTH(CTRL_ADDRESS_WIDTH),
+		.ADDRESS_WIDTH(SATA_ADDRESS_WIDTH),
 		.WIDE_DW(DW), .SMALL_DW(32)
 	) u_sata_ctrl_down (
 		// {{{
 		.i_clk(wb_clk), .i_reset(wb_reset),
 		//
 		.i_wcyc(sata_ctrlw_cyc), .i_wstb(sata_ctrlw_stb), .i_wwe(sata_ctrlw_we),
-		.i_waddr(sata_ctrlw_addr[CTRL_AW-1:0]),
+		.i_waddr(sata_ctrlw_addr[SATA_AW-1:0]),
 		.i_wdata(sata_ctrlw_data), .i_wsel(sata_ctrlw_sel),
 		.o_wstall(sata_ctrlw_stall),
 		.o_wack(sata_ctrlw_ack), .o_wdata(sata_ctrlw_idata),
 		.o_werr(sata_ctrlw_err),
 		//
 		.o_scyc(sata_ctrl_cyc), .o_sstb(sata_ctrl_stb), .o_swe(sata_ctrl_we),
-		.o_saddr(sata_ctrl_addr[CTRL_ADDRESS_WIDTH-$clog2(32/8)-1:0]),
+		.o_saddr(sata_ctrl_addr[SATA_ADDRESS_WIDTH-$clog2(32/8)-1:0]),
 		.o_sdata(sata_ctrl_data), .o_ssel(sata_ctrl_sel),
 		.i_sstall(sata_ctrl_stall),
 		.i_sack(sata_ctrl_ack), .i_sdata(sata_ctrl_idata),
@@ -510,7 +513,7 @@ module	satatb_top;
 		// SOC control
 		// {{{
 		.i_wb_cyc(sata_ctrl_cyc), .i_wb_stb(sata_ctrl_stb),
-		.i_wb_we(sata_ctrl_we), .i_wb_addr(sata_ctrl_addr[2:0]),
+		.i_wb_we(sata_ctrl_we), .i_wb_addr(sata_ctrl_addr[3:0]),
 		.i_wb_data(sata_ctrl_data), .i_wb_sel(sata_ctrl_sel),
 		.o_wb_stall(sata_ctrl_stall), .o_wb_ack(sata_ctrl_ack),
 		.o_wb_data(sata_ctrl_idata),
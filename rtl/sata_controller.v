@@ -44,9 +44,35 @@ module	sata_controller #(
 		// {{{
 		// Verilator lint_off UNUSED
 		parameter [0:0]	OPT_LOWPOWER = 1'b0,
-				OPT_LITTLE_ENDIAN = 1'b0,
 		// Verilator lint_on  UNUSED
+		// OPT_LITTLE_ENDIAN: Sector data lands in memory in the order
+		// it crosses the wire, first byte at the lowest address, as a
+		// little endian CPU expects.  Otherwise, bytes are ordered for
+		// a big endian bus.
+		parameter [0:0]	OPT_LITTLE_ENDIAN = 1'b0,
 		parameter	LGFIFO = 12,
+		// LGAFIFO is the size of the asynchronous FIFOs crossing
+		// between the bus and PHY clock domains
+		parameter	LGAFIFO = 12,
+		// OPT_PREFETCH starts reading DMA write data from memory
+		// before the device's DMA Activate arrives
+		parameter [0:0]	OPT_PREFETCH = 1'b0,
+		// OPT_CUTTHROUGH reports DATA FIS CRC failures in the command
+		// status, rather than aborting the transfer
+		parameter [0:0]	OPT_CUTTHROUGH = 1'b0,
+		// OPT_AXI moves DMA data through the AXI4 master port, M_AXI_*,
+		// using bursts of up to 2^LGAXIBURST beats.  The command queue
+		// still uses the Wishbone DMA port.  Scatter-gather mode is
+		// not supported.
+		parameter [0:0]	OPT_AXI = 1'b0,
+		parameter	C_AXI_ID_WIDTH = 1,
+		parameter	LGAXIBURST = 8, LGAXIOUT = 2,
+		// OPT_DMAQOS gives the Wishbone DMA port to whichever of the
+		// read or write DMAs has its FIFO closest to overflowing or
+		// running dry.  Equally urgent DMAs take turns every
+		// DMA_QUANTUM bus requests.
+		parameter [0:0]	OPT_DMAQOS = 1'b0,
+		parameter	DMA_QUANTUM = 16,
 		parameter	DW = 32,	// Wishbone width
 				AW = 30		// Wishbone address width
 		// }}}
@@ -56,7 +82,7 @@ module	sata_controller #(
 		// Wishbone SOC interface
 		// {{{
 		input	wire		i_wb_cyc, i_wb_stb, i_wb_we,
-		input	wire	[2:0]	i_wb_addr,
+		input	wire	[3:0]	i_wb_addr,
 		input	wire	[31:0]	i_wb_data,
 		input	wire	[3:0]	i_wb_sel,
 		//
@@ -76,6 +102,50 @@ module	sata_controller #(
 		input	wire [DW-1:0]	i_dma_data,
 		input	wire		i_dma_err,
 		// }}}
+		// AXI4 DMA interface, used only if OPT_AXI
+		// {{{
+		output	wire			M_AXI_AWVALID,
+		input	wire			M_AXI_AWREADY,
+		output	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_AWID,
+		output	wire [AW+$clog2(DW/8)-1:0]	M_AXI_AWADDR,
+		output	wire	[7:0]		M_AXI_AWLEN,
+		output	wire	[2:0]		M_AXI_AWSIZE,
+		output	wire	[1:0]		M_AXI_AWBURST,
+		output	wire			M_AXI_AWLOCK,
+		output	wire	[3:0]		M_AXI_AWCACHE,
+		output	wire	[2:0]		M_AXI_AWPROT,
+		output	wire	[3:0]		M_AXI_AWQOS,
+		//
+		output	wire			M_AXI_WVALID,
+		input	wire			M_AXI_WREADY,
+		output	wire	[DW-1:0]	M_AXI_WDATA,
+		output	wire	[DW/8-1:0]	M_AXI_WSTRB,
+		output	wire			M_AXI_WLAST,
+		//
+		input	wire			M_AXI_BVALID,
+		output	wire			M_AXI_BREADY,
+		input	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_BID,
+		input	wire	[1:0]		M_AXI_BRESP,
+		//
+		output	wire			M_AXI_ARVALID,
+		input	wire			M_AXI_ARREADY,
+		output	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_ARID,
+		output	wire [AW+$clog2(DW/8)-1:0]	M_AXI_ARADDR,
+		output	wire	[7:0]		M_AXI_ARLEN,
+		output	wire	[2:0]		M_AXI_ARSIZE,
+		output	wire	[1:0]		M_AXI_ARBURST,
+		output	wire			M_AXI_ARLOCK,
+		output	wire	[3:0]		M_AXI_ARCACHE,
+		output	wire	[2:0]		M_AXI_ARPROT,
+		output	wire	[3:0]		M_AXI_ARQOS,
+		//
+		input	wire			M_AXI_RVALID,
+		output	wire			M_AXI_RREADY,
+		input	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_RID,
+		input	wire	[DW-1:0]	M_AXI_RDATA,
+		input	wire			M_AXI_RLAST,
+		input	wire	[1:0]		M_AXI_RRESP,
+		// }}}
 		output	wire		o_int,		// Interrupt
 		// Link <-> PHY interface
 		// {{{
@@ -130,6 +200,7 @@ module	sata_controller #(
 	wire		tx_link_primitive;
 	wire	[31:0]	tx_link_data;
 	wire		link_reset_request;
+	wire	[3:0]	link_events;
 	reg		rx_linkup, rx_linkup_xpipe;
 	// }}}
 
@@ -149,7 +220,12 @@ module	sata_controller #(
 	// Transport layer
 	// {{{
 	sata_transport #(
-		.LGFIFO(LGFIFO), .AW(AW), .DW(DW)
+		.LGFIFO(LGFIFO), .LGAFIFO(LGAFIFO), .AW(AW), .DW(DW),
+		.OPT_PREFETCH(OPT_PREFETCH), .OPT_CUTTHROUGH(OPT_CUTTHROUGH),
+		.OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN),
+		.OPT_AXI(OPT_AXI), .C_AXI_ID_WIDTH(C_AXI_ID_WIDTH),
+		.LGAXIBURST(LGAXIBURST), .LGAXIOUT(LGAXIOUT),
+		.OPT_DMAQOS(OPT_DMAQOS), .DMA_QUANTUM(DMA_QUANTUM)
 	) u_transport (
 		// {{{
 		.i_clk(i_clk), .i_reset(i_reset),
@@ -175,6 +251,33 @@ module	sata_controller #(
 		.i_dma_ack(i_dma_ack), .i_dma_data(i_dma_data),
 		.i_dma_err(i_dma_err),
 		// }}}
+		// AXI4 DMA interface
+		// {{{
+		.M_AXI_AWVALID(M_AXI_AWVALID), .M_AXI_AWREADY(M_AXI_AWREADY),
+		.M_AXI_AWID(M_AXI_AWID), .M_AXI_AWADDR(M_AXI_AWADDR),
+		.M_AXI_AWLEN(M_AXI_AWLEN), .M_AXI_AWSIZE(M_AXI_AWSIZE),
+		.M_AXI_AWBURST(M_AXI_AWBURST), .M_AXI_AWLOCK(M_AXI_AWLOCK),
+		.M_AXI_AWCACHE(M_AXI_AWCACHE), .M_AXI_AWPROT(M_AXI_AWPROT),
+		.M_AXI_AWQOS(M_AXI_AWQOS),
+		//
+		.M_AXI_WVALID(M_AXI_WVALID), .M_AXI_WREADY(M_AXI_WREADY),
+		.M_AXI_WDATA(M_AXI_WDATA), .M_AXI_WSTRB(M_AXI_WSTRB),
+		.M_AXI_WLAST(M_AXI_WLAST),
+		//
+		.M_AXI_BVALID(M_AXI_BVALID), .M_AXI_BREADY(M_AXI_BREADY),
+		.M_AXI_BID(M_AXI_BID), .M_AXI_BRESP(M_AXI_BRESP),
+		//
+		.M_AXI_ARVALID(M_AXI_ARVALID), .M_AXI_ARREADY(M_AXI_ARREADY),
+		.M_AXI_ARID(M_AXI_ARID), .M_AXI_ARADDR(M_AXI_ARADDR),
+		.M_AXI_ARLEN(M_AXI_ARLEN), .M_AXI_ARSIZE(M_AXI_ARSIZE),
+		.M_AXI_ARBURST(M_AXI_ARBURST), .M_AXI_ARLOCK(M_AXI_ARLOCK),
+		.M_AXI_ARCACHE(M_AXI_ARCACHE), .M_AXI_ARPROT(M_AXI_ARPROT),
+		.M_AXI_ARQOS(M_AXI_ARQOS),
+		//
+		.M_AXI_RVALID(M_AXI_RVALID), .M_AXI_RREADY(M_AXI_RREADY),
+		.M_AXI_RID(M_AXI_RID), .M_AXI_RDATA(M_AXI_RDATA),
+		.M_AXI_RLAST(M_AXI_RLAST), .M_AXI_RRESP(M_AXI_RRESP),
+		// }}}
 		.o_int(o_int),	// Interrupt
 		// Link layer interface
 		// {{{
@@ -196,6 +299,7 @@ module	sata_controller #(
 		//
 		.i_link_err(link_error),
 		.i_link_ready(link_ready && comlink_up),
+		.i_link_events(link_events),	// TX clock domain
 		// }}}
 		.o_debug(o_dbg_tran)		// WB clock domain
 		// }}}
@@ -250,6 +354,7 @@ module	sata_controller #(
 		.o_phy_reset(link_reset_request),
 		.i_phy_ready(tx_link_ready),
 		// }}}
+		.o_events(link_events),
 		.o_debug(o_dbg_link)		// TX clock domain
 		// }}}
 	);
@@ -90,6 +90,9 @@ module	sata_link #(
 		output	wire		o_phy_reset,
 		input	wire		i_phy_ready,
 		// }}}
+		// Performance events, one bit per clock, on i_tx_clk:
+		//	{ ALIGN sent, HOLD received, HOLD sent, R_ERR received }
+		output	reg	[3:0]	o_events,
 		output	wire	[31:0]	o_debug
 		// }}}
 	);
@@ -111,6 +114,8 @@ module	sata_link #(
 
 	wire		pre_phy_valid, pre_phy_ready;
 	wire	[32:0]	pre_phy_data;
+
+	reg		last_rx_rerr;
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -286,6 +291,33 @@ module	sata_link #(
 	);
 	// }}}
 
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Performance events
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	// R_ERR is repeated until the host responds, so count only the first
+	// of any run
+	always @(posedge i_tx_clk)
+	if (i_reset)
+		last_rx_rerr <= 1'b0;
+	else if (rx_valid)
+		last_rx_rerr <= (rx_data == P_R_ERR);
+
+	always @(posedge i_tx_clk)
+	if (i_reset)
+		o_events <= 4'h0;
+	else begin
+		o_events[0] <= rx_valid && rx_data == P_R_ERR && !last_rx_rerr;
+		o_events[1] <= pre_phy_ready && pre_phy_data == P_HOLD;
+		o_events[2] <= rx_valid && rx_data == P_HOLD;
+		o_events[3] <= { o_phy_primitive, o_phy_data } == P_ALIGN;
+	end
+	// }}}
+
 	// Keep Verilator happy
 	// {{{
 	// Verilator lint_off UNUSED
@@ -7,11 +7,12 @@
 // Purpose:	
 //
 //	Registers:
-//	0-4:	Shadow register copy, includes BSY bit
-//	5:	DMA Write address
-//	6:	DMA Read address
+//	0-3:	Shadow register copy, includes BSY bit
+//	4:	Performance counters, see satatrn_perf.v
+//	5:	(My status register)
+//	6-7:	DMA address
 //	:	DMA Length (found in the shadow register transfer count)
-//	7:	(My status register)
+//	8-15:	Command queue registers, see satatrn_queue.v
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -50,10 +51,45 @@ module	sata_transport #(
 		parameter	DW = 32, AW=30,
 		// Verilator lint_off UNUSED
 		parameter [0:0]	OPT_LOWPOWER = 1'b0,
-				OPT_LITTLE_ENDIAN = 1'b0,
 		// Verilator lint_on  UNUSED
+		// OPT_LITTLE_ENDIAN: The first byte of a DATA FIS goes to (or
+		// comes from) the lowest address of each bus word, rather
+		// than its most significant byte.  Sector buffers then match
+		// the disk byte for byte on a little endian CPU.
+		parameter [0:0]	OPT_LITTLE_ENDIAN = 1'b0,
 		parameter	LGFIFO = 12,
-		parameter	LGAFIFO=  12
+		parameter	LGAFIFO=  12,
+		// OPT_PREFETCH: Read the first DATA FIS of a DMA write from
+		// memory before the device asks for it.  Only takes effect
+		// if the TX FIFO can hold an entire DATA FIS.
+		parameter [0:0]	OPT_PREFETCH = 1'b0,
+		// OPT_CUTTHROUGH: Incoming DATA FISs are written to memory as
+		// they arrive.  A CRC failure on one is reported as an ICRC
+		// error in the command's status, rather than aborting the
+		// transfer.  Since the link layer holds off the device (HOLD)
+		// whenever the RX FIFO fills, the FIFO doesn't then need to
+		// hold an entire 8kB DATA FIS.  A few hundred bytes is enough
+		// to ride out bus latency.
+		parameter [0:0]	OPT_CUTTHROUGH = 1'b0,
+		// OPT_AXI: Move DATA FIS contents to and from memory using a
+		// pair of AXI4 burst masters, M_AXI_*, rather than through the
+		// Wishbone DMA port.  Reads and writes then use their own
+		// channels, and so no longer share an arbiter.  The command
+		// queue still reads its descriptors over the Wishbone DMA
+		// port, and scatter-gather mode is not available.
+		parameter [0:0]	OPT_AXI = 1'b0,
+		parameter	C_AXI_ID_WIDTH = 1,
+		// Longest AXI burst (2^8 = 256 beats), and the maximum number
+		// of bursts outstanding in each direction
+		parameter	LGAXIBURST = 8, LGAXIOUT = 2,
+		// OPT_DMAQOS: Share the Wishbone DMA port between reads and
+		// writes by urgency, rather than simply alternating between
+		// them.  The DMA whose FIFO is closer to overflowing (reads)
+		// or running dry (writes) gets the bus, even if that means
+		// taking it from the other mid-transfer.  Equally urgent
+		// engines take turns every DMA_QUANTUM bus requests.
+		parameter [0:0]	OPT_DMAQOS = 1'b0,
+		parameter	DMA_QUANTUM = 16
 		// }}}
 	) (
 		// {{{
@@ -66,7 +102,7 @@ module	sata_transport #(
 		// Wishbone SOC interface
 		// {{{
 		input	wire		i_wb_cyc, i_wb_stb, i_wb_we,
-		input	wire	[2:0]	i_wb_addr,
+		input	wire	[3:0]	i_wb_addr,
 		input	wire	[31:0]	i_wb_data,
 		input	wire	[3:0]	i_wb_sel,
 		//
@@ -86,6 +122,50 @@ module	sata_transport #(
 		input	wire [DW-1:0]	i_dma_data,
 		input	wire		i_dma_err,
 		// }}}
+		// AXI4 DMA interface, used only if OPT_AXI
+		// {{{
+		output	wire			M_AXI_AWVALID,
+		input	wire			M_AXI_AWREADY,
+		output	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_AWID,
+		output	wire [AW+$clog2(DW/8)-1:0]	M_AXI_AWADDR,
+		output	wire	[7:0]		M_AXI_AWLEN,
+		output	wire	[2:0]		M_AXI_AWSIZE,
+		output	wire	[1:0]		M_AXI_AWBURST,
+		output	wire			M_AXI_AWLOCK,
+		output	wire	[3:0]		M_AXI_AWCACHE,
+		output	wire	[2:0]		M_AXI_AWPROT,
+		output	wire	[3:0]		M_AXI_AWQOS,
+		//
+		output	wire			M_AXI_WVALID,
+		input	wire			M_AXI_WREADY,
+		output	wire	[DW-1:0]	M_AXI_WDATA,
+		output	wire	[DW/8-1:0]	M_AXI_WSTRB,
+		output	wire			M_AXI_WLAST,
+		//
+		input	wire			M_AXI_BVALID,
+		output	wire			M_AXI_BREADY,
+		input	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_BID,
+		input	wire	[1:0]		M_AXI_BRESP,
+		//
+		output	wire			M_AXI_ARVALID,
+		input	wire			M_AXI_ARREADY,
+		output	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_ARID,
+		output	wire [AW+$clog2(DW/8)-1:0]	M_AXI_ARADDR,
+		output	wire	[7:0]		M_AXI_ARLEN,
+		output	wire	[2:0]		M_AXI_ARSIZE,
+		output	wire	[1:0]		M_AXI_ARBURST,
+		output	wire			M_AXI_ARLOCK,
+		output	wire	[3:0]		M_AXI_ARCACHE,
+		output	wire	[2:0]		M_AXI_ARPROT,
+		output	wire	[3:0]		M_AXI_ARQOS,
+		//
+		input	wire			M_AXI_RVALID,
+		output	wire			M_AXI_RREADY,
+		input	wire [C_AXI_ID_WIDTH-1:0]	M_AXI_RID,
+		input	wire	[DW-1:0]	M_AXI_RDATA,
+		input	wire			M_AXI_RLAST,
+		input	wire	[1:0]		M_AXI_RRESP,
+		// }}}
 		output	wire		o_int,
 		// Link layer interface
 		// {{{
@@ -107,6 +187,8 @@ module	sata_transport #(
 		input	wire		i_tran_abort,
 		//
 		input	wire		i_link_err, i_link_ready,
+		// Link performance events, on i_phy_clk
+		input	wire	[3:0]	i_link_events,
 		// }}}
 		output	wire	[31:0]	o_debug
 		// }}}
@@ -119,6 +201,8 @@ module	sata_transport #(
 	localparam	ADDRESS_WIDTH=AW+$clog2(DW/8);
 	localparam	[$clog2(DW/8):0]	GEAR_32BYTES = 4;
 	localparam	LGLENGTH=11;
+	localparam	LGFILL = LGFIFO-$clog2(DW/8)+1;
+	localparam	LGLEVEL = 4;
 
 	reg		phy_reset_n;
 	reg	[1:0]	phy_reset_xpipe;
@@ -135,8 +219,12 @@ module	sata_transport #(
 	wire	[AW-1:0]	s2mm_addr, mm2s_addr;
 	wire	[DW-1:0]	ign_s2mm_data, mm2s_bus_data;
 	wire	[DW/8-1:0]	s2mm_sel, mm2s_sel;
+	wire	[LGLEVEL-1:0]	s2mm_level, mm2s_level,
+				rx_fill_level, tx_fill_level;
+	wire			s2mm_wait, mm2s_wait;
 
-	wire			s2mm_core_request, s2mm_core_busy,s2mm_core_err;
+	wire			s2mm_core_request, s2mm_core_busy,s2mm_core_err,
+				s2mm_beat;
 	wire	[ADDRESS_WIDTH-1:0]	s2mm_core_addr, mm2s_core_addr;
 	wire			mm2s_core_request, mm2s_core_busy,mm2s_core_err;
 
@@ -149,7 +237,7 @@ module	sata_transport #(
 
 	wire			rxfifo_full, rx_afifo_empty;
 	wire	[1+$clog2(DW/8)+DW-1:0]	rx_afifo_data;
-	wire	[LGFIFO-$clog2(DW/8):0]	ign_rxfifo_fill;
+	wire	[LGFIFO-$clog2(DW/8):0]	rxfifo_fill;
 	wire		rxfifo_valid, rxfifo_ready, rxfifo_last, rxfifo_empty;
 	wire	[$clog2(DW/8)-1:0]	rxfifo_bytes;
 	wire	[DW-1:0]		rxfifo_data;
@@ -166,7 +254,7 @@ module	sata_transport #(
 	wire			txfifo_full, txfifo_empty, txfifo_last;
 	wire	[DW-1:0]	txfifo_data;
 	wire [$clog2(DW/8)-1:0]	txfifo_bytes;
-	wire	[LGFIFO-$clog2(DW/8):0]	ign_txfifo_fill;
+	wire	[LGFIFO-$clog2(DW/8):0]	txfifo_fill;
 
 	wire			tx_afifo_full, tx_afifo_rd, tx_afifo_last,
 				tx_afifo_empty;
@@ -177,9 +265,15 @@ module	sata_transport #(
 	wire	[31:0]		fis_data;
 
 	reg	tx_gate;
+	wire	tx_hold, tx_flush;
+
+	wire		rx_crcerr_phy, rx_crcerr;
+	reg		rx_crcerr_toggle;
+	reg	[2:0]	rx_crcerr_pipe;
 
 	wire		datarx_valid, datarx_last, ign_datarx_ready;
-	wire	[31:0]	datarx_data;
+	wire	[31:0]	datarx_data, txdata_link;
+	wire	[DW-1:0]	datarx_bus;
 
 	// Verilator lint_off UNUSED
 	wire			tran_request, tranreq_src;
@@ -190,6 +284,46 @@ module	sata_transport #(
 
 	reg	wb_link_up, wb_link_up_xpipe;
 
+	wire			sg_enable, sg_start, ign_sg_err;
+	wire	[ADDRESS_WIDTH-1:0]	sg_table;
+	wire			arb_cyc, arb_stb, arb_we,
+				arb_stall, arb_ack, arb_err;
+	wire	[AW-1:0]	arb_addr;
+	wire	[DW-1:0]	arb_data;
+	wire	[DW/8-1:0]	arb_sel;
+	wire			sg_cyc, sg_stb, sg_we,
+				sg_stall, sg_ack, sg_err;
+	wire	[AW-1:0]	sg_addr;
+	wire	[DW-1:0]	sg_data;
+	wire	[DW/8-1:0]	sg_sel;
+
+	wire			fsm_cyc, fsm_stb, fsm_we,
+				fsm_stall, fsm_ack, fsm_busy, fsm_int;
+	wire	[2:0]		fsm_addr;
+	wire	[31:0]		fsm_data, fsm_idata;
+	wire	[3:0]		fsm_sel;
+	wire			ext_stall, ext_ack, ign_ext_err;
+	wire			ign_ext_wait, ign_qctl_wait,
+				ign_sg_wait, ign_qdma_wait;
+
+	wire			q_enable, q_int, q_wb_ack;
+	wire	[31:0]		q_wb_data;
+	wire			qctl_cyc, qctl_stb, qctl_we,
+				qctl_stall, qctl_ack, ign_qctl_err;
+	wire	[2:0]		qctl_addr;
+	wire	[31:0]		qctl_data;
+	wire	[3:0]		qctl_sel;
+	wire			qdma_cyc, qdma_stb, qdma_we,
+				qdma_stall, qdma_ack, qdma_err;
+	wire	[AW-1:0]	qdma_addr;
+	wire	[DW-1:0]	qdma_data;
+	wire	[DW/8-1:0]	qdma_sel;
+
+	wire			cmd_read, cmd_write, perf_ack;
+	wire	[16:0]		cmd_sectors;
+	wire	[31:0]		perf_data, ctl_idata;
+	wire			perf_dma_cyc, perf_dma_stall;
+
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -226,22 +360,26 @@ module	sata_transport #(
 	//
 	//
 
+	// A CRC failure on an incoming DATA FIS, in cut-through mode, is
+	// only an error report.  It doesn't abort the transfer.
 	reg	wb_tran_abort, wb_tran_abort_xpipe;
 	initial	{ wb_tran_abort, wb_tran_abort_xpipe } = 2'b00;
 	always @(posedge i_clk)
-		{ wb_tran_abort, wb_tran_abort_xpipe } <= { wb_tran_abort_xpipe, i_tran_abort };
+		{ wb_tran_abort, wb_tran_abort_xpipe } <= { wb_tran_abort_xpipe,
+					i_tran_abort && !rx_crcerr_phy };
 
-	satatrn_rxregfis
-	u_rxregfis(
+	satatrn_rxregfis #(
+		.OPT_CUTTHROUGH(OPT_CUTTHROUGH)
+	) u_rxregfis(
 		// {{{
 		.i_clk(i_clk), .i_reset(i_reset),
 		.i_phy_clk(i_phy_clk), .i_phy_reset_n(phy_reset_n),
-		.i_link_err(i_link_err || i_tran_abort),
+		.i_link_err(i_link_err),
+		.i_abort(i_tran_abort),
 		//
 		.i_valid(i_tran_valid),
 		.i_data(i_tran_data),
 		.i_last(i_tran_last),
-		// .i_abort(i_tran_abort),
 		//
 		.o_reg_valid(fis_valid),
 		.o_reg_data(fis_data),
@@ -249,33 +387,56 @@ module	sata_transport #(
 		//
 		.o_data_valid(datarx_valid),
 		.o_data_data(datarx_data),
-		.o_data_last(datarx_last)
+		.o_data_last(datarx_last),
+		.o_data_err(rx_crcerr_phy)
 		// }}}
 	);
 
+	// rx_crcerr: Move the CRC failure into the bus clock domain
+	// {{{
+	// It's a single PHY clock pulse, so send it across as a toggle
+	always @(posedge i_phy_clk)
+	if (!phy_reset_n)
+		rx_crcerr_toggle <= 1'b0;
+	else if (rx_crcerr_phy)
+		rx_crcerr_toggle <= !rx_crcerr_toggle;
+
+	always @(posedge i_clk)
+	if (i_reset)
+		rx_crcerr_pipe <= 3'b0;
+	else
+		rx_crcerr_pipe <= { rx_crcerr_pipe[1:0], rx_crcerr_toggle };
+
+	assign	rx_crcerr = rx_crcerr_pipe[2] ^ rx_crcerr_pipe[1];
+	// }}}
+
 	satatrn_fsm #(
-		.ADDRESS_WIDTH(ADDRESS_WIDTH), .DW(DW), .LGLENGTH(LGLENGTH)
+		.ADDRESS_WIDTH(ADDRESS_WIDTH), .DW(DW), .LGLENGTH(LGLENGTH),
+		.OPT_PREFETCH(OPT_PREFETCH && (LGFIFO >= LGLENGTH)),
+		.OPT_SG(!OPT_AXI)
 	) u_fsm (
 		.i_clk(i_clk), .i_reset(i_reset),
 		.o_phy_reset(o_phy_reset),
 		// Wishbone control inputs
 		// {{{
-		.i_wb_cyc(i_wb_cyc),	.i_wb_stb(i_wb_stb),
-		.i_wb_we(i_wb_we),	.i_wb_addr(i_wb_addr),
-		.i_wb_data(i_wb_data),	.i_wb_sel(i_wb_sel),
-		.o_wb_stall(o_wb_stall),.o_wb_ack(o_wb_ack),
-		.o_wb_data(o_wb_data),
+		.i_wb_cyc(fsm_cyc),	.i_wb_stb(fsm_stb),
+		.i_wb_we(fsm_we),	.i_wb_addr(fsm_addr),
+		.i_wb_data(fsm_data),	.i_wb_sel(fsm_sel),
+		.o_wb_stall(fsm_stall),	.o_wb_ack(fsm_ack),
+		.o_wb_data(fsm_idata),
 		// }}}
+		.o_busy(fsm_busy),
 		.i_link_up(wb_link_up),
 		// .o_link_reset _request
 		//
 		.o_tran_req(tran_request),
 		.i_tran_busy(s2mm_core_busy || mm2s_core_busy), // tranreq_busy),
 		.i_tran_err(wb_tran_abort),
+		.i_crc_err(rx_crcerr),
 		.o_tran_src(tranreq_src),
 		.o_tran_len(tranreq_len),
 		//
-		.o_int(o_int),
+		.o_int(fsm_int),
 		//
 		.s_pkt_valid(fis_valid),
 		.s_data(fis_data),
@@ -292,7 +453,7 @@ module	sata_transport #(
 		.i_s2mm_err(s2mm_core_err),
 		.o_s2mm_addr(s2mm_core_addr),
 		//
-		.i_s2mm_beat(s2mm_stb && !s2mm_stall),
+		.i_s2mm_beat(s2mm_beat),
 		// }}}
 		// MM2S control signals
 		// {{{
@@ -301,6 +462,12 @@ module	sata_transport #(
 		.i_mm2s_err(mm2s_core_err),
 		.o_mm2s_addr(mm2s_core_addr),
 		// }}}
+		.o_tx_hold(tx_hold), .o_tx_flush(tx_flush),
+		.o_sg_enable(sg_enable),
+		.o_sg_start(sg_start),
+		.o_sg_table(sg_table),
+		.o_cmd_read(cmd_read), .o_cmd_write(cmd_write),
+		.o_cmd_sectors(cmd_sectors),
 		.o_debug(o_debug)
 	);
 
@@ -313,10 +480,29 @@ module	sata_transport #(
 	//
 	//
 
+	// datarx_bus: Link to bus byte order
+	// {{{
+	// The link layer places the first byte of each dword in bits [31:24].
+	// The gears expect their valid bytes at the top of the bus word when
+	// big endian, and at the bottom when little endian.  In the little
+	// endian case, the first byte on the wire then lands at the lowest
+	// address.
+	generate if (OPT_LITTLE_ENDIAN)
+	begin : GEN_LE_RXDATA
+		assign	datarx_bus = { {(DW-32){1'b0}},
+				datarx_data[ 7: 0], datarx_data[15: 8],
+				datarx_data[23:16], datarx_data[31:24] };
+	end else begin : GEN_BE_RXDATA
+		assign	datarx_bus = { datarx_data[ 7: 0], datarx_data[15: 8],
+				datarx_data[23:16], datarx_data[31:24],
+				{(DW-32){1'b0}} };
+	end endgenerate
+	// }}}
+
 	// RX Gears, to pack incoming 32b words into bus words
 
 	satadma_rxgears #(
-		.BUS_WIDTH(DW), .OPT_LITTLE_ENDIAN(1'b0)
+		.BUS_WIDTH(DW), .OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN)
 	) u_rxgears (
 		// {{{
 		.i_clk(i_phy_clk), .i_reset(!phy_reset_n),
@@ -328,9 +514,7 @@ module	sata_transport #(
 		// {{{
 		.S_VALID(datarx_valid),
 		.S_READY(ign_datarx_ready),
-		.S_DATA({ datarx_data[ 7: 0], datarx_data[15: 8],
-				datarx_data[23:16], datarx_data[31:24],
-				{(DW-32){1'b0}} }),
+		.S_DATA(datarx_bus),
 		.S_BYTES(GEAR_32BYTES),
 		.S_LAST(datarx_last),
 		// }}}
@@ -369,7 +553,7 @@ module	sata_transport #(
 		.i_clk(i_clk), .i_reset(i_reset || wb_tran_abort || rxdma_reset),
 		//
 		.i_wr(!rx_afifo_empty), .i_data(rx_afifo_data),
-		.o_full(rxfifo_full), .o_fill(ign_rxfifo_fill),
+		.o_full(rxfifo_full), .o_fill(rxfifo_fill),
 		//
 		.i_rd(rxfifo_ready), 
 		.o_data({ rxfifo_last, rxfifo_bytes, rxfifo_data }),
@@ -381,34 +565,123 @@ module	sata_transport #(
 	assign	rxgear_ready = !o_tran_full;
 	assign	rxfifo_valid = !rxfifo_empty;
 
-	satadma_s2mm #(
-		.ADDRESS_WIDTH(ADDRESS_WIDTH), .BUS_WIDTH(DW),
-		.OPT_LITTLE_ENDIAN(1'b0)
-	) u_s2mm (
+	generate if (OPT_AXI)
+	begin : GEN_AXI_S2MM
 		// {{{
-		.i_clk(i_clk), .i_reset(i_reset || wb_tran_abort),
-		//
-		.i_request(s2mm_core_request),
-		.o_busy(s2mm_core_busy),
-		.o_err(s2mm_core_err),
-		.i_inc(DMA_INC),
-		.i_size(SZ_BUS),
-		.i_addr(s2mm_core_addr),
-		//
-		.S_VALID(rxfifo_valid),
-		.S_READY(rxfifo_ready),
-		.S_DATA( rxfifo_data),
-		.S_BYTES({ (rxfifo_bytes==0), rxfifo_bytes }),
-		.S_LAST( rxfifo_last),
-		//
-		.o_wr_cyc(s2mm_cyc), .o_wr_stb(s2mm_stb), .o_wr_we(s2mm_we),
-		.o_wr_addr(s2mm_addr), .o_wr_data(ign_s2mm_data),
-		.o_wr_sel(s2mm_sel),
-		.i_wr_stall(s2mm_stall), .i_wr_ack(s2mm_ack),
-		.i_wr_data({(DW){1'b0}}),
-		.i_wr_err(s2mm_err)
+		satadma_axi_s2mm #(
+			.ADDRESS_WIDTH(ADDRESS_WIDTH), .BUS_WIDTH(DW),
+			.OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN),
+			.C_AXI_ID_WIDTH(C_AXI_ID_WIDTH),
+			.LGMAXBURST(LGAXIBURST), .LGMAXOUT(LGAXIOUT)
+		) u_s2mm (
+			// {{{
+			// An abort must finish any burst already started
+			.i_clk(i_clk), .i_reset(i_reset),
+			//
+			.i_request(s2mm_core_request),
+			.o_busy(s2mm_core_busy),
+			.o_err(s2mm_core_err),
+			.i_abort(wb_tran_abort),
+			.i_addr(s2mm_core_addr),
+			//
+			.S_VALID(rxfifo_valid),
+			.S_READY(rxfifo_ready),
+			.S_DATA( rxfifo_data),
+			.S_BYTES({ (rxfifo_bytes==0), rxfifo_bytes }),
+			.S_LAST( rxfifo_last),
+			//
+			.M_AXI_AWVALID(M_AXI_AWVALID),
+			.M_AXI_AWREADY(M_AXI_AWREADY),
+			.M_AXI_AWID(   M_AXI_AWID),
+			.M_AXI_AWADDR( M_AXI_AWADDR),
+			.M_AXI_AWLEN(  M_AXI_AWLEN),
+			.M_AXI_AWSIZE( M_AXI_AWSIZE),
+			.M_AXI_AWBURST(M_AXI_AWBURST),
+			.M_AXI_AWLOCK( M_AXI_AWLOCK),
+			.M_AXI_AWCACHE(M_AXI_AWCACHE),
+			.M_AXI_AWPROT( M_AXI_AWPROT),
+			.M_AXI_AWQOS(  M_AXI_AWQOS),
+			//
+			.M_AXI_WVALID(M_AXI_WVALID),
+			.M_AXI_WREADY(M_AXI_WREADY),
+			.M_AXI_WDATA( M_AXI_WDATA),
+			.M_AXI_WSTRB( M_AXI_WSTRB),
+			.M_AXI_WLAST( M_AXI_WLAST),
+			//
+			.M_AXI_BVALID(M_AXI_BVALID),
+			.M_AXI_BREADY(M_AXI_BREADY),
+			.M_AXI_BID(   M_AXI_BID),
+			.M_AXI_BRESP( M_AXI_BRESP)
+			// }}}
+		);
+
+		// Nothing goes to the Wishbone arbiter
+		assign	{ s2mm_cyc, s2mm_stb, s2mm_we } = 3'b000;
+		assign	s2mm_addr     = {(AW){1'b0}};
+		assign	ign_s2mm_data = {(DW){1'b0}};
+		assign	s2mm_sel      = {(DW/8){1'b0}};
+
+		assign	s2mm_beat = M_AXI_WVALID && M_AXI_WREADY;
 		// }}}
-	);
+	end else begin : GEN_WB_S2MM
+		// {{{
+		satadma_s2mm #(
+			.ADDRESS_WIDTH(ADDRESS_WIDTH), .BUS_WIDTH(DW),
+			.OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN)
+		) u_s2mm (
+			// {{{
+			.i_clk(i_clk), .i_reset(i_reset || wb_tran_abort),
+			//
+			.i_request(s2mm_core_request),
+			.o_busy(s2mm_core_busy),
+			.o_err(s2mm_core_err),
+			.i_inc(DMA_INC),
+			.i_size(SZ_BUS),
+			.i_addr(s2mm_core_addr),
+			//
+			.S_VALID(rxfifo_valid),
+			.S_READY(rxfifo_ready),
+			.S_DATA( rxfifo_data),
+			.S_BYTES({ (rxfifo_bytes==0), rxfifo_bytes }),
+			.S_LAST( rxfifo_last),
+			//
+			.o_wr_cyc(s2mm_cyc), .o_wr_stb(s2mm_stb),
+			.o_wr_we(s2mm_we),
+			.o_wr_addr(s2mm_addr), .o_wr_data(ign_s2mm_data),
+			.o_wr_sel(s2mm_sel),
+			.i_wr_stall(s2mm_stall), .i_wr_ack(s2mm_ack),
+			.i_wr_data({(DW){1'b0}}),
+			.i_wr_err(s2mm_err)
+			// }}}
+		);
+
+		assign	s2mm_beat = s2mm_stb && !s2mm_stall;
+
+		assign	M_AXI_AWVALID = 1'b0;
+		assign	M_AXI_AWID    = {(C_AXI_ID_WIDTH){1'b0}};
+		assign	M_AXI_AWADDR  = {(ADDRESS_WIDTH){1'b0}};
+		assign	M_AXI_AWLEN   = 8'h0;
+		assign	M_AXI_AWSIZE  = 3'h0;
+		assign	M_AXI_AWBURST = 2'h0;
+		assign	M_AXI_AWLOCK  = 1'b0;
+		assign	M_AXI_AWCACHE = 4'h0;
+		assign	M_AXI_AWPROT  = 3'h0;
+		assign	M_AXI_AWQOS   = 4'h0;
+
+		assign	M_AXI_WVALID  = 1'b0;
+		assign	M_AXI_WDATA   = {(DW){1'b0}};
+		assign	M_AXI_WSTRB   = {(DW/8){1'b0}};
+		assign	M_AXI_WLAST   = 1'b0;
+
+		assign	M_AXI_BREADY  = 1'b0;
+
+		// Verilator lint_off UNUSED
+		wire	unused_axi;
+		assign	unused_axi = &{ 1'b0, M_AXI_AWREADY, M_AXI_WREADY,
+				M_AXI_BVALID, M_AXI_BID, M_AXI_BRESP };
+		// Verilator lint_on  UNUSED
+		// }}}
+	end endgenerate
 
 	// }}}
 	////////////////////////////////////////////////////////////////////////
@@ -420,37 +693,114 @@ module	sata_transport #(
 	//
 
 	// MM2S
-	satadma_mm2s #(
-		.ADDRESS_WIDTH(ADDRESS_WIDTH), .BUS_WIDTH(DW),
-		.LGLENGTH(LGLENGTH)
-	) u_mm2s (
+	generate if (OPT_AXI)
+	begin : GEN_AXI_MM2S
 		// {{{
-		.i_clk(i_clk), .i_reset(i_reset || wb_tran_abort),
-		//
-		.i_request(mm2s_core_request),
-		.o_busy(mm2s_core_busy), .o_err(mm2s_core_err),
-		.i_inc(DMA_INC), .i_size(SZ_BUS),
-		.i_transferlen(tranreq_len),
-		.i_addr(mm2s_core_addr),
-		//
-		.o_rd_cyc(mm2s_cyc), .o_rd_stb(mm2s_stb), .o_rd_we(mm2s_we),
-		.o_rd_addr(mm2s_addr), .o_rd_data(mm2s_bus_data),
-		.o_rd_sel(mm2s_sel),
-		.i_rd_stall(mm2s_stall), .i_rd_ack(mm2s_ack),
-		.i_rd_data(i_dma_data),
-		.i_rd_err(mm2s_err),
-		//
-		.M_VALID(mm2s_valid),
-		.M_READY(1'b1 || mm2s_ready),	// *MUST* be one, no FIFO here
-		.M_DATA(mm2s_data),
-		.M_BYTES(mm2s_bytes),
-		.M_LAST(mm2s_last)
+		satadma_axi_mm2s #(
+			.ADDRESS_WIDTH(ADDRESS_WIDTH), .BUS_WIDTH(DW),
+			.LGLENGTH(LGLENGTH),
+			.C_AXI_ID_WIDTH(C_AXI_ID_WIDTH),
+			.LGMAXBURST(LGAXIBURST), .LGMAXOUT(LGAXIOUT)
+		) u_mm2s (
+			// {{{
+			.i_clk(i_clk), .i_reset(i_reset),
+			//
+			.i_request(mm2s_core_request),
+			.o_busy(mm2s_core_busy), .o_err(mm2s_core_err),
+			.i_abort(wb_tran_abort),
+			.i_transferlen(tranreq_len),
+			.i_addr(mm2s_core_addr),
+			//
+			.M_AXI_ARVALID(M_AXI_ARVALID),
+			.M_AXI_ARREADY(M_AXI_ARREADY),
+			.M_AXI_ARID(   M_AXI_ARID),
+			.M_AXI_ARADDR( M_AXI_ARADDR),
+			.M_AXI_ARLEN(  M_AXI_ARLEN),
+			.M_AXI_ARSIZE( M_AXI_ARSIZE),
+			.M_AXI_ARBURST(M_AXI_ARBURST),
+			.M_AXI_ARLOCK( M_AXI_ARLOCK),
+			.M_AXI_ARCACHE(M_AXI_ARCACHE),
+			.M_AXI_ARPROT( M_AXI_ARPROT),
+			.M_AXI_ARQOS(  M_AXI_ARQOS),
+			//
+			.M_AXI_RVALID(M_AXI_RVALID),
+			.M_AXI_RREADY(M_AXI_RREADY),
+			.M_AXI_RID(   M_AXI_RID),
+			.M_AXI_RDATA( M_AXI_RDATA),
+			.M_AXI_RLAST( M_AXI_RLAST),
+			.M_AXI_RRESP( M_AXI_RRESP),
+			//
+			.M_VALID(mm2s_valid),
+			.M_READY(1'b1 || mm2s_ready),	// *MUST* be one
+			.M_DATA(mm2s_data),
+			.M_BYTES(mm2s_bytes),
+			.M_LAST(mm2s_last)
+			// }}}
+		);
+
+		// Nothing goes to the Wishbone arbiter
+		assign	{ mm2s_cyc, mm2s_stb, mm2s_we } = 3'b000;
+		assign	mm2s_addr     = {(AW){1'b0}};
+		assign	mm2s_bus_data = {(DW){1'b0}};
+		assign	mm2s_sel      = {(DW/8){1'b0}};
 		// }}}
-	);
+	end else begin : GEN_WB_MM2S
+		// {{{
+		satadma_mm2s #(
+			.ADDRESS_WIDTH(ADDRESS_WIDTH), .BUS_WIDTH(DW),
+			.LGLENGTH(LGLENGTH),
+			.OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN)
+		) u_mm2s (
+			// {{{
+			.i_clk(i_clk), .i_reset(i_reset || wb_tran_abort),
+			//
+			.i_request(mm2s_core_request),
+			.o_busy(mm2s_core_busy), .o_err(mm2s_core_err),
+			.i_inc(DMA_INC), .i_size(SZ_BUS),
+			.i_transferlen(tranreq_len),
+			.i_addr(mm2s_core_addr),
+			//
+			.o_rd_cyc(mm2s_cyc), .o_rd_stb(mm2s_stb),
+			.o_rd_we(mm2s_we),
+			.o_rd_addr(mm2s_addr), .o_rd_data(mm2s_bus_data),
+			.o_rd_sel(mm2s_sel),
+			.i_rd_stall(mm2s_stall), .i_rd_ack(mm2s_ack),
+			.i_rd_data(i_dma_data),
+			.i_rd_err(mm2s_err),
+			//
+			.M_VALID(mm2s_valid),
+			.M_READY(1'b1 || mm2s_ready),	// *MUST* be one, no FIFO here
+			.M_DATA(mm2s_data),
+			.M_BYTES(mm2s_bytes),
+			.M_LAST(mm2s_last)
+			// }}}
+		);
+
+		assign	M_AXI_ARVALID = 1'b0;
+		assign	M_AXI_ARID    = {(C_AXI_ID_WIDTH){1'b0}};
+		assign	M_AXI_ARADDR  = {(ADDRESS_WIDTH){1'b0}};
+		assign	M_AXI_ARLEN   = 8'h0;
+		assign	M_AXI_ARSIZE  = 3'h0;
+		assign	M_AXI_ARBURST = 2'h0;
+		assign	M_AXI_ARLOCK  = 1'b0;
+		assign	M_AXI_ARCACHE = 4'h0;
+		assign	M_AXI_ARPROT  = 3'h0;
+		assign	M_AXI_ARQOS   = 4'h0;
+
+		assign	M_AXI_RREADY  = 1'b0;
+
+		// Verilator lint_off UNUSED
+		wire	unused_axi;
+		assign	unused_axi = &{ 1'b0, M_AXI_ARREADY, M_AXI_RVALID,
+				M_AXI_RID, M_AXI_RDATA, M_AXI_RLAST,
+				M_AXI_RRESP };
+		// Verilator lint_on  UNUSED
+		// }}}
+	end endgenerate
 
 	// TXGEARS: Partial -> BUSDW
 	satadma_rxgears #(
-		.BUS_WIDTH(DW), .OPT_LITTLE_ENDIAN(1'b0)
+		.BUS_WIDTH(DW), .OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN)
 	) u_mm2s_gears (
 		// {{{
 		.i_clk(i_clk), .i_reset(i_reset),
@@ -473,13 +823,16 @@ module	sata_transport #(
 		.BW(1+$clog2(DW/8)+DW), .LGFLEN(LGFIFO-$clog2(DW/8))
 	) u_txfifo (
 		// {{{
-		.i_clk(i_clk), .i_reset(i_reset),
+		// Prefetched write data waits here, on the bus clock side,
+		// until the device asks for it.  That way it can be flushed
+		// without needing to reset the asynchronous FIFO.
+		.i_clk(i_clk), .i_reset(i_reset || tx_flush),
 		//
 		.i_wr(mm2sgear_valid), 
 		.i_data({ mm2sgear_last, mm2sgear_bytes, mm2sgear_data }),
-		.o_full(txfifo_full), .o_fill(ign_txfifo_fill),
+		.o_full(txfifo_full), .o_fill(txfifo_fill),
 		//
-		.i_rd(!tx_afifo_full), 
+		.i_rd(!tx_afifo_full && !tx_hold), 
 		.o_data({ txfifo_last, txfifo_bytes, txfifo_data }),
 		.o_empty(txfifo_empty)
 		// }}}
@@ -494,7 +847,7 @@ module	sata_transport #(
 	) u_tx_afifo (
 		// {{{
 		.i_wclk(i_clk), .i_wr_reset_n(!i_reset),
-		.i_wr(!txfifo_empty),
+		.i_wr(!txfifo_empty && !tx_hold),
 		.i_wr_data({ txfifo_last, txfifo_bytes, txfifo_data }),
 		.o_wr_full(tx_afifo_full),
 		//
@@ -507,7 +860,7 @@ module	sata_transport #(
 
 	// TXGears: BUSDW -> 32b
 	satadma_txgears #(
-		.BUS_WIDTH(DW)
+		.BUS_WIDTH(DW), .OPT_LITTLE_ENDIAN(OPT_LITTLE_ENDIAN)
 	) u_txgears(
 		// {{{
 		.i_clk(i_phy_clk), .i_reset(!phy_reset_n),
@@ -527,6 +880,20 @@ module	sata_transport #(
 		// }}}
 	);
 
+	// txdata_link: Bus to link byte order
+	// {{{
+	// The TX gears leave the next dword at the top of their output when
+	// big endian, and at the bottom when little endian.  In the latter
+	// case, its lowest addressed byte goes first on the wire.
+	generate if (OPT_LITTLE_ENDIAN)
+	begin : GEN_LE_TXDATA
+		assign	txdata_link = { txgear_data[ 7: 0], txgear_data[15: 8],
+					txgear_data[23:16], txgear_data[31:24] };
+	end else begin : GEN_BE_TXDATA
+		assign	txdata_link = txgear_data[DW-1:DW-32];
+	end endgenerate
+	// }}}
+
 	satatrn_txarb
 	u_txarb (
 		// {{{
@@ -545,10 +912,7 @@ module	sata_transport #(
 		// {{{
 		.i_data_valid(txgear_valid),
 		.o_data_ready(txgear_ready),
-		.i_data_data({	txgear_data[DW- 1:DW- 8],
-				txgear_data[DW- 9:DW-16],
-				txgear_data[DW-17:DW-24],
-				txgear_data[DW-25:DW-32] }),
+		.i_data_data(txdata_link),
 		.i_data_last( txgear_last),
 		// }}}
 		// Outgoing packet data
@@ -575,8 +939,33 @@ module	sata_transport #(
 	//
 	// Wishbone arbiter
 	// {{{
+
+	// Urgency levels, used if OPT_DMAQOS.  Reads (s2mm) grow more urgent
+	// as the RX FIFO fills, writes (mm2s) as the TX FIFO empties--but only
+	// once its contents are being sent.  A write prefetch is never urgent.
+	generate if (LGFILL-1 >= LGLEVEL)
+	begin : GEN_FILL_LEVEL
+		assign	rx_fill_level = rxfifo_fill[LGFILL-2 -: LGLEVEL];
+		assign	tx_fill_level = txfifo_fill[LGFILL-2 -: LGLEVEL];
+	end else begin : GEN_SHORT_FILL_LEVEL
+		// FIFOs with fewer fill bits than levels: scale the fill up
+		assign	rx_fill_level = { rxfifo_fill[LGFILL-2:0],
+					{(LGLEVEL-LGFILL+1){1'b0}} };
+		assign	tx_fill_level = { txfifo_fill[LGFILL-2:0],
+					{(LGLEVEL-LGFILL+1){1'b0}} };
+	end endgenerate
+
+	assign	s2mm_level = (rxfifo_fill[LGFILL-1]) ? {(LGLEVEL){1'b1}}
+				: rx_fill_level;
+	assign	mm2s_level = (tx_hold) ? {(LGLEVEL){1'b0}}
+				: (txfifo_fill[LGFILL-1]) ? {(LGLEVEL){1'b0}}
+				: ~tx_fill_level;
+
 	satatrn_wbarbiter #(
-		.DW(DW), .AW(AW)
+		.DW(DW), .AW(AW),
+		.SCHEME(OPT_DMAQOS ? "QOS" : "ALTERNATING"),
+		.LGLEVEL(LGLEVEL), .QUANTUM(DMA_QUANTUM),
+		.LGMAXOUT(LGLENGTH+1)
 	) u_wbarbiter (
 		// {{{
 		.i_clk(i_clk), .i_reset(i_reset),
@@ -589,12 +978,183 @@ module	sata_transport #(
 		.i_b_adr(s2mm_addr), .i_b_dat(ign_s2mm_data), .i_b_sel(s2mm_sel),
 		.o_b_stall(s2mm_stall), .o_b_ack(s2mm_ack), .o_b_err(s2mm_err),
 		//
+		.i_a_level(mm2s_level), .i_b_level(s2mm_level),
+		.o_a_wait(mm2s_wait), .o_b_wait(s2mm_wait),
+		//
+		.o_cyc(arb_cyc),  .o_stb(arb_stb),  .o_we(arb_we),
+		.o_adr(arb_addr), .o_dat(arb_data), .o_sel(arb_sel),
+		.i_stall(arb_stall), .i_ack(arb_ack), .i_err(arb_err)
+		// }}}
+	);
+
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Scatter-gather descriptor walker
+	// {{{
+
+	satadma_sgwalk #(
+		.DW(DW), .AW(AW)
+	) u_sgwalk (
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset || wb_tran_abort),
+		//
+		.i_enable(sg_enable), .i_start(sg_start), .i_table(sg_table),
+		.o_err(ign_sg_err),
+		//
+		.i_cyc(arb_cyc),  .i_stb(arb_stb),  .i_we(arb_we),
+		.i_adr(arb_addr), .i_dat(arb_data), .i_sel(arb_sel),
+		.o_stall(arb_stall), .o_ack(arb_ack), .o_err_bus(arb_err),
+		//
+		.o_cyc(sg_cyc),  .o_stb(sg_stb),  .o_we(sg_we),
+		.o_adr(sg_addr), .o_dat(sg_data), .o_sel(sg_sel),
+		.i_stall(sg_stall), .i_ack(sg_ack), .i_err(sg_err),
+		.i_data(i_dma_data)
+		// }}}
+	);
+
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Command queue
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	// Registers 8-15 belong to the queue.  The rest belong to the FSM,
+	// which the queue shares with the bus.
+	satatrn_queue #(
+		.DW(DW), .AW(AW), .OPT_LOWPOWER(OPT_LOWPOWER)
+	) u_queue (
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset),
+		//
+		.i_wb_stb(i_wb_stb && i_wb_addr[3]), .i_wb_we(i_wb_we),
+		.i_wb_addr(i_wb_addr[2:0]), .i_wb_data(i_wb_data),
+		.i_wb_sel(i_wb_sel),
+		.o_wb_ack(q_wb_ack), .o_wb_data(q_wb_data),
+		//
+		.o_ctl_cyc(qctl_cyc), .o_ctl_stb(qctl_stb), .o_ctl_we(qctl_we),
+		.o_ctl_addr(qctl_addr), .o_ctl_data(qctl_data),
+		.o_ctl_sel(qctl_sel),
+		.i_ctl_stall(qctl_stall), .i_ctl_ack(qctl_ack),
+		.i_ctl_data(ctl_idata),
+		.i_busy(fsm_busy),
+		//
+		.o_dma_cyc(qdma_cyc), .o_dma_stb(qdma_stb), .o_dma_we(qdma_we),
+		.o_dma_addr(qdma_addr), .o_dma_data(qdma_data),
+		.o_dma_sel(qdma_sel),
+		.i_dma_stall(qdma_stall), .i_dma_ack(qdma_ack),
+		.i_dma_data(i_dma_data), .i_dma_err(qdma_err),
+		//
+		.o_enable(q_enable), .o_int(q_int)
+		// }}}
+	);
+
+	satatrn_wbarbiter #(
+		.DW(32), .AW(3)
+	) u_ctlarb (
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset),
+		//
+		.i_a_cyc(i_wb_cyc), .i_a_stb(i_wb_stb && !i_wb_addr[3]),
+		.i_a_we(i_wb_we), .i_a_adr(i_wb_addr[2:0]),
+		.i_a_dat(i_wb_data), .i_a_sel(i_wb_sel),
+		.o_a_stall(ext_stall), .o_a_ack(ext_ack), .o_a_err(ign_ext_err),
+		//
+		.i_b_cyc(qctl_cyc), .i_b_stb(qctl_stb), .i_b_we(qctl_we),
+		.i_b_adr(qctl_addr), .i_b_dat(qctl_data), .i_b_sel(qctl_sel),
+		.o_b_stall(qctl_stall), .o_b_ack(qctl_ack),
+			.o_b_err(ign_qctl_err),
+		//
+		.i_a_level(4'h0), .i_b_level(4'h0),
+		.o_a_wait(ign_ext_wait), .o_b_wait(ign_qctl_wait),
+		//
+		.o_cyc(fsm_cyc), .o_stb(fsm_stb), .o_we(fsm_we),
+		.o_adr(fsm_addr), .o_dat(fsm_data), .o_sel(fsm_sel),
+		.i_stall(fsm_stall), .i_ack(fsm_ack), .i_err(1'b0)
+		// }}}
+	);
+
+	// Both the FSM and the queue acknowledge one clock after any request
+	// is accepted, so their acknowledgments never collide
+	assign	o_wb_stall = (i_wb_addr[3]) ? 1'b0 : ext_stall;
+	assign	o_wb_ack   = ext_ack || q_wb_ack;
+	assign	o_wb_data  = (q_wb_ack) ? q_wb_data : ctl_idata;
+
+	// In queue mode, interrupt on completions rather than commands
+	assign	o_int = (q_enable) ? q_int : fsm_int;
+
+	satatrn_wbarbiter #(
+		.DW(DW), .AW(AW)
+	) u_dmaarb (
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset),
+		//
+		.i_a_cyc(sg_cyc),  .i_a_stb(sg_stb),  .i_a_we(sg_we),
+		.i_a_adr(sg_addr), .i_a_dat(sg_data), .i_a_sel(sg_sel),
+		.o_a_stall(sg_stall), .o_a_ack(sg_ack), .o_a_err(sg_err),
+		//
+		.i_b_cyc(qdma_cyc),  .i_b_stb(qdma_stb),  .i_b_we(qdma_we),
+		.i_b_adr(qdma_addr), .i_b_dat(qdma_data), .i_b_sel(qdma_sel),
+		.o_b_stall(qdma_stall), .o_b_ack(qdma_ack), .o_b_err(qdma_err),
+		//
+		.i_a_level(4'h0), .i_b_level(4'h0),
+		.o_a_wait(ign_sg_wait), .o_b_wait(ign_qdma_wait),
+		//
 		.o_cyc(o_dma_cyc),  .o_stb(o_dma_stb),  .o_we(o_dma_we),
 		.o_adr(o_dma_addr), .o_dat(o_dma_data), .o_sel(o_dma_sel),
 		.i_stall(i_dma_stall), .i_ack(i_dma_ack), .i_err(i_dma_err)
 		// }}}
 	);
 
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Performance counters
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	// The counters share register 4 of the FSM's port.  The FSM still
+	// acknowledges these requests, it just has nothing to return.
+	//
+	// With OPT_AXI, the DMA is busy whenever either AXI master is, and
+	// stalled whenever it offers a request or write data that the bus
+	// doesn't accept.
+	assign	perf_dma_cyc = o_dma_cyc || (OPT_AXI
+				&& (s2mm_core_busy || mm2s_core_busy));
+	assign	perf_dma_stall = (o_dma_stb && i_dma_stall) || (OPT_AXI
+			&& ((M_AXI_AWVALID && !M_AXI_AWREADY)
+			|| (M_AXI_WVALID && !M_AXI_WREADY)
+			|| (M_AXI_ARVALID && !M_AXI_ARREADY)));
+
+	satatrn_perf #(
+		.LGFILL(LGFILL), .OPT_LOWPOWER(OPT_LOWPOWER)
+	) u_perf (
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset),
+		.i_phy_clk(i_phy_clk), .i_phy_reset_n(phy_reset_n),
+		//
+		.i_wb_stb(fsm_stb && !fsm_stall && fsm_addr == 3'h4),
+		.i_wb_we(fsm_we), .i_wb_data(fsm_data), .i_wb_sel(fsm_sel),
+		.o_wb_ack(perf_ack), .o_wb_data(perf_data),
+		//
+		.i_cmd_start(sg_start), .i_busy(fsm_busy),
+		.i_cmd_read(cmd_read), .i_cmd_write(cmd_write),
+		.i_cmd_sectors(cmd_sectors),
+		.i_dma_cyc(perf_dma_cyc), .i_dma_stall(perf_dma_stall),
+		.i_rxfifo_fill(rxfifo_fill), .i_txfifo_fill(txfifo_fill),
+		.i_rxdma_wait(s2mm_wait), .i_txdma_wait(mm2s_wait),
+		//
+		.i_phy_events({ i_link_events, i_tran_failed })
+		// }}}
+	);
+
+	assign	ctl_idata = (perf_ack) ? perf_data : fsm_idata;
+
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -612,17 +1172,21 @@ module	sata_transport #(
 	wire	unused;
 	assign	unused = &{ 1'b0,
 			// FIX THESE!  These shouldn't be ignored
-			i_tran_success, i_tran_failed,
+			i_tran_success,
 			//
 			// These are expected to be ignored
 			ign_datarx_ready, ign_txgear_bytes,
 			ign_mm2sgear_bytes_msb, ign_rxgear_bytes_msb,
-			ign_txfifo_fill, ign_rxfifo_fill
+			// Descriptor errors are reported to the FSM as DMA
+			// bus errors
+			ign_sg_err, ign_ext_err, ign_qctl_err,
+			// Only the data DMA's arbitration stalls are counted
+			ign_ext_wait, ign_qctl_wait, ign_sg_wait, ign_qdma_wait
 			};
 	generate if (DW != 32)
 	begin : UNUSED_DW
 		wire	unused_dw;
-		assign	unused_dw = &{ 1'b0, txgear_data[DW-33:0] };
+		assign	unused_dw = &{ 1'b0, txgear_data };
 	end endgenerate
 	// Verilator lint_on  UNUSED
 	// }}}
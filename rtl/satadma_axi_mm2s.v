@@ -0,0 +1,280 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	rtl/satadma_axi_mm2s.v
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	An AXI4 replacement for satadma_mm2s.  Reads a block of memory
+//		using INCR bursts, and produces it as an AXI stream.  The
+//	control and stream interfaces match those of satadma_mm2s, save that
+//	only full bus width, incrementing transfers are supported.  The
+//	starting address must be bus word aligned, although the length need
+//	not be a multiple of the bus width.
+//
+//	Bursts are as long as possible, up to (1<<LGMAXBURST) beats, and
+//	never cross a 4kB boundary.  Up to (1<<LGMAXOUT) bursts may be
+//	outstanding at any time.  Since M_READY must be held high, there's
+//	no need to reserve any buffer space before issuing a burst, and
+//	RREADY is always high.
+//
+//	An abort (i_abort) stops any further bursts from being issued.  The
+//	data from any bursts already issued is then discarded, and o_busy
+//	stays high until the last of them returns.  Unlike a reset, this
+//	keeps the AXI bus in a legal state.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+`timescale	1ns/1ps
+// }}}
+module	satadma_axi_mm2s #(
+		// {{{
+		parameter	ADDRESS_WIDTH = 32,
+		parameter	BUS_WIDTH = 32,
+		parameter	LGLENGTH = 11,
+		parameter	C_AXI_ID_WIDTH = 1,
+		parameter [C_AXI_ID_WIDTH-1:0]	AXI_ID = 0,
+		// Maximum burst length: 2^8 = 256 beats
+		parameter	LGMAXBURST = 8,
+		// Maximum number of bursts outstanding
+		parameter	LGMAXOUT = 2,
+		// Abbreviations
+		localparam	DW = BUS_WIDTH,
+		localparam	IW = C_AXI_ID_WIDTH
+		// }}}
+	) (
+		// {{{
+		input	wire	i_clk, i_reset,
+		// Configuration
+		// {{{
+		input	wire			i_request,
+		output	reg			o_busy, o_err,
+		input	wire			i_abort,
+		input	wire	[LGLENGTH:0]	i_transferlen,
+		input wire [ADDRESS_WIDTH-1:0]	i_addr,	// Byte address
+		// }}}
+		// AXI4 read master
+		// {{{
+		output	reg			M_AXI_ARVALID,
+		input	wire			M_AXI_ARREADY,
+		output	wire	[IW-1:0]	M_AXI_ARID,
+		output	reg [ADDRESS_WIDTH-1:0]	M_AXI_ARADDR,
+		output	reg	[7:0]		M_AXI_ARLEN,
+		output	wire	[2:0]		M_AXI_ARSIZE,
+		output	wire	[1:0]		M_AXI_ARBURST,
+		output	wire			M_AXI_ARLOCK,
+		output	wire	[3:0]		M_AXI_ARCACHE,
+		output	wire	[2:0]		M_AXI_ARPROT,
+		output	wire	[3:0]		M_AXI_ARQOS,
+		//
+		input	wire			M_AXI_RVALID,
+		output	wire			M_AXI_RREADY,
+		input	wire	[IW-1:0]	M_AXI_RID,
+		input	wire	[DW-1:0]	M_AXI_RDATA,
+		input	wire			M_AXI_RLAST,
+		input	wire	[1:0]		M_AXI_RRESP,
+		// }}}
+		// Outgoing Stream interface
+		// {{{
+		output	wire			M_VALID,
+		input	wire			M_READY,	// *MUST* be 1
+		output	wire	[DW-1:0]	M_DATA,
+		// How many bytes are valid?
+		output	wire [$clog2(DW/8):0]	M_BYTES,
+		output	wire			M_LAST
+		// }}}
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam	WBLSB = $clog2(DW/8);
+	localparam	[12:0]	MAXBURST = (1 << LGMAXBURST);
+	localparam	[1:0]	BURST_INCR = 2'b01;
+	localparam [WBLSB:0]	FULL_BEAT = DW/8;
+
+	reg				r_abort;
+	reg	[ADDRESS_WIDTH-1:0]	ar_addr;
+	reg	[LGLENGTH:0]		ar_beats, r_beats;
+	reg	[WBLSB:0]		last_bytes;
+	reg	[LGMAXOUT:0]		outstanding;
+	reg	[12:0]			boundary_beats, next_burst;
+	wire	[LGLENGTH+1:0]		req_beats;
+	wire				ar_issue, r_beat, r_final;
+	// }}}
+
+	// Fixed AXI signals
+	// {{{
+	assign	M_AXI_ARID    = AXI_ID;
+	assign	M_AXI_ARSIZE  = WBLSB[2:0];
+	assign	M_AXI_ARBURST = BURST_INCR;
+	assign	M_AXI_ARLOCK  = 1'b0;
+	assign	M_AXI_ARCACHE = 4'b0011;	// Normal, non-cacheable
+	assign	M_AXI_ARPROT  = 3'b000;
+	assign	M_AXI_ARQOS   = 4'h0;
+
+	assign	M_AXI_RREADY  = 1'b1;
+	// }}}
+
+	// Verilator lint_off WIDTH
+	assign	req_beats = (i_transferlen + (DW/8) - 1) >> WBLSB;
+	// Verilator lint_on  WIDTH
+
+	// next_burst: As long as possible, without crossing 4kB
+	// {{{
+	always @(*)
+	begin
+		// Verilator lint_off WIDTH
+		boundary_beats = (13'h1000 >> WBLSB) - ar_addr[11:WBLSB];
+
+		next_burst = ar_beats;
+		// Verilator lint_on  WIDTH
+		if (next_burst > MAXBURST)
+			next_burst = MAXBURST;
+		if (next_burst > boundary_beats)
+			next_burst = boundary_beats;
+	end
+	// }}}
+
+	assign	ar_issue = o_busy && !r_abort && (ar_beats != 0)
+				&& (!M_AXI_ARVALID || M_AXI_ARREADY)
+				&& !outstanding[LGMAXOUT];
+	assign	r_beat   = M_AXI_RVALID && M_AXI_RREADY;
+	assign	r_final  = r_beat && M_AXI_RLAST;
+
+	// M_AXI_AR*, ar_addr, ar_beats
+	// {{{
+	initial	M_AXI_ARVALID = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		M_AXI_ARVALID <= 1'b0;
+		ar_beats <= 0;
+	end else if (i_request && !o_busy)
+	begin
+		ar_addr  <= { i_addr[ADDRESS_WIDTH-1:WBLSB], {(WBLSB){1'b0}} };
+		ar_beats <= req_beats[LGLENGTH:0];
+	end else begin
+		if (M_AXI_ARREADY)
+			M_AXI_ARVALID <= 1'b0;
+
+		if (ar_issue)
+		begin
+			M_AXI_ARVALID <= 1'b1;
+			M_AXI_ARADDR  <= ar_addr;
+			// Verilator lint_off WIDTH
+			M_AXI_ARLEN   <= next_burst - 1;
+			ar_addr  <= ar_addr + (next_burst << WBLSB);
+			ar_beats <= ar_beats - next_burst;
+			// Verilator lint_on  WIDTH
+		end
+
+		if (r_abort)
+			ar_beats <= 0;
+	end
+	// }}}
+
+	// outstanding: Bursts requested, whose last beat has yet to return
+	// {{{
+	initial	outstanding = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		outstanding <= 0;
+	else case({ ar_issue, r_final })
+	2'b10: outstanding <= outstanding + 1;
+	2'b01: outstanding <= outstanding - 1;
+	default: begin end
+	endcase
+	// }}}
+
+	// r_beats, last_bytes
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset)
+		r_beats <= 0;
+	else if (i_request && !o_busy)
+	begin
+		r_beats <= req_beats[LGLENGTH:0];
+		last_bytes <= (i_transferlen[WBLSB-1:0] == 0) ? FULL_BEAT
+				: { 1'b0, i_transferlen[WBLSB-1:0] };
+	end else if (r_beat && r_beats != 0)
+		r_beats <= r_beats - 1;
+	// }}}
+
+	// o_busy, r_abort
+	// {{{
+	initial	o_busy  = 1'b0;
+	initial	r_abort = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		o_busy  <= 1'b0;
+		r_abort <= 1'b0;
+	end else if (i_request && !o_busy)
+	begin
+		o_busy  <= (i_transferlen != 0);
+		r_abort <= 1'b0;
+	end else begin
+		if (o_busy && i_abort)
+			r_abort <= 1'b1;
+
+		// Done once every burst has been both issued and returned
+		if ((r_abort || ar_beats == 0) && outstanding == 0)
+			o_busy <= 1'b0;
+	end
+	// }}}
+
+	// o_err
+	// {{{
+	initial	o_err = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset || (i_request && !o_busy))
+		o_err <= 1'b0;
+	else if (r_beat && M_AXI_RRESP[1])
+		o_err <= 1'b1;
+	// }}}
+
+	// M_*: The outgoing stream
+	// {{{
+	assign	M_VALID = M_AXI_RVALID && !r_abort;
+	assign	M_DATA  = M_AXI_RDATA;
+	assign	M_LAST  = (r_beats == 1);
+	assign	M_BYTES = (r_beats == 1) ? last_bytes : FULL_BEAT;
+	// }}}
+
+	// Keep Verilator happy
+	// {{{
+	// Verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, M_READY, M_AXI_RID, M_AXI_RRESP[0],
+			req_beats[LGLENGTH+1] };
+	// Verilator lint_on  UNUSED
+	// }}}
+endmodule
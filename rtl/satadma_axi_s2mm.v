@@ -0,0 +1,324 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	rtl/satadma_axi_s2mm.v
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	An AXI4 replacement for satadma_s2mm.  Writes an incoming AXI
+//		stream to memory using INCR bursts.  The control and stream
+//	interfaces match those of satadma_s2mm, save that only full bus
+//	width, incrementing transfers are supported, and the starting address
+//	must be bus word aligned.  A short final beat is written using WSTRB.
+//
+//	AXI needs to know the length of a burst before it starts, whereas
+//	the stream length is only known at S_LAST.  Incoming data therefore
+//	collects in a FIFO of one maximum length burst, (1<<LGMAXBURST)
+//	beats.  A burst is issued once either enough data has arrived to
+//	fill it, or S_LAST has been seen.  Since every burst is issued only
+//	once its data is already in the FIFO, WVALID never drops mid-burst.
+//	Bursts never cross a 4kB boundary, and up to (1<<LGMAXOUT) of them
+//	may await their write responses at any time.
+//
+//	An abort (i_abort) stops the stream and any further bursts.  Any
+//	burst already issued is completed, and o_busy remains high until
+//	its write response returns.  Unlike a reset, this keeps the AXI bus
+//	in a legal state.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+`timescale	1ns/1ps
+// }}}
+module	satadma_axi_s2mm #(
+		// {{{
+		parameter	ADDRESS_WIDTH = 32,
+		parameter	BUS_WIDTH = 32,
+		parameter [0:0]	OPT_LITTLE_ENDIAN = 1'b0,
+		parameter	C_AXI_ID_WIDTH = 1,
+		parameter [C_AXI_ID_WIDTH-1:0]	AXI_ID = 0,
+		// Maximum burst length: 2^8 = 256 beats
+		parameter	LGMAXBURST = 8,
+		// Maximum number of bursts outstanding
+		parameter	LGMAXOUT = 2,
+		// Abbreviations
+		localparam	DW = BUS_WIDTH,
+		localparam	IW = C_AXI_ID_WIDTH
+		// }}}
+	) (
+		// {{{
+		input	wire	i_clk, i_reset,
+		// Configuration
+		// {{{
+		input	wire			i_request,
+		output	reg			o_busy, o_err,
+		input	wire			i_abort,
+		input wire [ADDRESS_WIDTH-1:0]	i_addr,	// Byte address
+		// }}}
+		// Incoming Stream interface
+		// {{{
+		input	wire			S_VALID,
+		output	wire			S_READY,
+		input	wire	[DW-1:0]	S_DATA,
+		// How many bytes are valid?
+		input	wire [$clog2(DW/8):0]	S_BYTES,
+		input	wire			S_LAST,
+		// }}}
+		// AXI4 write master
+		// {{{
+		output	reg			M_AXI_AWVALID,
+		input	wire			M_AXI_AWREADY,
+		output	wire	[IW-1:0]	M_AXI_AWID,
+		output	reg [ADDRESS_WIDTH-1:0]	M_AXI_AWADDR,
+		output	reg	[7:0]		M_AXI_AWLEN,
+		output	wire	[2:0]		M_AXI_AWSIZE,
+		output	wire	[1:0]		M_AXI_AWBURST,
+		output	wire			M_AXI_AWLOCK,
+		output	wire	[3:0]		M_AXI_AWCACHE,
+		output	wire	[2:0]		M_AXI_AWPROT,
+		output	wire	[3:0]		M_AXI_AWQOS,
+		//
+		output	wire			M_AXI_WVALID,
+		input	wire			M_AXI_WREADY,
+		output	wire	[DW-1:0]	M_AXI_WDATA,
+		output	wire	[DW/8-1:0]	M_AXI_WSTRB,
+		output	wire			M_AXI_WLAST,
+		//
+		input	wire			M_AXI_BVALID,
+		output	wire			M_AXI_BREADY,
+		input	wire	[IW-1:0]	M_AXI_BID,
+		input	wire	[1:0]		M_AXI_BRESP
+		// }}}
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam	WBLSB = $clog2(DW/8);
+	localparam	[12:0]	MAXBURST = (1 << LGMAXBURST);
+	localparam	[1:0]	BURST_INCR = 2'b01;
+	integer			ik;
+
+	reg				r_abort, r_last;
+	reg	[ADDRESS_WIDTH-1:0]	aw_addr;
+	reg	[LGMAXBURST:0]		pending, w_beats;
+	reg	[LGMAXOUT:0]		outstanding;
+	reg	[12:0]			boundary_beats, burst_limit,
+					next_burst;
+	reg	[DW/8-1:0]		s_strb;
+	wire				s_beat, aw_issue, w_beat, b_beat;
+	wire				fifo_full, fifo_empty;
+	wire	[LGMAXBURST:0]		ign_fifo_fill;
+	// }}}
+
+	// Fixed AXI signals
+	// {{{
+	assign	M_AXI_AWID    = AXI_ID;
+	assign	M_AXI_AWSIZE  = WBLSB[2:0];
+	assign	M_AXI_AWBURST = BURST_INCR;
+	assign	M_AXI_AWLOCK  = 1'b0;
+	assign	M_AXI_AWCACHE = 4'b0011;	// Normal, non-cacheable
+	assign	M_AXI_AWPROT  = 3'b000;
+	assign	M_AXI_AWQOS   = 4'h0;
+
+	assign	M_AXI_BREADY  = 1'b1;
+	// }}}
+
+	// s_strb: Which bytes of the incoming beat are valid
+	// {{{
+	always @(*)
+	begin
+		s_strb = 0;
+		for(ik=0; ik<DW/8; ik=ik+1)
+		if (OPT_LITTLE_ENDIAN)
+			s_strb[ik] = (ik < S_BYTES);
+		else
+			s_strb[DW/8-1-ik] = (ik < S_BYTES);
+	end
+	// }}}
+
+	// The burst FIFO
+	// {{{
+	assign	S_READY = o_busy && !r_last && !r_abort && !fifo_full;
+	assign	s_beat  = S_VALID && S_READY;
+
+	sata_sfifo #(
+		.BW(DW/8+DW), .LGFLEN(LGMAXBURST)
+	) u_fifo (
+		// {{{
+		// Anything left over from an abort is flushed when idle
+		.i_clk(i_clk), .i_reset(i_reset || !o_busy),
+		//
+		.i_wr(s_beat), .i_data({ s_strb, S_DATA }),
+		.o_full(fifo_full), .o_fill(ign_fifo_fill),
+		//
+		.i_rd(w_beat),
+		.o_data({ M_AXI_WSTRB, M_AXI_WDATA }),
+		.o_empty(fifo_empty)
+		// }}}
+	);
+	// }}}
+
+	// next_burst: As long as possible, without crossing 4kB
+	// {{{
+	always @(*)
+	begin
+		// Verilator lint_off WIDTH
+		boundary_beats = (13'h1000 >> WBLSB) - aw_addr[11:WBLSB];
+		// Verilator lint_on  WIDTH
+
+		burst_limit = MAXBURST;
+		if (burst_limit > boundary_beats)
+			burst_limit = boundary_beats;
+
+		next_burst = { {(12-LGMAXBURST){1'b0}}, pending };
+		if (next_burst > burst_limit)
+			next_burst = burst_limit;
+	end
+	// }}}
+
+	// Issue a burst once it can be filled, or the stream has ended.  Only
+	// one burst's worth of W data is in flight at a time.
+	assign	aw_issue = o_busy && !r_abort && (pending != 0)
+			&& (r_last || { {(12-LGMAXBURST){1'b0}}, pending } >= burst_limit)
+			&& (w_beats == 0) && (!M_AXI_AWVALID || M_AXI_AWREADY)
+			&& !outstanding[LGMAXOUT];
+	assign	w_beat = M_AXI_WVALID && M_AXI_WREADY;
+	assign	b_beat = M_AXI_BVALID && M_AXI_BREADY;
+
+	// M_AXI_AW*, aw_addr
+	// {{{
+	initial	M_AXI_AWVALID = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		M_AXI_AWVALID <= 1'b0;
+	else if (i_request && !o_busy)
+		aw_addr <= { i_addr[ADDRESS_WIDTH-1:WBLSB], {(WBLSB){1'b0}} };
+	else begin
+		if (M_AXI_AWREADY)
+			M_AXI_AWVALID <= 1'b0;
+
+		if (aw_issue)
+		begin
+			M_AXI_AWVALID <= 1'b1;
+			M_AXI_AWADDR  <= aw_addr;
+			// Verilator lint_off WIDTH
+			M_AXI_AWLEN   <= next_burst - 1;
+			aw_addr <= aw_addr + (next_burst << WBLSB);
+			// Verilator lint_on  WIDTH
+		end
+	end
+	// }}}
+
+	// pending: Beats in the FIFO, not yet claimed by any burst
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || !o_busy)
+		pending <= 0;
+	else
+		// Verilator lint_off WIDTH
+		pending <= pending + (s_beat ? 1:0)
+				- (aw_issue ? next_burst : 0);
+		// Verilator lint_on  WIDTH
+	// }}}
+
+	// w_beats: Beats remaining in the current W burst
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset)
+		w_beats <= 0;
+	else if (aw_issue)
+		w_beats <= next_burst[LGMAXBURST:0];
+	else if (w_beat)
+		w_beats <= w_beats - 1;
+
+	assign	M_AXI_WVALID = (w_beats != 0) && !fifo_empty;
+	assign	M_AXI_WLAST  = (w_beats == 1);
+	// }}}
+
+	// outstanding: Bursts issued, awaiting their write responses
+	// {{{
+	initial	outstanding = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		outstanding <= 0;
+	else case({ aw_issue, b_beat })
+	2'b10: outstanding <= outstanding + 1;
+	2'b01: outstanding <= outstanding - 1;
+	default: begin end
+	endcase
+	// }}}
+
+	// o_busy, r_last, r_abort
+	// {{{
+	initial	o_busy  = 1'b0;
+	initial	r_last  = 1'b0;
+	initial	r_abort = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		o_busy  <= 1'b0;
+		r_last  <= 1'b0;
+		r_abort <= 1'b0;
+	end else if (i_request && !o_busy)
+	begin
+		o_busy  <= 1'b1;
+		r_last  <= 1'b0;
+		r_abort <= 1'b0;
+	end else begin
+		if (s_beat && S_LAST)
+			r_last <= 1'b1;
+		if (o_busy && i_abort)
+			r_abort <= 1'b1;
+
+		// Done once every beat has been written, and acknowledged
+		if ((r_abort || (r_last && pending == 0))
+				&& w_beats == 0 && outstanding == 0)
+			o_busy <= 1'b0;
+	end
+	// }}}
+
+	// o_err
+	// {{{
+	initial	o_err = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset || (i_request && !o_busy))
+		o_err <= 1'b0;
+	else if (b_beat && M_AXI_BRESP[1])
+		o_err <= 1'b1;
+	// }}}
+
+	// Keep Verilator happy
+	// {{{
+	// Verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, M_AXI_BID, M_AXI_BRESP[0], ign_fifo_fill };
+	// Verilator lint_on  UNUSED
+	// }}}
+endmodule
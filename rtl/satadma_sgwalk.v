@@ -0,0 +1,422 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	rtl/satadma_sgwalk.v
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Scatter-gather support for the DMA.  Sits between the DMA
+//		arbiter and the external DMA bus.  When disabled, the bus
+//	passes straight through.  When enabled, the addresses generated by
+//	the S2MM and MM2S are treated as offsets into the transfer, and
+//	mapped to physical addresses by walking a chain of descriptors in
+//	memory.
+//
+//	Descriptors are two 32-bit words, found at 8-byte aligned addresses:
+//
+//	Word 0:	Physical byte address of this segment
+//	Word 1:	[31]	LAST: This is the final segment of the chain
+//		[30]	LINK: Word 0 is the address of the next descriptor,
+//				not a segment.  Length is ignored.
+//		[29:0]	Length of this segment, in bytes
+//
+//	Segment addresses and lengths must be multiples of the bus width, and
+//	all addresses must fit within 32 bits.
+//
+//	Descriptors are fetched as needed, whenever the DMA requests an
+//	address beyond the end of the current segment.  Before fetching,
+//	the walker stalls the DMA and waits for any outstanding requests to
+//	be acknowledged.  A request beyond the end of the LAST segment, or
+//	a bus error while fetching a descriptor, returns a bus error to the
+//	DMA and sets o_err until the next i_start.
+//
+//	Since the DMA addresses only ever increase within a transfer, only
+//	the current segment is kept.  Should the DMA ever return to an
+//	address before the current segment, the walk restarts from i_table.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+`timescale	1ns/1ps
+// }}}
+module	satadma_sgwalk #(
+		// {{{
+		parameter	DW=32, AW=30,
+		parameter	ADDRESS_WIDTH = AW + $clog2(DW/8),
+		parameter	LGPENDING = 10
+`ifdef	FORMAL
+		, parameter			F_LGDEPTH=4
+`endif
+		// }}}
+	) (
+		// {{{
+		input	wire			i_clk, i_reset,
+		// Control
+		// {{{
+		input	wire			i_enable,
+		input	wire			i_start,
+		input wire [ADDRESS_WIDTH-1:0]	i_table,
+		output	reg			o_err,
+		// }}}
+		// Incoming bus, from the DMA
+		// {{{
+		input	wire			i_cyc, i_stb, i_we,
+		input	wire	[AW-1:0]	i_adr,
+		input	wire	[DW-1:0]	i_dat,
+		input	wire	[DW/8-1:0]	i_sel,
+		output	wire			o_stall, o_ack, o_err_bus,
+		// }}}
+		// Outgoing bus, to memory
+		// {{{
+		output	wire			o_cyc, o_stb, o_we,
+		output	wire	[AW-1:0]	o_adr,
+		output	wire	[DW-1:0]	o_dat,
+		output	wire	[DW/8-1:0]	o_sel,
+		input	wire			i_stall, i_ack, i_err,
+		input	wire	[DW-1:0]	i_data
+		// }}}
+`ifdef	FORMAL
+		, output	wire	[(F_LGDEPTH-1):0]
+			f_nreqs, f_nacks, f_outstanding,
+			f_s_nreqs, f_s_nacks, f_s_outstanding
+`endif
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam	WBLSB = $clog2(DW/8);
+	localparam	[1:0]	SG_IDLE  = 2'b00,
+				SG_DRAIN = 2'b01,
+				SG_FETCH = 2'b10;
+
+	reg	[1:0]			sg_state;
+	reg				sg_started, seg_valid, seg_last,
+					sg_err;
+	reg	[AW-1:0]		seg_vbase, seg_pbase;
+	reg	[AW:0]			seg_vend, vnext;
+	reg	[ADDRESS_WIDTH-1:0]	desc_addr;
+	reg	[LGPENDING-1:0]		npending;
+
+	reg				fetch_stb, fetch_nreq, fetch_nack;
+	reg	[AW-1:0]		fetch_adr;
+	reg	[31:0]			desc_word, desc_base;
+	wire	[ADDRESS_WIDTH-1:0]	next_desc_word;
+	wire	[AW:0]			desc_len;
+
+	wire	hit, miss, passthru, fetching;
+	// }}}
+
+	assign	hit = seg_valid && (i_adr >= seg_vbase)
+				&& ({ 1'b0, i_adr } < seg_vend);
+	assign	miss = i_enable && i_cyc && i_stb && !hit;
+	assign	passthru = !i_enable || (sg_state == SG_IDLE && hit);
+	assign	fetching = (sg_state == SG_FETCH);
+
+	// desc_word: The 32-bit descriptor word within the returned bus word
+	// {{{
+	assign	next_desc_word = desc_addr + 4;
+
+	generate if (DW == 32)
+	begin : GEN_NARROW
+		always @(*)
+			desc_word = i_data;
+	end else begin : GEN_WIDE
+		// Descriptor words are big-endian within the bus word, as is
+		// everything else on this bus
+		reg	[WBLSB-3:0]	lane;
+		reg	[DW-1:0]	shifted;
+
+		always @(*)
+		begin
+			if (fetch_nack)
+				lane = next_desc_word[WBLSB-1:2];
+			else
+				lane = desc_addr[WBLSB-1:2];
+			shifted = i_data << (32 * lane);
+			desc_word = shifted[DW-1:DW-32];
+		end
+	end endgenerate
+
+	// Verilator lint_off WIDTH
+	assign	desc_len = desc_word[29:WBLSB];
+	// Verilator lint_on  WIDTH
+	// }}}
+
+	// npending: Pass through requests yet to be acknowledged
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || !i_cyc || i_err)
+		npending <= 0;
+	else if (!fetching)
+	case({ (o_stb && !i_stall), i_ack })
+	2'b10: npending <= npending + 1;
+	2'b01: npending <= npending - 1;
+	default: begin end
+	endcase
+	// }}}
+
+	// The descriptor walk
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || i_start)
+	begin
+		// {{{
+		sg_state  <= SG_IDLE;
+		sg_started <= 1'b0;
+		seg_valid <= 1'b0;
+		seg_last  <= 1'b0;
+		sg_err    <= 1'b0;
+		o_err     <= 1'b0;
+		fetch_stb <= 1'b0;
+		fetch_nreq <= 1'b0;
+		fetch_nack <= 1'b0;
+		// }}}
+	end else begin
+		sg_err <= 1'b0;
+
+		case(sg_state)
+		SG_IDLE: if (miss && !sg_err)
+		begin
+			// {{{
+			if (!sg_started || (seg_valid && i_adr < seg_vbase))
+			begin
+				// Start (or restart) the walk from the top
+				sg_started <= 1'b1;
+				desc_addr <= i_table;
+				vnext     <= 0;
+				seg_valid <= 1'b0;
+				seg_last  <= 1'b0;
+				if (o_err)
+					sg_err <= 1'b1;
+				else
+					sg_state <= SG_DRAIN;
+			end else if (seg_last || o_err)
+			begin
+				// Ran off the end of the chain
+				sg_err <= 1'b1;
+				o_err  <= 1'b1;
+			end else
+				sg_state <= SG_DRAIN;
+			end
+			// }}}
+		SG_DRAIN: if (!i_cyc)
+			sg_state <= SG_IDLE;
+		else if (npending == 0)
+		begin
+			// {{{
+			sg_state   <= SG_FETCH;
+			fetch_stb  <= 1'b1;
+			fetch_adr  <= desc_addr[ADDRESS_WIDTH-1:WBLSB];
+			fetch_nreq <= 1'b0;
+			fetch_nack <= 1'b0;
+			end
+			// }}}
+		SG_FETCH: if (!i_cyc)
+		begin
+			// {{{
+			// The DMA has aborted.  Abandon this fetch.
+			sg_state  <= SG_IDLE;
+			fetch_stb <= 1'b0;
+			// }}}
+		end else if (i_err)
+		begin
+			// {{{
+			sg_state  <= SG_IDLE;
+			fetch_stb <= 1'b0;
+			seg_valid <= 1'b0;
+			sg_err    <= 1'b1;
+			o_err     <= 1'b1;
+			// }}}
+		end else begin
+			// {{{
+			if (fetch_stb && !i_stall)
+			begin
+				fetch_nreq <= 1'b1;
+				fetch_adr  <= next_desc_word[ADDRESS_WIDTH-1:WBLSB];
+				if (fetch_nreq)
+					fetch_stb <= 1'b0;
+			end
+
+			if (i_ack && !fetch_nack)
+			begin
+				fetch_nack <= 1'b1;
+				desc_base  <= desc_word;
+			end else if (i_ack)
+			begin
+				// Both words have now been returned
+				sg_state <= SG_IDLE;
+				if (desc_word[30])
+				begin
+					// LINK: Continue the walk elsewhere
+					desc_addr <= desc_base[ADDRESS_WIDTH-1:0];
+				end else begin
+					desc_addr <= desc_addr + 8;
+					seg_valid <= 1'b1;
+					seg_last  <= desc_word[31];
+					seg_vbase <= vnext[AW-1:0];
+					seg_vend  <= vnext + desc_len;
+					seg_pbase <= desc_base[ADDRESS_WIDTH-1:WBLSB];
+					vnext     <= vnext + desc_len;
+				end
+			end
+			// }}}
+		end
+		default: sg_state <= SG_IDLE;
+		endcase
+	end
+	// }}}
+
+	// Outgoing bus
+	// {{{
+	assign	o_cyc = i_cyc;
+	assign	o_stb = (passthru) ? i_stb : (fetching && fetch_stb);
+	assign	o_we  = (fetching) ? 1'b0 : i_we;
+	assign	o_dat = i_dat;
+	assign	o_sel = (fetching) ? {(DW/8){1'b1}} : i_sel;
+	assign	o_adr = (!i_enable) ? i_adr
+			: (fetching) ? fetch_adr
+			: (i_adr - seg_vbase + seg_pbase);
+
+	assign	o_stall = (passthru) ? i_stall : 1'b1;
+	assign	o_ack   = i_ack && !fetching;
+	assign	o_err_bus = (i_err && !fetching) || sg_err;
+	// }}}
+
+	// Make Verilator happy
+	// {{{
+	// verilator coverage_off
+	// verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, desc_base, desc_word, next_desc_word };
+	// verilator lint_on  UNUSED
+	// verilator coverage_on
+	// }}}
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// Formal properties
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+`ifdef	FORMAL
+	reg	f_past_valid;
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
+
+	always @(*)
+	if (!f_past_valid)
+		assume(i_reset);
+
+	// The configuration may only change between transfers
+	always @(posedge i_clk)
+	if (f_past_valid && i_cyc)
+	begin
+		assume($stable(i_enable));
+		assume($stable(i_table));
+		assume(!i_start);
+	end
+
+	fwb_slave  #(
+		// {{{
+		.DW(DW), .AW(AW),
+		.F_MAX_STALL(0),
+		.F_LGDEPTH(F_LGDEPTH),
+		.F_MAX_ACK_DELAY(0),
+		.F_OPT_RMW_BUS_OPTION(1),
+		.F_OPT_DISCONTINUOUS(1)
+		// }}}
+	) f_wbs (
+		// {{{
+		i_clk, i_reset,
+		i_cyc, i_stb, i_we, i_adr, i_dat, i_sel,
+		o_ack, o_stall, {(DW){1'b0}}, o_err_bus,
+		f_s_nreqs, f_s_nacks, f_s_outstanding
+		// }}}
+	);
+
+	fwb_master #(
+		// {{{
+		.DW(DW), .AW(AW),
+		.F_MAX_STALL(2),
+		.F_LGDEPTH(F_LGDEPTH),
+		.F_MAX_ACK_DELAY(3),
+		.F_OPT_RMW_BUS_OPTION(1),
+		.F_OPT_DISCONTINUOUS(1)
+		// }}}
+	) f_wbm (
+		// {{{
+		i_clk, i_reset,
+		o_cyc, o_stb, o_we, o_adr, o_dat, o_sel,
+		i_ack, i_stall, i_data, i_err,
+		f_nreqs, f_nacks, f_outstanding
+		// }}}
+	);
+
+	// Induction properties
+	// {{{
+	always @(*)
+	if (!i_reset && i_cyc && !fetching)
+		assert(f_outstanding == f_s_outstanding);
+
+	always @(*)
+	if (!i_reset && i_cyc)
+		assert(npending == f_s_outstanding);
+
+	always @(*)
+	if (!i_reset && i_cyc && fetching)
+	begin
+		assert(f_s_outstanding == 0);
+		assert(f_outstanding == fetch_nreq + (fetch_stb ? 0:1)
+				- fetch_nack);
+	end
+
+	always @(*)
+	if (!i_enable)
+		assert(sg_state == SG_IDLE);
+
+	always @(*)
+		assert(sg_state != 2'b11);
+	// }}}
+
+	// Cover properties
+	// {{{
+	always @(posedge i_clk)
+	if (f_past_valid && !$past(i_reset) && $past(fetching) && !fetching)
+		cover(seg_valid && !sg_err);
+
+	always @(posedge i_clk)
+		cover(i_enable && o_ack && seg_valid && seg_vbase != 0);
+	// }}}
+`endif
+// }}}
+endmodule
@@ -8,9 +8,31 @@
 //
 // Registers
 //	0-3:	Shadow register copy, includes busy bit
+//	4:	Performance counters.  These belong to satatrn_perf.v.  The FSM
+//		only reports the commands it processes.
 //	5:	(My status register)
+//		Bit 8 selects scatter-gather mode.  When set, the DMA address
+//		is the address of a descriptor chain (see satadma_sgwalk.v),
+//		rather than the address of a single contiguous buffer.
+//		Without OPT_SG, this bit always reads as zero.
 //	6-7:	External DMA address
 //
+// Write prefetch
+//	When OPT_PREFETCH is set, a DMA write starts reading the first DATA
+//	FIS from memory as soon as the command FIS is sent, rather than
+//	waiting for the device's DMA Activate.  o_tx_hold keeps this data in
+//	the transmit FIFO until DMA Activate arrives.  If the device ends
+//	the command without asking for the data, o_tx_flush discards it
+//	before the FSM accepts another command.  This requires a transmit
+//	FIFO large enough for a whole DATA FIS (2^LGLENGTH bytes).
+//
+// CRC errors
+//	If an incoming DATA FIS fails its CRC check while the transport runs
+//	in cut-through mode, its data has already been written to memory.
+//	Rather than abort the command, the error is remembered until the
+//	command's final status arrives.  Then both the ICRC bit (7) of the
+//	error register and the ERR bit (0) of the status register are set.
+//
 // TODO:
 //	- Proper error handling on i_mm2s_err, i_tran_err, or i_s2mm_err
 //	- Can we guarantee that if i_err ever shows up, that the AXI Stream
@@ -55,7 +77,10 @@ module	satatrn_fsm #(
 		// parameter [0:0]	OPT_LITTLE_ENDIAN = 1'b0,
 		parameter	DW=32,
 		parameter	LGLENGTH=11,
-		parameter [0:0]	OPT_LOWPOWER = 1'b0
+		parameter [0:0]	OPT_LOWPOWER = 1'b0,
+		parameter [0:0]	OPT_PREFETCH = 1'b0,
+		// OPT_SG: Allow scatter-gather mode to be enabled
+		parameter [0:0]	OPT_SG = 1'b1
 		// }}}
 	) (
 		// {{{
@@ -71,8 +96,12 @@ module	satatrn_fsm #(
 		output	reg			o_wb_ack,
 		output	reg	[31:0]		o_wb_data,
 		// }}}
+		output	wire			o_busy,
+		//
 		output	reg			o_tran_req,
 		input	wire			i_tran_busy, i_tran_err,
+		// A DATA FIS arrived with a bad CRC
+		input	wire			i_crc_err,
 		output	reg			o_tran_src,
 		output	reg	[LGLENGTH:0]	o_tran_len,
 		//
@@ -107,6 +136,21 @@ module	satatrn_fsm #(
 		input	wire			i_mm2s_busy, i_mm2s_err,
 		output reg [ADDRESS_WIDTH-1:0]	o_mm2s_addr,
 		// }}}
+		// Transmit FIFO control, for prefetched write data
+		// {{{
+		output	reg			o_tx_hold, o_tx_flush,
+		// }}}
+		// Scatter-gather control
+		// {{{
+		output	reg			o_sg_enable,
+		output	reg			o_sg_start,
+		output	wire [ADDRESS_WIDTH-1:0] o_sg_table,
+		// }}}
+		// Performance reporting, valid with o_sg_start
+		// {{{
+		output	wire			o_cmd_read, o_cmd_write,
+		output	wire	[16:0]		o_cmd_sectors,
+		// }}}
 		output	reg	[31:0]		o_debug
 		// }}}
 	);
@@ -155,7 +199,7 @@ module	satatrn_fsm #(
 				// FSM_RESET		= 4'h0;
 
 	reg	[2:0]	cmd_type;
-	reg		known_cmd;
+	reg		known_cmd, cmd_ext;
 	reg	[63:0]	wide_address;
 	reg	[3:0]	fsm_state;
 	reg		reset_hold, link_dropped, tran_failed;
@@ -167,9 +211,10 @@ module	satatrn_fsm #(
 			last_fis;
 	reg	[3:0]	r_port;
 	reg	[15:0]	r_count;
-	reg		r_busy, r_int, return_to_idle, r_dma_fail;
+	reg		r_busy, r_int, return_to_idle, r_dma_fail, r_crc_err;
 	reg	[ADDRESS_WIDTH-1:0]	r_dma_address;
-	reg	[15:0]			dma_length;
+	// Up to 65536 sectors of 512 bytes each
+	reg	[25:0]			dma_length;
 	reg		last_rx_fis;
 
 	reg		s_sop, s_active;
@@ -201,6 +246,20 @@ module	satatrn_fsm #(
 			cmd_type  <= CMD_NONDATA;
 			known_cmd <= 0;
 
+			// 48-bit (EXT) data transfer commands take a 16-bit
+			// count, where zero means 65536 sectors.  Their 28-bit
+			// counterparts only use the bottom 8 bits, where zero
+			// means 256.  DATA SET MANAGEMENT counts its 512-byte
+			// blocks of ranges in 16 bits as well.
+			case(i_wb_data[23:16])
+			8'h06, 8'h07,
+			8'h24, 8'h25, 8'h2a, 8'h2b, 8'h2f,
+			8'h34, 8'h35, 8'h3a, 8'h3b, 8'h3d, 8'h3f:
+				cmd_ext <= 1'b1;
+			default:
+				cmd_ext <= 1'b0;
+			endcase
+
 			case(i_wb_data[23:16])
 			8'h00, 8'h0b, 8'h40, 8'h42, 8'h44, 8'h45, 8'h51, 8'h63,
 			8'h77, 8'h78, 8'hb0, 8'hb2, 8'hb4,
@@ -366,6 +425,8 @@ module	satatrn_fsm #(
 		//
 		o_mm2s_request <= 1'b0;
 		o_mm2s_addr    <= 0;
+		o_tx_hold      <= 1'b0;
+		o_tx_flush     <= 1'b0;
 		//
 		o_tran_req <= 0;
 		r_dma_address <= 0;
@@ -381,6 +442,7 @@ module	satatrn_fsm #(
 		r_port     <= 0;
 		r_control	<= 0;
 		r_dma_fail  <= 0;
+		r_crc_err   <= 0;
 		last_fis	<= 0;
 		// }}}
 	end else if (soft_reset)
@@ -392,6 +454,8 @@ module	satatrn_fsm #(
 		//
 		o_mm2s_request <= 1'b0;
 		o_mm2s_addr    <= 0;
+		o_tx_hold      <= 1'b0;
+		o_tx_flush     <= 1'b0;
 		//
 		o_tran_req <= 0;
 		r_dma_address <= 0;
@@ -407,6 +471,7 @@ module	satatrn_fsm #(
 		r_port     <= 0;
 		r_control	<= 0;
 		r_dma_fail  <= 0;
+		r_crc_err   <= 0;
 		last_fis	<= 0;
 		// }}}
 	end else if (!i_link_up || i_tran_err || o_phy_reset)
@@ -426,7 +491,8 @@ module	satatrn_fsm #(
 		// r_int      <= 0;
 		// r_device   <= 0;
 		// r_count    <= 0;
-		r_busy     <= 0;
+		// Stay busy until any prefetched data has been flushed
+		r_busy     <= o_tx_hold;
 		return_to_idle <= (fsm_state != FSM_IDLE);
 		// r_icc      <= 0;
 		// r_port     <= 0;
@@ -439,8 +505,10 @@ module	satatrn_fsm #(
 				  || s_brdata[7:0] == FIS_SET_DEVBITS
 				  || s_brdata[7:0] == FIS_PIO_SETUP))
 		begin
-			r_features[7:0] <= s_brdata[31:24];	// ERROR bits
-			r_command       <= s_brdata[23:16];	// STATUS bits
+			r_features[7:0] <= s_brdata[31:24]	// ERROR bits
+				| { (r_crc_err || i_crc_err), 7'h0 };	// ICRC
+			r_command       <= s_brdata[23:16]	// STATUS bits
+				| { 7'h0, (r_crc_err || i_crc_err) };	// ERR
 			r_int           <= r_int || s_brdata[14];
 			// The following bits are part of r_command
 			// BSY  = s_brdata[23] = r_command[7]
@@ -462,11 +530,25 @@ module	satatrn_fsm #(
 			r_count <= s_brdata[15:0];
 
 		return_to_idle <= 1'b0;
+		o_tx_flush <= 1'b0;
+		if (i_crc_err)
+			r_crc_err <= 1'b1;
 		r_dma_fail <= r_dma_fail || i_mm2s_err || i_s2mm_err;
 		case(fsm_state)
 		FSM_IDLE: begin
 			// {{{
-			r_busy <= 1'b0;
+			// If a write ended before DMA Activate, throw away the
+			// data we prefetched for it.  We remain busy until
+			// then, so no new command can start in the meantime.
+			r_busy <= o_tx_hold;
+			if (o_mm2s_request && !i_mm2s_busy)
+				o_mm2s_request <= 1'b0;
+			if (o_tx_hold && !o_mm2s_request && !i_mm2s_busy)
+			begin
+				o_tx_hold  <= 1'b0;
+				o_tx_flush <= 1'b1;
+			end
+
 			if (i_wb_stb && !o_wb_stall && i_wb_we && !m_valid)
 			case(i_wb_addr)
 			ADDR_CMD: begin	// ADDR_CMD
@@ -543,6 +625,7 @@ module	satatrn_fsm #(
 			if (known_cmd)
 			begin
 				r_dma_fail <= 1'b0;
+				r_crc_err  <= 1'b0;
 				fsm_state  <= FSM_COMMAND;
 				last_fis <= FIS_REG_TO_DEV;
 
@@ -550,7 +633,24 @@ module	satatrn_fsm #(
 				o_tran_src <= SRC_REGS;
 				o_tran_len <= 20; // register set
 
-				dma_length <= r_count * 512;
+				// Start from the top of the buffer.  In
+				// scatter-gather mode, DMA addresses are offsets
+				// into the descriptor chain.
+				if (o_sg_enable)
+				begin
+					o_s2mm_addr <= 0;
+					o_mm2s_addr <= 0;
+				end else begin
+					o_s2mm_addr <= r_dma_address;
+					o_mm2s_addr <= r_dma_address;
+				end
+
+				if (cmd_ext)
+					dma_length <= { (r_count == 0),
+							r_count, 9'h0 };
+				else
+					dma_length <= { 8'h0, (r_count[7:0] == 0),
+							r_count[7:0], 9'h0 };
 				r_busy <= 1'b1;
 			end end
 			// }}}
@@ -581,8 +681,19 @@ module	satatrn_fsm #(
 					// o_s2mm_transferlen <= (cmd_length < 2048)
 					//		? cmd_length : 2048;
 					end
-				CMD_DMA_WRITE:
+				CMD_DMA_WRITE: begin
 					fsm_state <= FSM_DMA_OUT_SETUP;
+
+					if (OPT_PREFETCH)
+					begin
+						// Fetch the first DATA FIS now,
+						// and hold it until DMA Activate
+						o_mm2s_request <= 1;
+						o_tx_hold  <= 1;
+						o_tran_src <= SRC_MM2S;
+						o_tran_len <= (dma_length > 2048) ? 2048 : dma_length[LGLENGTH:0];
+						dma_length <= (dma_length >= 2048) ? (dma_length - 2048) : 0;
+					end end
 				default:
 					// Will *NEVER* happen
 					fsm_state <= FSM_WAIT_REG;
@@ -675,9 +786,18 @@ module	satatrn_fsm #(
 			// }}}
 		FSM_DMA_OUT_SETUP: begin // DMA write to device
 			// {{{
-			o_mm2s_request <= 0;
+			if (o_mm2s_request && !i_mm2s_busy)
+			begin
+				// Prefetch request, issued from FSM_COMMAND
+				o_mm2s_request <= 0;
+				// Verilator lint_off WIDTH
+				o_mm2s_addr <= o_mm2s_addr + o_tran_len;
+				// Verilator lint_on  WIDTH
+			end
 			o_tran_src <= SRC_MM2S;
-			o_tran_len <= (dma_length > 2048) ? 2048 : dma_length[LGLENGTH:0];
+			// A prefetched DATA FIS keeps its length until it's sent
+			if (!o_tx_hold)
+				o_tran_len <= (dma_length > 2048) ? 2048 : dma_length[LGLENGTH:0];
 			if (s_pkt_valid && s_sop
 					&& s_brdata[7:0] == FIS_REG_TO_HOST)
 			begin
@@ -687,15 +807,27 @@ module	satatrn_fsm #(
 					&& s_brdata[7:0] == FIS_DMA_ACTIVATE)
 			begin
 				fsm_state <= FSM_DMA_TXDATA;
-				o_mm2s_request <= 1;
-				dma_length <= (dma_length >= 2048) ? (dma_length - 2048) : 0; // DATA_FIS
 				o_tran_req <= 1;
+				if (o_tx_hold)
+				begin
+					// This DATA FIS was prefetched.  Let it go.
+					o_tx_hold <= 1'b0;
+				end else begin
+					o_mm2s_request <= 1;
+					dma_length <= (dma_length >= 2048) ? (dma_length - 2048) : 0; // DATA_FIS
+				end
 			end end
 			// }}}
 		FSM_DMA_TXDATA: begin // DMA write to device
 			// {{{
 			if (o_mm2s_request && !i_mm2s_busy)
+			begin
 				o_mm2s_request <= 0;
+				// The next DATA FIS picks up where this one ends
+				// Verilator lint_off WIDTH
+				o_mm2s_addr <= o_mm2s_addr + o_tran_len;
+				// Verilator lint_on  WIDTH
+			end
 			if (o_tran_req && !i_tran_busy)
 				o_tran_req <= 0;
 			if (!o_tran_req && !i_tran_busy
@@ -760,7 +892,36 @@ module	satatrn_fsm #(
 		end
 	end
 
-	assign	w_phy_data = { 24'h0,
+	// o_sg_enable
+	// {{{
+	// Scatter-gather mode may only be changed between commands
+	initial	o_sg_enable = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset || !OPT_SG)
+		o_sg_enable <= 1'b0;
+	else if (!r_busy && !known_cmd && i_wb_stb && !o_wb_stall && i_wb_we
+				&& i_wb_addr == ADDR_PHY && i_wb_sel[1])
+		o_sg_enable <= i_wb_data[8];
+
+	// The walk starts over with every new command
+	always @(posedge i_clk)
+		o_sg_start <= !i_reset && known_cmd;
+
+	assign	o_sg_table = r_dma_address;
+	// }}}
+
+	// o_cmd_read, o_cmd_write, o_cmd_sectors
+	// {{{
+	// dma_length has yet to be touched on the clock following known_cmd,
+	// so it still holds the whole transfer length
+	assign	o_cmd_read  = (cmd_type == CMD_PIO_READ)
+				|| (cmd_type == CMD_DMA_READ);
+	assign	o_cmd_write = (cmd_type == CMD_PIO_WRITE)
+				|| (cmd_type == CMD_DMA_WRITE);
+	assign	o_cmd_sectors = dma_length[25:9];
+	// }}}
+
+	assign	w_phy_data = { 23'h0, o_sg_enable,
 			fsm_state,
 			tran_failed, link_dropped, reset_hold, o_phy_reset };
 
@@ -848,6 +1009,7 @@ module	satatrn_fsm #(
 	// }}}
 
 	assign	o_int = r_int || return_to_idle;
+	assign	o_busy = r_busy;
 	////////////////////////////////////////////////////////////////////////
 	//
 	// o_debug
@@ -0,0 +1,423 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	rtl/satatrn_perf.v
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Performance counters, readable through a single register (4)
+//		of the controller.  Writing to the register selects a
+//	counter.  Each read returns the selected counter, and then moves on
+//	to the next one, so that all of the counters may be read with one
+//	burst of reads from the same address.
+//
+//	The link layer counters are kept in the PHY clock domain.  A snapshot
+//	of them is copied to the bus clock domain every few clocks, so they
+//	may lag the bus clock counters by a handful of clocks.
+//
+// Register (4)
+//	Write:	[31]	Clear all counters
+//		[4:0]	Select the next counter to be read (requires sel[0])
+//	Read:	The selected counter.  The selection then advances.
+//
+// Counters
+//	0:	Commands completed
+//	1:	Sectors read (by DMA or PIO)
+//	2:	Sectors written
+//	3-4:	Clocks with the DMA bus cycle line high (64-bits, low word first)
+//	5-6:	Clocks the DMA was stalled (64-bits)
+//	7-8:	Total command latency, in clocks (64-bits)
+//	9:	Worst case command latency, in clocks
+//	10:	RX FIFO high water mark, in bus words
+//	11:	TX FIFO high water mark, in bus words
+//	12:	R_ERR primitives received (one per run)
+//	13:	Transmit failures, for which the FIS must be retried
+//	14:	Clocks spent sending HOLD
+//	15:	Clocks spent receiving HOLD
+//	16:	ALIGN primitives sent
+//	17:	Clocks the DMA read (s2mm) waited on the DMA arbiter
+//	18:	Clocks the DMA write (mm2s) waited on the DMA arbiter
+//
+//	Reading the low word of a 64-bit counter captures the high word, so
+//	that the two may be read as one value.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+`timescale	1ns/1ps
+// }}}
+module	satatrn_perf #(
+		// {{{
+		parameter	LGFILL = 11,	// Width of the FIFO fill levels
+		parameter [0:0]	OPT_LOWPOWER = 1'b0
+		// }}}
+	) (
+		// {{{
+		input	wire			i_clk, i_reset,
+		input	wire			i_phy_clk, i_phy_reset_n,
+		// Register interface
+		// {{{
+		// i_wb_stb is only ever raised for accepted requests to this
+		// register.  Acknowledgments take one clock, as with the FSM.
+		input	wire			i_wb_stb, i_wb_we,
+		input	wire	[31:0]		i_wb_data,
+		input	wire	[3:0]		i_wb_sel,
+		output	reg			o_wb_ack,
+		output	reg	[31:0]		o_wb_data,
+		// }}}
+		// Bus clock events
+		// {{{
+		input	wire			i_cmd_start, i_busy,
+		input	wire			i_cmd_read, i_cmd_write,
+		input	wire	[16:0]		i_cmd_sectors,
+		input	wire			i_dma_cyc, i_dma_stall,
+		input	wire	[LGFILL-1:0]	i_rxfifo_fill, i_txfifo_fill,
+		input	wire			i_rxdma_wait, i_txdma_wait,
+		// }}}
+		// PHY clock events
+		// {{{
+		// { ALIGN sent, HOLD received, HOLD sent, R_ERR received,
+		//	transmit failed }
+		input	wire	[4:0]		i_phy_events
+		// }}}
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam	NPHY = 5;
+	localparam	[4:0]	PERF_CMDS	= 5'd0,
+				PERF_RDSECTORS	= 5'd1,
+				PERF_WRSECTORS	= 5'd2,
+				PERF_DMABUSY	= 5'd3,
+				PERF_DMABUSYHI	= 5'd4,
+				PERF_DMASTALL	= 5'd5,
+				PERF_DMASTALLHI	= 5'd6,
+				PERF_LATENCY	= 5'd7,
+				PERF_LATENCYHI	= 5'd8,
+				PERF_MAXLAT	= 5'd9,
+				PERF_RXHWM	= 5'd10,
+				PERF_TXHWM	= 5'd11,
+				PERF_PHY	= 5'd12,
+				PERF_RXWAIT	= 5'd17,
+				PERF_TXWAIT	= 5'd18,
+				PERF_LAST	= 5'd18;
+	integer	k;
+
+	wire		perf_clear;
+	reg	[4:0]	perf_sel;
+	reg		clear_request;
+	reg	[31:0]	hi_shadow, perf_word;
+
+	reg	[31:0]	cmd_count, rd_sectors, wr_sectors, max_latency;
+	reg	[31:0]	rx_wait, tx_wait;
+	reg	[63:0]	dma_busy, dma_stall, total_latency;
+	reg	[31:0]	cmd_latency;
+	reg		cmd_active, cmd_read, cmd_write;
+	reg	[16:0]	cmd_sectors;
+	reg	[LGFILL-1:0]	rx_hwm, tx_hwm;
+
+	reg	[31:0]	phy_count	[0:NPHY-1];
+	reg	[31:0]	phy_snapshot	[0:NPHY-1];
+	reg	[31:0]	phy_copy	[0:NPHY-1];
+
+	reg		wb_req, wb_req_clear, wb_pending, wb_ack_last;
+	(* ASYNC_REG="TRUE" *)	reg	[1:0]	wb_ack_pipe;
+	(* ASYNC_REG="TRUE" *)	reg	[1:0]	phy_req_pipe;
+	reg		phy_req_last, phy_ack;
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Bus clock counters
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	assign	perf_clear = i_wb_stb && i_wb_we && i_wb_sel[3] && i_wb_data[31];
+
+	// clear_request
+	// {{{
+	// Holds a clear that arrives while a PHY snapshot is outstanding,
+	// until it can be passed on with the next snapshot request
+	always @(posedge i_clk)
+	if (i_reset)
+		clear_request <= 1'b0;
+	else if (perf_clear && wb_pending)
+		clear_request <= 1'b1;
+	else if (!wb_pending)
+		clear_request <= 1'b0;
+	// }}}
+
+	// Command counts, sectors, and latency
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || perf_clear)
+	begin
+		cmd_count     <= 0;
+		rd_sectors    <= 0;
+		wr_sectors    <= 0;
+		total_latency <= 0;
+		max_latency   <= 0;
+	end else if (cmd_active && !i_busy)
+	begin
+		cmd_count     <= cmd_count + 1;
+		if (cmd_read)
+			rd_sectors <= rd_sectors + { 15'h0, cmd_sectors };
+		if (cmd_write)
+			wr_sectors <= wr_sectors + { 15'h0, cmd_sectors };
+		total_latency <= total_latency + { 32'h0, cmd_latency };
+		if (cmd_latency > max_latency)
+			max_latency <= cmd_latency;
+	end
+
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		cmd_active  <= 1'b0;
+		cmd_read    <= 1'b0;
+		cmd_write   <= 1'b0;
+		cmd_sectors <= 0;
+		cmd_latency <= 0;
+	end else if (i_cmd_start)
+	begin
+		// The command register was written two clocks ago
+		cmd_active  <= 1'b1;
+		cmd_read    <= i_cmd_read;
+		cmd_write   <= i_cmd_write;
+		// 17 bits, to cover the 65536 sector maximum
+		cmd_sectors <= i_cmd_sectors;
+		cmd_latency <= 2;
+	end else if (cmd_active)
+	begin
+		if (!i_busy)
+			cmd_active <= 1'b0;
+		else if (!(&cmd_latency))
+			cmd_latency <= cmd_latency + 1;
+	end
+	// }}}
+
+	// DMA usage
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || perf_clear)
+	begin
+		dma_busy  <= 0;
+		dma_stall <= 0;
+	end else begin
+		if (i_dma_cyc)
+			dma_busy <= dma_busy + 1;
+		if (i_dma_stall)
+			dma_stall <= dma_stall + 1;
+	end
+	// }}}
+
+	// DMA arbitration stalls
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || perf_clear)
+	begin
+		rx_wait <= 0;
+		tx_wait <= 0;
+	end else begin
+		if (i_rxdma_wait)
+			rx_wait <= rx_wait + 1;
+		if (i_txdma_wait)
+			tx_wait <= tx_wait + 1;
+	end
+	// }}}
+
+	// FIFO high water marks
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || perf_clear)
+	begin
+		rx_hwm <= 0;
+		tx_hwm <= 0;
+	end else begin
+		if (i_rxfifo_fill > rx_hwm)
+			rx_hwm <= i_rxfifo_fill;
+		if (i_txfifo_fill > tx_hwm)
+			tx_hwm <= i_txfifo_fill;
+	end
+	// }}}
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// PHY clock counters
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	// The bus clock toggles wb_req to ask for a snapshot.  The PHY clock
+	// copies its counters into phy_snapshot, clearing them if asked, and
+	// then toggles phy_ack.  phy_snapshot and wb_req_clear are then held
+	// constant until the next toggle of wb_req, which will not come until
+	// phy_ack has returned.
+	//
+	// The handshake itself is never reset, lest a toggle be lost.
+
+	// Bus clock side of the handshake
+	// {{{
+	initial	{ wb_ack_last, wb_ack_pipe } = 3'b0;
+	always @(posedge i_clk)
+		{ wb_ack_last, wb_ack_pipe } <= { wb_ack_pipe, phy_ack };
+
+	initial	wb_req       = 1'b0;
+	initial	wb_req_clear = 1'b0;
+	initial	wb_pending   = 1'b0;
+	always @(posedge i_clk)
+	if (!wb_pending)
+	begin
+		wb_req       <= !wb_req;
+		wb_req_clear <= clear_request || perf_clear;
+		wb_pending   <= 1'b1;
+	end else if (wb_ack_last != wb_ack_pipe[1])
+		wb_pending <= 1'b0;
+
+	always @(posedge i_clk)
+	if (i_reset || clear_request || perf_clear)
+	begin
+		// Any snapshot taken before the clear request is stale
+		for(k=0; k<NPHY; k=k+1)
+			phy_copy[k] <= 0;
+	end else if (wb_pending && wb_ack_last != wb_ack_pipe[1])
+	begin
+		for(k=0; k<NPHY; k=k+1)
+			phy_copy[k] <= (wb_req_clear) ? 0 : phy_snapshot[k];
+	end
+	// }}}
+
+	// PHY clock side of the handshake
+	// {{{
+	initial	{ phy_req_last, phy_req_pipe } = 3'b0;
+	always @(posedge i_phy_clk)
+		{ phy_req_last, phy_req_pipe } <= { phy_req_pipe, wb_req };
+
+	initial	phy_ack = 1'b0;
+	always @(posedge i_phy_clk)
+	if (phy_req_last != phy_req_pipe[1])
+		phy_ack <= !phy_ack;
+
+	always @(posedge i_phy_clk)
+	if (phy_req_last != phy_req_pipe[1])
+	begin
+		for(k=0; k<NPHY; k=k+1)
+			phy_snapshot[k] <= phy_count[k];
+	end
+
+	always @(posedge i_phy_clk)
+	if (!i_phy_reset_n
+		|| (phy_req_last != phy_req_pipe[1] && wb_req_clear))
+	begin
+		for(k=0; k<NPHY; k=k+1)
+			phy_count[k] <= 0;
+	end else begin
+		for(k=0; k<NPHY; k=k+1)
+		if (i_phy_events[k])
+			phy_count[k] <= phy_count[k] + 1;
+	end
+	// }}}
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Register interface
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	always @(*)
+	begin
+		perf_word = 32'h0;
+		case(perf_sel)
+		PERF_CMDS:		perf_word = cmd_count;
+		PERF_RDSECTORS:		perf_word = rd_sectors;
+		PERF_WRSECTORS:		perf_word = wr_sectors;
+		PERF_DMABUSY:		perf_word = dma_busy[31:0];
+		PERF_DMASTALL:		perf_word = dma_stall[31:0];
+		PERF_LATENCY:		perf_word = total_latency[31:0];
+		PERF_DMABUSYHI, PERF_DMASTALLHI,
+		PERF_LATENCYHI:		perf_word = hi_shadow;
+		PERF_MAXLAT:		perf_word = max_latency;
+		// Verilator lint_off WIDTH
+		PERF_RXHWM:		perf_word = rx_hwm;
+		PERF_TXHWM:		perf_word = tx_hwm;
+		PERF_RXWAIT:		perf_word = rx_wait;
+		PERF_TXWAIT:		perf_word = tx_wait;
+		default:
+			if (perf_sel >= PERF_PHY && perf_sel < PERF_PHY + NPHY)
+				perf_word = phy_copy[perf_sel - PERF_PHY];
+		// Verilator lint_on  WIDTH
+		endcase
+	end
+
+	// perf_sel, hi_shadow
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		perf_sel  <= 0;
+		hi_shadow <= 0;
+	end else if (i_wb_stb && i_wb_we)
+	begin
+		if (i_wb_sel[0])
+			perf_sel <= (i_wb_data[4:0] > PERF_LAST) ? 0
+						: i_wb_data[4:0];
+	end else if (i_wb_stb)
+	begin
+		perf_sel <= (perf_sel >= PERF_LAST) ? 0 : (perf_sel + 1);
+
+		case(perf_sel)
+		PERF_DMABUSY:	hi_shadow <= dma_busy[63:32];
+		PERF_DMASTALL:	hi_shadow <= dma_stall[63:32];
+		PERF_LATENCY:	hi_shadow <= total_latency[63:32];
+		default: begin end
+		endcase
+	end
+	// }}}
+
+	initial	o_wb_ack = 1'b0;
+	always @(posedge i_clk)
+		o_wb_ack <= !i_reset && i_wb_stb;
+
+	always @(posedge i_clk)
+	if (OPT_LOWPOWER && (i_reset || !i_wb_stb || i_wb_we))
+		o_wb_data <= 32'h0;
+	else
+		o_wb_data <= perf_word;
+	// }}}
+
+	// Keep Verilator happy
+	// {{{
+	// Verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, i_wb_data[30:5], i_wb_sel[2:1] };
+	// Verilator lint_on  UNUSED
+	// }}}
+endmodule
@@ -0,0 +1,614 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	rtl/satatrn_queue.v
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A memory resident command queue.  Rather than writing each
+//		command to the shadow registers, and waiting for the
+//	controller to go idle before writing the next, software may place
+//	commands into a submission ring in memory and then write the new
+//	tail index to a doorbell register.  The queue engine then fetches
+//	each command over the DMA port, issues it to the transport FSM by
+//	writing the FSM's own registers, waits for the command to complete,
+//	and writes a completion entry to a completion ring.
+//
+// Registers (at offsets 8-15 of the controller)
+//	0 (8):	QCTRL
+//		[31]	Enable.  Setting this bit resets all ring indexes to zero.
+//			Do not set it again until the queue is no longer active.
+//		[30]	Error.  A bus error while fetching a command, or writing
+//			a completion.  The queue is disabled.  Write a 1 to clear.
+//		[29]	Active (read only).  A command is in progress.
+//		[3:0]	log_2 of the number of entries in each ring.  One entry
+//			is always left empty, to tell a full ring from an empty
+//			one, so the smallest ring has two entries.  Writing
+//			zero sets this to one.
+//	1 (9):	Submission ring base (byte) address
+//	2 (10):	Completion ring base (byte) address
+//	3 (11):	Submission doorbell.  Write the new tail index.
+//		Reads { head, tail }, where head is the next entry to be fetched
+//	4 (12):	Completion doorbell.  Write the new head index, once entries
+//		have been consumed.  Reads { tail, head }, where tail is the
+//		next completion to be written.
+//	5 (13):	Interrupt moderation
+//		[31:8]	Timeout.  Interrupt once any completion has waited this
+//			many clocks.  Zero disables the timeout.
+//		[7:0]	Threshold.  Interrupt once this many completions are
+//			waiting in the ring.  Zero acts as one.
+//	6 (14):	Interrupt status
+//		Read:	[31]	Interrupt pending
+//			[30]	Interrupt was caused by the timeout
+//			[15:0]	Completions waiting in the ring
+//		Write:	[31]	Acknowledge.  The interrupt is dropped, even if
+//				completions remain, until the next completion.
+//
+// Submission entries (32 bytes, eight 32-bit words)
+//	0:	As written to the command register (0)
+//	1:	As written to the LBA low register (1)
+//	2:	As written to the LBA high register (2)
+//	3:	As written to the count register (3)
+//	4-5:	DMA address, as written to registers 6 and 7
+//	6:	Command ID, returned in the completion
+//	7:	(Unused)
+//
+// Completion entries (16 bytes, four 32-bit words)
+//	0:	Command ID
+//	1:	Status, as read from the command register (0) upon completion
+//	2:	[31:16] Submission ring head, following this command
+//		[0]	Phase.  Set on the first pass through the ring, cleared
+//			on the second, and so on.  Software may use this to tell
+//			new entries from old ones.
+//	3:	(Zero)
+//
+//	By default, the interrupt is held high while the completion ring is
+//	not empty, i.e. until software writes the completion doorbell.  With
+//	moderation, the interrupt waits for either enough completions or the
+//	timeout.  The timer restarts whenever software reaps completions.
+//
+//	As with the scatter-gather descriptors, ring addresses must fit in
+//	32 bits.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+`timescale	1ns/1ps
+// }}}
+module	satatrn_queue #(
+		// {{{
+		parameter	DW=32, AW=30,
+		parameter	ADDRESS_WIDTH = AW + $clog2(DW/8),
+		parameter [0:0]	OPT_LOWPOWER = 1'b0
+		// }}}
+	) (
+		// {{{
+		input	wire			i_clk, i_reset,
+		// Register interface, never stalls
+		// {{{
+		input	wire			i_wb_stb, i_wb_we,
+		input	wire	[2:0]		i_wb_addr,
+		input	wire	[31:0]		i_wb_data,
+		input	wire	[3:0]		i_wb_sel,
+		output	reg			o_wb_ack,
+		output	reg	[31:0]		o_wb_data,
+		// }}}
+		// Command issue, to the FSM's registers
+		// {{{
+		output	reg			o_ctl_cyc, o_ctl_stb,
+		output	wire			o_ctl_we,
+		output	reg	[2:0]		o_ctl_addr,
+		output	reg	[31:0]		o_ctl_data,
+		output	wire	[3:0]		o_ctl_sel,
+		input	wire			i_ctl_stall, i_ctl_ack,
+		input	wire	[31:0]		i_ctl_data,
+		//
+		input	wire			i_busy,
+		// }}}
+		// DMA, to fetch commands and write completions
+		// {{{
+		output	reg			o_dma_cyc, o_dma_stb,
+		output	wire			o_dma_we,
+		output	reg	[AW-1:0]	o_dma_addr,
+		output	reg	[DW-1:0]	o_dma_data,
+		output	reg	[DW/8-1:0]	o_dma_sel,
+		input	wire			i_dma_stall, i_dma_ack,
+		input	wire	[DW-1:0]	i_dma_data,
+		input	wire			i_dma_err,
+		// }}}
+		output	reg			o_enable,
+		output	wire			o_int
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam	WBLSB = $clog2(DW/8);
+	localparam	[2:0]	ADDR_QCTRL  = 3'h0,
+				ADDR_SQBASE = 3'h1,
+				ADDR_CQBASE = 3'h2,
+				ADDR_SQDB   = 3'h3,
+				ADDR_CQDB   = 3'h4,
+				ADDR_QINTR  = 3'h5,
+				ADDR_QISTAT = 3'h6;
+	// FSM register addresses
+	localparam	[2:0]	FSM_CMD	= 3'h0,
+				FSM_LBALO = 3'h1,
+				FSM_LBAHI = 3'h2,
+				FSM_COUNT = 3'h3,
+				FSM_LO	= 3'h6,
+				FSM_HI	= 3'h7;
+	localparam	[2:0]	Q_IDLE   = 3'h0,
+				Q_FETCH  = 3'h1,
+				Q_ISSUE  = 3'h2,
+				Q_WAIT   = 3'h3,
+				Q_STATUS = 3'h4,
+				Q_COMPLETE = 3'h5;
+	localparam	SQ_WORDS = 7,	// Words fetched per submission
+			CQ_WORDS = 4;	// Words written per completion
+
+	reg	[2:0]	q_state;
+	reg		q_err;
+	reg	[3:0]	lgsize;
+	reg	[15:0]	size_mask;
+	reg	[31:0]	sq_base, cq_base;
+	reg	[15:0]	sq_head, sq_tail, cq_head, cq_tail;
+	reg		cq_phase;
+	wire		sq_empty, cq_full;
+	wire	[15:0]	sq_next, cq_next;
+
+	reg	[31:0]	sq_entry	[0:SQ_WORDS-1];
+	reg	[31:0]	cq_status;
+	reg	[2:0]	dma_nreq, dma_nack, ctl_nreq, ctl_nack;
+	reg	[31:0]	dma_word;
+	wire	[31:0]	dma_rword;
+	reg	[31:0]	req_addr, ack_addr;
+
+	reg	[7:0]	int_threshold;
+	reg	[23:0]	int_timeout, int_age;
+	reg		int_masked;
+	wire		cq_push, int_count, int_timed_out;
+	wire	[15:0]	cq_pending;
+	// }}}
+
+	// Verilator lint_off WIDTH
+	assign	sq_next  = (sq_head + 1) & size_mask;
+	assign	cq_next  = (cq_tail + 1) & size_mask;
+	// Verilator lint_on  WIDTH
+	assign	sq_empty = (sq_head == sq_tail);
+	assign	cq_full  = (cq_next == cq_head);
+
+	always @(*)
+		size_mask = (16'h1 << lgsize) - 1;
+
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Register interface
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		// {{{
+		o_enable <= 1'b0;
+		lgsize   <= 1;
+		sq_base  <= 0;
+		cq_base  <= 0;
+		sq_tail  <= 0;
+		cq_head  <= 0;
+		int_threshold <= 0;
+		int_timeout   <= 0;
+		// }}}
+	end else begin
+		if (q_err)
+			o_enable <= 1'b0;
+
+		if (i_wb_stb && i_wb_we)
+		case(i_wb_addr)
+		ADDR_QCTRL: begin
+			// {{{
+			if (i_wb_sel[3])
+			begin
+				o_enable <= i_wb_data[31];
+				if (i_wb_data[31] && !o_enable)
+				begin
+					sq_tail <= 0;
+					cq_head <= 0;
+				end
+			end
+			// A one entry ring could hold nothing, so don't
+			// allow one
+			if (i_wb_sel[0])
+				lgsize <= (i_wb_data[3:0] == 0) ? 4'h1
+							: i_wb_data[3:0];
+			end
+			// }}}
+		ADDR_SQBASE: sq_base <= i_wb_data;
+		ADDR_CQBASE: cq_base <= i_wb_data;
+		ADDR_SQDB: if (&i_wb_sel[1:0])
+			sq_tail <= i_wb_data[15:0] & size_mask;
+		ADDR_CQDB: if (&i_wb_sel[1:0])
+			cq_head <= i_wb_data[15:0] & size_mask;
+		ADDR_QINTR: begin
+			// {{{
+			if (i_wb_sel[0])
+				int_threshold <= i_wb_data[7:0];
+			if (i_wb_sel[1])
+				int_timeout[7:0]   <= i_wb_data[15:8];
+			if (i_wb_sel[2])
+				int_timeout[15:8]  <= i_wb_data[23:16];
+			if (i_wb_sel[3])
+				int_timeout[23:16] <= i_wb_data[31:24];
+			end
+			// }}}
+		default: begin end
+		endcase
+	end
+
+	initial	o_wb_ack = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		o_wb_ack <= 1'b0;
+	else
+		o_wb_ack <= i_wb_stb;
+
+	always @(posedge i_clk)
+	if (OPT_LOWPOWER && (i_reset || !i_wb_stb || i_wb_we))
+		o_wb_data <= 32'h0;
+	else begin
+		o_wb_data <= 32'h0;
+		case(i_wb_addr)
+		ADDR_QCTRL:  o_wb_data <= { o_enable, q_err, (q_state != Q_IDLE),
+					25'h0, lgsize };
+		ADDR_SQBASE: o_wb_data <= sq_base;
+		ADDR_CQBASE: o_wb_data <= cq_base;
+		ADDR_SQDB:   o_wb_data <= { sq_head, sq_tail };
+		ADDR_CQDB:   o_wb_data <= { cq_tail, cq_head };
+		ADDR_QINTR:  o_wb_data <= { int_timeout, int_threshold };
+		ADDR_QISTAT: o_wb_data <= { o_int, int_timed_out && !int_count,
+					14'h0, cq_pending };
+		default: begin end
+		endcase
+	end
+
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Interrupt moderation
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	assign	cq_push = (q_state == Q_COMPLETE) && i_dma_ack && !i_dma_err
+				&& (dma_nack == CQ_WORDS-1);
+	assign	cq_pending = (cq_tail - cq_head) & size_mask;
+
+	// int_age: Clocks since the oldest completion arrived, or since
+	// software last reaped or acknowledged completions
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || cq_pending == 0
+		|| (i_wb_stb && i_wb_we && i_wb_addr == ADDR_CQDB)
+		|| (i_wb_stb && i_wb_we && i_wb_addr == ADDR_QISTAT
+				&& i_wb_sel[3] && i_wb_data[31]))
+		int_age <= 0;
+	else if (!(&int_age))
+		int_age <= int_age + 1;
+	// }}}
+
+	// int_masked: Acknowledged, waiting on the next completion
+	// {{{
+	always @(posedge i_clk)
+	if (i_reset || cq_push)
+		int_masked <= 1'b0;
+	else if (i_wb_stb && i_wb_we && i_wb_addr == ADDR_QISTAT
+				&& i_wb_sel[3] && i_wb_data[31])
+		int_masked <= 1'b1;
+	// }}}
+
+	assign	int_count = (cq_pending != 0)
+				&& (cq_pending >= { 8'h0, int_threshold });
+	assign	int_timed_out = (cq_pending != 0) && (int_timeout != 0)
+				&& (int_age >= int_timeout);
+
+	assign	o_int = o_enable && !int_masked && (int_count || int_timed_out);
+	// }}}
+	////////////////////////////////////////////////////////////////////////
+	//
+	// Queue state machine
+	// {{{
+	////////////////////////////////////////////////////////////////////////
+	//
+	//
+
+	// req_addr, ack_addr: Byte address of the next DMA request, and of
+	// the next DMA acknowledgment
+	// {{{
+	always @(*)
+	begin
+		if (q_state == Q_COMPLETE)
+		begin
+			// Verilator lint_off WIDTH
+			req_addr = cq_base + { cq_tail, 4'h0 } + { dma_nreq, 2'b00 };
+			ack_addr = cq_base + { cq_tail, 4'h0 } + { dma_nack, 2'b00 };
+		end else begin
+			req_addr = sq_base + { sq_head, 5'h0 } + { dma_nreq, 2'b00 };
+			ack_addr = sq_base + { sq_head, 5'h0 } + { dma_nack, 2'b00 };
+			// Verilator lint_on  WIDTH
+		end
+	end
+	// }}}
+
+	// dma_word: The next completion word to be written
+	// {{{
+	always @(*)
+	case(dma_nreq)
+	3'h0:	dma_word = sq_entry[6];
+	3'h1:	dma_word = cq_status;
+	3'h2:	dma_word = { sq_next, 15'h0, cq_phase };
+	// 3'h3: Zero, so no stale memory is left in the entry
+	default: dma_word = 32'h0;
+	endcase
+	// }}}
+
+	// dma_rword, o_dma_data, o_dma_sel: 32-bit words to/from the bus
+	// {{{
+	generate if (DW == 32)
+	begin : GEN_NARROW
+		assign	dma_rword = i_dma_data;
+
+		always @(*)
+		begin
+			o_dma_data = dma_word;
+			o_dma_sel  = 4'hf;
+		end
+	end else begin : GEN_WIDE
+		// Words are big-endian within the bus word
+		wire	[DW-1:0]	shifted;
+
+		assign	shifted = i_dma_data << (32 * ack_addr[WBLSB-1:2]);
+		assign	dma_rword = shifted[DW-1:DW-32];
+
+		always @(*)
+		begin
+			o_dma_data = { dma_word, {(DW-32){1'b0}} }
+						>> (32 * req_addr[WBLSB-1:2]);
+			o_dma_sel  = { 4'hf, {(DW/8-4){1'b0}} }
+						>> (4 * req_addr[WBLSB-1:2]);
+		end
+	end endgenerate
+
+	always @(*)
+		o_dma_addr = req_addr[ADDRESS_WIDTH-1:WBLSB];
+	// }}}
+
+	assign	o_dma_we = (q_state == Q_COMPLETE);
+	assign	o_ctl_we = (q_state == Q_ISSUE);
+	assign	o_ctl_sel = 4'hf;
+
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		// {{{
+		q_state   <= Q_IDLE;
+		q_err     <= 1'b0;
+		sq_head   <= 0;
+		cq_tail   <= 0;
+		cq_phase  <= 1'b1;
+		o_dma_cyc <= 1'b0;
+		o_dma_stb <= 1'b0;
+		o_ctl_cyc <= 1'b0;
+		o_ctl_stb <= 1'b0;
+		dma_nreq  <= 0;
+		dma_nack  <= 0;
+		ctl_nreq  <= 0;
+		ctl_nack  <= 0;
+		// }}}
+	end else begin
+		if (i_wb_stb && i_wb_we && i_wb_addr == ADDR_QCTRL)
+		begin
+			if (i_wb_sel[3] && i_wb_data[30])
+				q_err <= 1'b0;
+			if (i_wb_sel[3] && i_wb_data[31] && !o_enable)
+			begin
+				sq_head  <= 0;
+				cq_tail  <= 0;
+				cq_phase <= 1'b1;
+			end
+		end
+
+		case(q_state)
+		Q_IDLE: begin
+			// {{{
+			dma_nreq <= 0;
+			dma_nack <= 0;
+			ctl_nreq <= 0;
+			ctl_nack <= 0;
+			if (o_enable && !q_err && !sq_empty && !i_busy)
+			begin
+				q_state   <= Q_FETCH;
+				o_dma_cyc <= 1'b1;
+				o_dma_stb <= 1'b1;
+			end end
+			// }}}
+		Q_FETCH: begin
+			// {{{
+			// Read the submission entry
+			if (o_dma_stb && !i_dma_stall)
+			begin
+				dma_nreq <= dma_nreq + 1;
+				if (dma_nreq == SQ_WORDS-1)
+					o_dma_stb <= 1'b0;
+			end
+
+			if (i_dma_ack)
+			begin
+				dma_nack <= dma_nack + 1;
+				sq_entry[dma_nack] <= dma_rword;
+				if (dma_nack == SQ_WORDS-1)
+				begin
+					o_dma_cyc <= 1'b0;
+					q_state   <= Q_ISSUE;
+					o_ctl_cyc <= 1'b1;
+					o_ctl_stb <= 1'b1;
+				end
+			end
+
+			if (i_dma_err)
+			begin
+				o_dma_cyc <= 1'b0;
+				o_dma_stb <= 1'b0;
+				q_err     <= 1'b1;
+				q_state   <= Q_IDLE;
+			end end
+			// }}}
+		Q_ISSUE: begin
+			// {{{
+			// Write the FSM's registers, command register last
+			if (o_ctl_stb && !i_ctl_stall)
+			begin
+				ctl_nreq <= ctl_nreq + 1;
+				if (ctl_nreq == 5)
+					o_ctl_stb <= 1'b0;
+			end
+
+			if (i_ctl_ack)
+			begin
+				ctl_nack <= ctl_nack + 1;
+				if (ctl_nack == 5)
+				begin
+					o_ctl_cyc <= 1'b0;
+					q_state   <= Q_WAIT;
+				end
+			end end
+			// }}}
+		Q_WAIT: begin
+			// {{{
+			// The FSM is busy from the clock after the command is
+			// acknowledged, until it returns to idle.  Commands the
+			// FSM doesn't know never make it busy, and so complete
+			// immediately.
+			ctl_nreq <= 0;
+			ctl_nack <= 0;
+			dma_nreq <= 0;
+			dma_nack <= 0;
+			if (!i_busy)
+			begin
+				q_state   <= Q_STATUS;
+				o_ctl_cyc <= 1'b1;
+				o_ctl_stb <= 1'b1;
+			end end
+			// }}}
+		Q_STATUS: begin
+			// {{{
+			if (!i_ctl_stall)
+				o_ctl_stb <= 1'b0;
+			if (i_ctl_ack)
+			begin
+				o_ctl_cyc <= 1'b0;
+				cq_status <= i_ctl_data;
+				q_state   <= Q_COMPLETE;
+			end end
+			// }}}
+		Q_COMPLETE: begin
+			// {{{
+			// Write the completion entry, once there's room for it
+			if (!o_dma_cyc && !cq_full && dma_nreq == 0)
+			begin
+				o_dma_cyc <= 1'b1;
+				o_dma_stb <= 1'b1;
+			end
+
+			if (o_dma_stb && !i_dma_stall)
+			begin
+				dma_nreq <= dma_nreq + 1;
+				if (dma_nreq == CQ_WORDS-1)
+					o_dma_stb <= 1'b0;
+			end
+
+			if (i_dma_ack)
+			begin
+				dma_nack <= dma_nack + 1;
+				if (dma_nack == CQ_WORDS-1)
+				begin
+					o_dma_cyc <= 1'b0;
+					q_state   <= Q_IDLE;
+					sq_head   <= sq_next;
+					cq_tail   <= cq_next;
+					if (cq_next == 0)
+						cq_phase <= !cq_phase;
+				end
+			end
+
+			if (i_dma_err)
+			begin
+				o_dma_cyc <= 1'b0;
+				o_dma_stb <= 1'b0;
+				q_err     <= 1'b1;
+				q_state   <= Q_IDLE;
+			end end
+			// }}}
+		default: q_state <= Q_IDLE;
+		endcase
+	end
+
+	// o_ctl_addr, o_ctl_data
+	// {{{
+	always @(*)
+	begin
+		o_ctl_addr = FSM_CMD;
+		o_ctl_data = sq_entry[0];
+		if (q_state == Q_ISSUE)
+		case(ctl_nreq)
+		3'h0: begin o_ctl_addr = FSM_LBAHI; o_ctl_data = sq_entry[2]; end
+		3'h1: begin o_ctl_addr = FSM_LBALO; o_ctl_data = sq_entry[1]; end
+		3'h2: begin o_ctl_addr = FSM_COUNT; o_ctl_data = sq_entry[3]; end
+		3'h3: begin o_ctl_addr = FSM_LO;    o_ctl_data = sq_entry[4]; end
+		3'h4: begin o_ctl_addr = FSM_HI;    o_ctl_data = sq_entry[5]; end
+		default: begin o_ctl_addr = FSM_CMD; o_ctl_data = sq_entry[0]; end
+		endcase
+	end
+	// }}}
+
+	// }}}
+
+	// Make Verilator happy
+	// {{{
+	// verilator coverage_off
+	// verilator lint_off UNUSED
+	wire	unused;
+	assign	unused = &{ 1'b0, req_addr, ack_addr, sq_entry[6] };
+	// verilator lint_on  UNUSED
+	// verilator coverage_on
+	// }}}
+endmodule
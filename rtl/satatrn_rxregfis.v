@@ -39,14 +39,18 @@
 `timescale 1ns/1ps
 // }}}
 module	satatrn_rxregfis #(
-		parameter LGFIFO = 4
+		parameter LGFIFO = 4,
+		// OPT_CUTTHROUGH: A DATA FIS that fails its CRC check is
+		// passed through anyway, and reported via o_data_err, rather
+		// than being aborted
+		parameter [0:0]	OPT_CUTTHROUGH = 1'b0
 	) (
 		// {{{
 		input	wire		i_clk, i_reset,
 `ifndef	FORMAL
 		input	wire		i_phy_clk, i_phy_reset_n,
 `endif
-		input	wire		i_link_err,
+		input	wire		i_link_err, i_abort,
 		//
 		input	wire		i_valid,
 		input	wire	[31:0]	i_data,
@@ -58,7 +62,8 @@ module	satatrn_rxregfis #(
 		//
 		output	reg		o_data_valid,
 		output	reg	[31:0]	o_data_data,
-		output	reg		o_data_last
+		output	reg		o_data_last,
+		output	wire		o_data_err
 		// }}}
 	);
 
@@ -69,6 +74,7 @@ module	satatrn_rxregfis #(
 			is_datapacket_phy;
 	reg	[32:0]	afifo_wr_data;
 	wire		afifo_full, afifo_empty;
+	wire		data_crcerr, link_err;
 `ifdef	FORMAL
 	wire		i_phy_clk, i_phy_reset_n;
 
@@ -77,11 +83,22 @@ module	satatrn_rxregfis #(
 `endif
 	// }}}
 
+	// data_crcerr, link_err
+	// {{{
+	// The CRC check aborts a packet together with its last word.  In
+	// cut-through mode, let that word end a DATA FIS normally, and just
+	// report the error.  Every other abort still resets the packet.
+	assign	data_crcerr = OPT_CUTTHROUGH && i_abort && i_valid && i_last
+				&& is_datapacket_phy;
+	assign	link_err = i_link_err || (i_abort && !data_crcerr);
+	assign	o_data_err = data_crcerr;
+	// }}}
+
 	// mid_packet_phy
 	// {{{
 	initial	mid_packet_phy = 1'b0;
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		mid_packet_phy <= 1'b0;
 	else if (i_valid && !afifo_full)
 		mid_packet_phy <= !i_last;
@@ -91,7 +108,7 @@ module	satatrn_rxregfis #(
 	// {{{
 	initial	is_regpacket_phy = 1'b0;
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		is_regpacket_phy <= 1'b0;
 	else if (i_valid)
 	begin
@@ -112,7 +129,7 @@ module	satatrn_rxregfis #(
 	// afifo_wr_phy
 	// {{{
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		afifo_wr_phy <= 1'b0;
 	else if (i_valid && !afifo_full
 			&& (is_regpacket_phy
@@ -155,7 +172,7 @@ module	satatrn_rxregfis #(
 	// {{{
 	initial	is_datapacket_phy = 1'b0;
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		is_datapacket_phy <= 1'b0;
 	else if (i_valid)
 	begin
@@ -176,7 +193,7 @@ module	satatrn_rxregfis #(
 	// o_data_valid
 	// {{{
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		o_data_valid <= 1'b0;
 	else
 		o_data_valid <= i_valid && is_datapacket_phy;
@@ -214,7 +231,7 @@ module	satatrn_rxregfis #(
 	// {{{
 	initial	fi_word = 0;
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		fi_word <= 0;
 	else if (i_valid)
 		fi_word <= (i_last) ? 0 : (fi_word + 1);
@@ -240,7 +257,7 @@ module	satatrn_rxregfis #(
 
 	initial	fr_word = 0;
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		fr_word <= 0;
 	else if (o_reg_valid)
 		fr_word <= (o_reg_last) ? 0 : (fr_word + 1);
@@ -256,7 +273,7 @@ module	satatrn_rxregfis #(
 
 	initial	fd_word = 0;
 	always @(posedge i_phy_clk)
-	if (!i_phy_reset_n || i_link_err)
+	if (!i_phy_reset_n || link_err)
 		fd_word <= 0;
 	else if (o_data_valid)
 		fd_word <= (o_data_last) ? 0 : (fd_word + 1);
@@ -313,7 +330,7 @@ module	satatrn_rxregfis #(
 	// "Careless" assumptions
 	// {{{
 	always @(*)
-		assume(!i_link_err);
+		assume(!i_link_err && !i_abort);
 	// }}}
 `endif
 // }}}
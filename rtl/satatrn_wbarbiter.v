@@ -28,6 +28,19 @@
 //			again the alternating parameter is set, then the
 //			access is guaranteed to switch to B.)
 //
+//	The QOS scheme differs in that the bus may be taken from its owner
+//	before the owner is done with it.  Each master provides an urgency
+//	level, such as how close its FIFO is to overflowing or running dry.
+//	If the master waiting for the bus is more urgent than the owner, or
+//	as urgent and the owner has already issued QUANTUM requests since it
+//	was granted the bus, the owner is stalled.  Once its outstanding
+//	requests have been acknowledged, o_cyc drops for one clock and the
+//	bus then changes hands.  The original owner may keep its CYC line
+//	high throughout, and simply sees a stalled bus until it gets the bus
+//	back again.
+//
+//	o_a_wait and o_b_wait are high on every clock a master is requesting
+//	the bus, but being held off by the arbiter.
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -67,7 +80,14 @@ module	satatrn_wbarbiter #(
 		// {{{
 		parameter			DW=32, AW=32,
 		parameter			SCHEME="ALTERNATING",
-		parameter	[0:0]		OPT_ZERO_ON_IDLE = 1'b0
+		parameter	[0:0]		OPT_ZERO_ON_IDLE = 1'b0,
+		// QOS scheme only: the width of the urgency levels, the
+		// number of requests an owner may issue before it must yield
+		// to an equally urgent master, and the log (base two) of the
+		// most requests that may be outstanding at any time
+		parameter			LGLEVEL = 4,
+		parameter			QUANTUM = 16,
+		parameter			LGMAXOUT = 12
 `ifdef	FORMAL
 		, parameter			F_MAX_STALL = 3,
 		parameter			F_MAX_ACK_DELAY = 3,
@@ -93,6 +113,14 @@ module	satatrn_wbarbiter #(
 		input	wire	[(DW/8-1):0]	i_b_sel,
 		output	wire			o_b_stall, o_b_ack, o_b_err,
 		// }}}
+		// Urgency, used only by the QOS scheme
+		// {{{
+		input	wire	[LGLEVEL-1:0]	i_a_level, i_b_level,
+		// }}}
+		// Arbitration stalls
+		// {{{
+		output	wire			o_a_wait, o_b_wait,
+		// }}}
 		// Combined/arbitrated bus
 		// {{{
 		output	wire			o_cyc, o_stb, o_we,
@@ -122,9 +150,12 @@ module	satatrn_wbarbiter #(
 	// Local declarations
 	// {{{
 	reg	r_a_owner;
+	// arb_yield: The owner is being stalled, so as to give up the bus
+	// arb_gap:   o_cyc is forced low for a clock, before changing hands
+	wire	arb_yield, arb_gap;
 	// }}}
 
-	assign o_cyc = (r_a_owner) ? i_a_cyc : i_b_cyc;
+	assign o_cyc = ((r_a_owner) ? i_a_cyc : i_b_cyc) && !arb_gap;
 	initial	r_a_owner = 1'b1;
 
 	// r_a_owner -- determined through arbitration
@@ -132,6 +163,9 @@ module	satatrn_wbarbiter #(
 	generate if (SCHEME == "PRIORITY")
 	begin : PRI
 		// {{{
+		assign	arb_yield = 1'b0;
+		assign	arb_gap   = 1'b0;
+
 		always @(posedge i_clk)
 		if (!i_b_cyc)
 			r_a_owner <= 1'b1;
@@ -145,6 +179,9 @@ module	satatrn_wbarbiter #(
 		// {{{
 		reg	last_owner;
 
+		assign	arb_yield = 1'b0;
+		assign	arb_gap   = 1'b0;
+
 		initial	last_owner = 1'b0;
 		always @(posedge i_clk)
 		if ((i_a_cyc)&&(r_a_owner))
@@ -169,9 +206,94 @@ module	satatrn_wbarbiter #(
 
 		end
 		// }}}
+	end else if (SCHEME == "QOS")
+	begin : QOS
+		// {{{
+		localparam	LGQ = $clog2(QUANTUM+1);
+		reg			r_yield, r_gap;
+		reg	[LGQ-1:0]	r_beats;
+		reg	[LGMAXOUT:0]	r_outstanding;
+		wire			owner_cyc, other_stb, preempt;
+		wire	[LGLEVEL-1:0]	owner_level, other_level;
+
+		assign	owner_cyc   = (r_a_owner) ? i_a_cyc : i_b_cyc;
+		assign	other_stb   = (r_a_owner) ? i_b_stb : i_a_stb;
+		assign	owner_level = (r_a_owner) ? i_a_level : i_b_level;
+		assign	other_level = (r_a_owner) ? i_b_level : i_a_level;
+
+		// A more urgent master takes the bus at once.  An equally
+		// urgent one waits for the owner's quantum to run out.
+		assign	preempt = other_stb && ((other_level > owner_level)
+				|| (other_level == owner_level
+						&& r_beats >= QUANTUM));
+
+		// r_outstanding: Requests awaiting acknowledgment
+		// {{{
+		initial	r_outstanding = 0;
+		always @(posedge i_clk)
+		if (i_reset || !o_cyc || i_err)
+			r_outstanding <= 0;
+		else case({ (o_stb && !i_stall), i_ack })
+		2'b10: r_outstanding <= r_outstanding + 1;
+		2'b01: r_outstanding <= r_outstanding - 1;
+		default: begin end
+		endcase
+		// }}}
+
+		// r_beats: Requests issued since the bus was granted
+		// {{{
+		initial	r_beats = 0;
+		always @(posedge i_clk)
+		if (i_reset || !o_cyc)
+			r_beats <= 0;
+		else if (o_stb && !i_stall && r_beats < QUANTUM)
+			r_beats <= r_beats + 1;
+		// }}}
+
+		// r_a_owner, r_yield, r_gap
+		// {{{
+		initial	r_yield = 1'b0;
+		initial	r_gap   = 1'b0;
+		always @(posedge i_clk)
+		if (i_reset)
+		begin
+			r_a_owner <= 1'b1;
+			r_yield   <= 1'b0;
+			r_gap     <= 1'b0;
+		end else if (r_gap)
+		begin
+			// o_cyc has been low for a clock.  Hand the bus over,
+			// unless the other master has since given up on it.
+			if (other_stb)
+				r_a_owner <= !r_a_owner;
+			r_yield <= 1'b0;
+			r_gap   <= 1'b0;
+		end else if (!owner_cyc)
+		begin
+			// The owner is idle, anyone else may have the bus
+			r_yield <= 1'b0;
+			if (other_stb)
+				r_a_owner <= !r_a_owner;
+		end else if (r_yield)
+		begin
+			// Wait for the owner's requests to be acknowledged
+			if (!other_stb)
+				r_yield <= 1'b0;
+			else if (r_outstanding == 0 && !i_stall)
+				r_gap <= 1'b1;
+		end else if (preempt)
+			r_yield <= 1'b1;
+		// }}}
+
+		assign	arb_yield = r_yield;
+		assign	arb_gap   = r_gap;
+		// }}}
 	end else // if (SCHEME == "LAST")
 	begin : LST
 		// {{{
+		assign	arb_yield = 1'b0;
+		assign	arb_gap   = 1'b0;
+
 		always @(posedge i_clk)
 		if ((!i_a_cyc)&&(i_b_stb))
 			r_a_owner <= 1'b0;
@@ -204,21 +326,24 @@ module	satatrn_wbarbiter #(
 		// on the bus via VERILATOR when timing and logic counts
 		// don't matter.
 		//
-		assign o_stb     = (o_cyc)? ((r_a_owner) ? i_a_stb : i_b_stb):0;
+		assign o_stb     = (o_cyc && !arb_yield)
+					? ((r_a_owner) ? i_a_stb : i_b_stb):0;
 		assign o_adr     = (o_stb)? ((r_a_owner) ? i_a_adr : i_b_adr):0;
 		assign o_dat     = (o_stb)? ((r_a_owner) ? i_a_dat : i_b_dat):0;
 		assign o_sel     = (o_stb)? ((r_a_owner) ? i_a_sel : i_b_sel):0;
 		assign o_a_ack   = (o_cyc)&&( r_a_owner) ? i_ack   : 1'b0;
 		assign o_b_ack   = (o_cyc)&&(!r_a_owner) ? i_ack   : 1'b0;
-		assign o_a_stall = (o_cyc)&&( r_a_owner) ? i_stall : 1'b1;
-		assign o_b_stall = (o_cyc)&&(!r_a_owner) ? i_stall : 1'b1;
+		assign o_a_stall = (o_cyc)&&( r_a_owner)&&(!arb_yield)
+							? i_stall : 1'b1;
+		assign o_b_stall = (o_cyc)&&(!r_a_owner)&&(!arb_yield)
+							? i_stall : 1'b1;
 		assign o_a_err   = (o_cyc)&&( r_a_owner) ? i_err : 1'b0;
 		assign o_b_err   = (o_cyc)&&(!r_a_owner) ? i_err : 1'b0;
 		// }}}
 	end else begin : LOW_LOGIC
 		// {{{
 
-		assign o_stb = (r_a_owner) ? i_a_stb : i_b_stb;
+		assign o_stb = ((r_a_owner) ? i_a_stb : i_b_stb) && !arb_yield;
 		assign o_adr = (r_a_owner) ? i_a_adr : i_b_adr;
 		assign o_dat = (r_a_owner) ? i_a_dat : i_b_dat;
 		assign o_sel = (r_a_owner) ? i_a_sel : i_b_sel;
@@ -231,8 +356,9 @@ module	satatrn_wbarbiter #(
 
 		// Stall must be asserted on the same cycle the input master
 		// asserts the bus, if the bus isn't granted to him.
-		assign	o_a_stall = ( r_a_owner) ? i_stall : 1'b1;
-		assign	o_b_stall = (!r_a_owner) ? i_stall : 1'b1;
+		// The same is true while the owner is being made to yield.
+		assign	o_a_stall = ( r_a_owner && !arb_yield) ? i_stall : 1'b1;
+		assign	o_b_stall = (!r_a_owner && !arb_yield) ? i_stall : 1'b1;
 
 		//
 		//
@@ -242,12 +368,18 @@ module	satatrn_wbarbiter #(
 	end endgenerate
 	// }}}
 
+	// o_a_wait, o_b_wait
+	// {{{
+	assign	o_a_wait = i_a_stb && (!r_a_owner || arb_yield);
+	assign	o_b_wait = i_b_stb && ( r_a_owner || arb_yield);
+	// }}}
+
 	// Make Verilator happy
 	// {{{
 	// verilator coverage_off
 	// verilator lint_off UNUSED
 	wire	unused;
-	assign	unused = &{ 1'b0, i_reset };
+	assign	unused = &{ 1'b0, i_reset, i_a_level, i_b_level };
 	// verilator lint_on  UNUSED
 	// verilator coverage_on
 	// }}}
@@ -350,17 +482,40 @@ module	satatrn_wbarbiter #(
 
 	// Induction properties, relating nreqs and nacks to r_a_owner
 	// {{{
-	always @(posedge i_clk)
-	if (r_a_owner)
-	begin
-		assert(f_b_nreqs == 0);
-		assert(f_b_nacks == 0);
-		assert(f_a_outstanding == f_outstanding);
-	end else begin
-		assert(f_a_nreqs == 0);
-		assert(f_a_nacks == 0);
-		assert(f_b_outstanding == f_outstanding);
-	end
+	generate if (SCHEME == "QOS")
+	begin : F_QOS
+		// A master that has lost the bus may still hold CYC high,
+		// but with every one of its requests acknowledged
+		always @(posedge i_clk)
+		if (r_a_owner)
+		begin
+			assert(f_b_outstanding == 0);
+			assert(f_a_outstanding == f_outstanding);
+		end else begin
+			assert(f_a_outstanding == 0);
+			assert(f_b_outstanding == f_outstanding);
+		end
+
+		always @(posedge i_clk)
+		if (o_cyc)
+			assert(QOS.r_outstanding == f_outstanding);
+
+		always @(posedge i_clk)
+		if (arb_gap)
+			assert(arb_yield && QOS.r_outstanding == 0);
+	end else begin : F_OWNER
+		always @(posedge i_clk)
+		if (r_a_owner)
+		begin
+			assert(f_b_nreqs == 0);
+			assert(f_b_nacks == 0);
+			assert(f_a_outstanding == f_outstanding);
+		end else begin
+			assert(f_a_nreqs == 0);
+			assert(f_a_nacks == 0);
+			assert(f_b_outstanding == f_outstanding);
+		end
+	end endgenerate
 	// }}}
 
 	always @(posedge i_clk)
@@ -11,25 +11,111 @@
 //	to define it's operation:
 //
 //	1. sata_init
-//		This should be called first.  It will generate the driver's
-//		data structure, and attempt to interact with the device.
+//		This should be called first, once the link is up.  It will
+//		generate the driver's data structure, and then ask the drive
+//		(via IDENTIFY DEVICE) for its capacity and capabilities.
 //		It needs to be passed the hardware address of the device in
 //		the address map.
 //
 //	2. sata_write(dev, sector, count, buf)
 //		Writes "count" sectors of data to the device, starting at
 //		the sector numbered "sector".  The data are sourced from the
-//		*buf pointer, which *must* either be word aligned or the CPU
-//		must be able to handle unaligned accesses.
+//		*buf pointer, which *must* be word aligned.
 //
 //	3. sata_read(dev, sector, count, buf)
 //		Reads "count" sectors of data to the device, starting at
 //		the sector numbered "sector".  The data are saved into the
-//		*buf pointer, which *must* either be word aligned or the CPU
-//		must be able to handle unaligned accesses.
+//		*buf pointer, which *must* be word aligned.
 //
-//	4. sdio_ioctl
-//		Other odds and ends as necessary.
+//	4. sata_ioctl
+//		Other odds and ends as necessary.  CTRL_SYNC writes back the
+//		sector cache, waits on every request, and then flushes the
+//		drive's own write cache.  CTRL_TRIM tells the drive which
+//		sectors no longer hold data, via DATA SET MANAGEMENT, so that
+//		an SSD needn't copy them around as it collects its garbage.
+//
+//	5. sata_submit_write(dev, sector, count, buf, cb, arg)
+//	   sata_submit_read(dev, sector, count, buf, cb, arg)
+//		Start a write or read, and return immediately with a request
+//		handle.  Returns NULL if no handles remain, so the caller may
+//		try again once some complete, or SATA_INVALID if the request
+//		can never be started.  The buffer must not be touched until
+//		the request completes.
+//
+//		If cb is non-NULL, cb(arg, status) is called from sata_isr()
+//		once the request completes.  The handle is then released, and
+//		must not be waited upon.  Otherwise, the caller must call
+//		sata_wait() on the handle to collect its status.
+//
+//	6. sata_wait(dev, req)
+//		Waits for a request to complete, then returns its status and
+//		releases its handle.  Given SATA_INVALID, it returns RES_PARERR.
+//
+//	7. sata_isr(dev)
+//		The interrupt handler.  Reaps completions from the command
+//		queue, and completes any requests they finish.  Attach it to
+//		the controller's interrupt.  If so, SATA_DISABLE_INTS and
+//		SATA_RESTORE_INTS must be defined, so that it can't interrupt
+//		the driver while it's changing the queue.  With SATA_THREADS,
+//		it must instead be called from a task, as SATA_WAIT_INT does.
+//
+//	8. sata_lock(dev), sata_unlock(dev)
+//		The driver's own critical section, which keeps out both
+//		sata_isr() and other tasks.  Hold it around anything a
+//		completion callback also changes.  It may be nested.
+//
+//	All commands, blocking or not, go through the controller's command
+//	queue.  While waiting, the driver calls SATA_WAIT_INT(dev).  By
+//	default this simply polls sata_isr(), but it may be defined to wait
+//	for the interrupt, or to yield to an OS scheduler, instead.
+//
+// Scheduling: Requests wait in the driver until the controller's queue has
+//	fewer than SATA_QDEPTH commands in it.  They are then dispatched in
+//	LBA order, sweeping upwards from the end of the last command, save
+//	that a request passed over by SATA_LATENCY_BUDGET commands goes next.
+//	Requests that continue where the last one ended, in the same
+//	direction, are merged into a single command of up to 65536 sectors
+//	(256 for drives without 48-bit LBAs).  With scatter-gather mode, their buffers may be anywhere;
+//	otherwise, they must be adjacent in memory as well.  No request is
+//	ever moved ahead of an older one it overlaps, unless both are reads.
+//
+// Caching: If SATA_CACHE_SECTORS is non-zero, sata_read() and sata_write()
+//	go through a sector cache, held in a static memory pool and shared
+//	by the first device initialized.  Sectors are replaced least recently
+//	used first.  Writes are held in the cache until their sectors are
+//	evicted, or until CTRL_SYNC.  Reads that continue where the last
+//	read ended read ahead, with a window that doubles with every such
+//	read up to SATA_CACHE_RAMAX sectors.  Transfers longer than
+//	SATA_CACHE_BYPASS sectors go straight to the drive.  The asynchronous
+//	requests always bypass the cache, so issue a CTRL_SYNC before mixing
+//	them with cached I/O to the same sectors.
+//
+//	Drives with a volatile write cache of their own have it turned on
+//	by sata_init(), if SATA_WCACHE is set and the drive can flush it, and
+//	off otherwise.  CTRL_SYNC then issues FLUSH CACHE (EXT) once every
+//	write has completed, should the drive support it.
+//
+// DMA: Data moves straight between the drive and the caller's buffer.  With
+//	a data cache, the driver cleans the buffer's lines before the DMA
+//	reads them, and invalidates them around the DMA writing them.  Only
+//	whole cache lines of the caller's buffer are ever written by the DMA:
+//	in scatter-gather mode, any partial line at either end of a read goes
+//	through a bounce buffer instead, and is copied once the read is done.
+//	Each request handle has its own pair of bounce buffers.  Without
+//	scatter-gather, the caller must leave alone anything sharing a cache
+//	line with a read's buffer until the read completes.
+//
+// Threads: With SATA_THREADS defined, any number of tasks may call into the
+//	driver at once.  Their requests all wait in the one elevator.  Only
+//	one task at a time, the owner, touches the controller: whichever task
+//	first needs to wait on it takes it over until its next interrupt,
+//	reaps every completion, and then issues whatever the others queued up
+//	in the meantime, merged where possible.  The other tasks sleep until
+//	it's done.  Cached reads and writes take turns, one task at a time,
+//	and CTRL_SYNC waits on every task's requests, not just the caller's.
+//	SATA_WAIT_INT() is only ever called by the owner, and sata_isr() must
+//	not be attached to the interrupt itself--SATA_WAIT_INT() should call it
+//	once the interrupt arrives.
 //
 // Issues:
 //
@@ -64,11 +150,12 @@
 //
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 // typedef	uint8_t  BYTE;
 // typedef	uint16_t WORD;
 // typedef	uint32_t DWORD, LBA_t, UINT;
 #include <diskio.h>
-#include "sdiodrv.h"
+#include "satadrv.h"
 
 // tx* -- debugging output functions
 // {{{
@@ -143,86 +230,604 @@ static	const int	SDMULTI = 1;
 // }}}
 // }}}
 
-#define	NEW_MUTEX
-#define	GRAB_MUTEX
-#define	RELEASE_MUTEX
-#ifndef	CLEAR_DCACHE
-#define	CLEAR_DCACHE
+// Locking
+// {{{
+// SATA_MUTEX, NEW_MUTEX(M), GRAB_MUTEX(M), RELEASE_MUTEX(M): A lock, and how
+//	to create, take, and give it back.
+// SATA_COND, NEW_COND(C), WAIT_COND(C, M), WAKE_COND(C): A condition tasks may
+//	sleep on, while giving up the lock M, and how to wake all of them.
+// These default to POSIX threads when SATA_THREADS is defined.  An RTOS
+// should define them all instead.  Without SATA_THREADS, they do nothing.
+// The lock must be recursive, since a request's callback may submit another
+// from within sata_isr().
+#ifdef	SATA_THREADS
+#ifndef	SATA_MUTEX
+#include <pthread.h>
+#define	SATA_MUTEX		pthread_mutex_t
+#define	NEW_MUTEX(M)		sata_new_mutex(&(M))
+#define	GRAB_MUTEX(M)		pthread_mutex_lock(&(M))
+#define	RELEASE_MUTEX(M)	pthread_mutex_unlock(&(M))
+#define	SATA_COND		pthread_cond_t
+#define	NEW_COND(C)		pthread_cond_init(&(C), NULL)
+#define	WAIT_COND(C, M)		pthread_cond_wait(&(C), &(M))
+#define	WAKE_COND(C)		pthread_cond_broadcast(&(C))
+
+static	void	sata_new_mutex(pthread_mutex_t *m) {
+	pthread_mutexattr_t	attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(m, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+#endif
+#else
+#define	NEW_MUTEX(M)
+#define	GRAB_MUTEX(M)
+#define	RELEASE_MUTEX(M)
+#define	NEW_COND(C)
+#define	WAIT_COND(C, M)
+#define	WAKE_COND(C)
+#endif
+
+// SATA_DISABLE_INTS(DEV), SATA_RESTORE_INTS(DEV): Mask the controller's
+//	interrupt, and unmask it again.  Wrapped around everything that
+//	touches the queue or the elevator, whenever sata_isr() is attached
+//	to the interrupt itself.  Calls don't nest.  Both do nothing by
+//	default, for a driver that only polls.
+#ifdef	SATA_THREADS
+#ifdef	SATA_DISABLE_INTS
+#error	"With SATA_THREADS, call sata_isr() from a task, not an interrupt"
+#endif
+#endif
+#ifndef	SATA_DISABLE_INTS
+#define	SATA_DISABLE_INTS(DEV)	do {} while(0)
+#define	SATA_RESTORE_INTS(DEV)	do {} while(0)
+#endif
+// }}}
+#ifndef	SATA_WAIT_INT
+#define	SATA_WAIT_INT(DEV)	sata_isr(DEV)
+#endif
+
+// DMA memory
+// {{{
+// SATA_DMA_MALLOC: Allocates memory the controller can reach, for the command
+//	rings.  Must return memory aligned to at least a word.
+// SATA_BUSADDR: The address the controller knows a pointer by.
+// Both default to the CPU's own view of memory.  The host build of this
+// driver (see bench/cpp/satahost.h) keeps its DMA memory in a simulation
+// instead.
+#ifndef	SATA_DMA_MALLOC
+#define	SATA_DMA_MALLOC(N)	malloc(N)
+#endif
+#ifndef	SATA_BUSADDR
+#define	SATA_BUSADDR(P)		((uintptr_t)(P))
+#endif
+// }}}
+
+// Data cache maintenance
+// {{{
+// SATA_DCACHE_LINE: The CPU's data cache line size, in bytes.  A power of
+//	two, no smaller than a word, and no larger than a sector.
+// SATA_DCACHE_CLEAN(P, N): Write back any dirty lines among the N bytes at
+//	P, so that the DMA may read them.
+// SATA_DCACHE_INVALIDATE(P, N): Discard any lines among the N bytes at P,
+//	so that the CPU will read what the DMA wrote there.
+// Both do nothing by default, as for a CPU without a data cache.  A CPU
+// that can only invalidate its whole cache may define CLEAR_DCACHE instead.
+#ifndef	SATA_DCACHE_LINE
+#define	SATA_DCACHE_LINE	32
+#endif
+#ifndef	SATA_DCACHE_CLEAN
+#define	SATA_DCACHE_CLEAN(P, N)
+#endif
+#ifndef	SATA_DCACHE_INVALIDATE
+#ifdef	CLEAR_DCACHE
+#define	SATA_DCACHE_INVALIDATE(P, N)	CLEAR_DCACHE
+#else
+#define	SATA_DCACHE_INVALIDATE(P, N)
+#endif
+#endif
+#if	SATA_DCACHE_LINE > 512
+#error	"SATA_DCACHE_LINE must be no larger than a sector"
+#endif
+// }}}
+
+// Request scheduling
+// {{{
+// SATA_QDEPTH: How many commands may be in the controller's queue at once.
+//	Two keeps the link busy, while leaving any further requests in the
+//	driver where they may still be merged and sorted.
+// SATA_LATENCY_BUDGET: How many commands may be dispatched ahead of a waiting
+//	request, before it is dispatched regardless of the elevator order.
+// SATA_SCATTER: Use the controller's scatter-gather mode, if it has one, so
+//	that requests may be merged even when their buffers aren't adjacent
+//	in memory.  Buffers must then be aligned to SATA_SG_ALIGN bytes, the
+//	width of the controller's DMA bus.
+#ifndef	SATA_QDEPTH
+#define	SATA_QDEPTH		2
+#endif
+#ifndef	SATA_LATENCY_BUDGET
+#define	SATA_LATENCY_BUDGET	8
+#endif
+#ifndef	SATA_SCATTER
+#define	SATA_SCATTER		1
+#endif
+#ifndef	SATA_SG_ALIGN
+#define	SATA_SG_ALIGN		4
 #endif
+// }}}
 
-static	const unsigned	SATA_DMA_WRITE = 0x00ca4027,
-			SATA_DMA_READ  = 0x00c84027;
+// Drive features
+// {{{
+// SATA_WCACHE: Turn the drive's write cache on, if it has one, and if it
+//	supports FLUSH CACHE.  Otherwise it is turned off.
+// SATA_DSM_BLOCKS: The most 512 byte blocks of ranges (64 ranges each) to
+//	send with any one DATA SET MANAGEMENT command.
+#ifndef	SATA_WCACHE
+#define	SATA_WCACHE		1
+#endif
+#ifndef	SATA_DSM_BLOCKS
+#define	SATA_DSM_BLOCKS		1
+#endif
+// }}}
+
+// Sector cache
+// {{{
+// SATA_CACHE_SECTORS: The size of the cache, in 512 byte sectors.  Zero
+//	removes the cache entirely.
+// SATA_CACHE_HASH: How many hash chains to sort cached sectors into.
+// SATA_CACHE_BYPASS: The longest transfer to go through the cache.
+// SATA_CACHE_RAMIN, SATA_CACHE_RAMAX: The first, and the largest, read
+//	ahead window, in sectors.
+#ifndef	SATA_CACHE_SECTORS
+#define	SATA_CACHE_SECTORS	0
+#endif
+#ifndef	SATA_CACHE_HASH
+#define	SATA_CACHE_HASH		64
+#endif
+#ifndef	SATA_CACHE_BYPASS
+#define	SATA_CACHE_BYPASS	(SATA_CACHE_SECTORS / 4)
+#endif
+#ifndef	SATA_CACHE_RAMIN
+#define	SATA_CACHE_RAMIN	4
+#endif
+#ifndef	SATA_CACHE_RAMAX
+#define	SATA_CACHE_RAMAX	(SATA_CACHE_SECTORS / 4)
+#endif
+// }}}
+
+// READ/WRITE DMA EXT.  These take a 48-bit LBA and a 16-bit sector count,
+// so a single command can move up to 65536 sectors (32MB).  Drives without
+// 48-bit LBA support get READ/WRITE DMA instead, with a 28-bit LBA and an
+// 8-bit count, and requests always name the EXT commands.  IDENTIFY DEVICE
+// is a PIO read of a single sector.  DATA SET MANAGEMENT, with the TRIM bit
+// set in its features, is a DMA write of a list of ranges, counted in 512
+// byte blocks.  FLUSH CACHE (EXT) and SET FEATURES move no data at all, and
+// the top eight bits of the command word hold their features.
+static	const unsigned	SATA_DMA_WRITE   = 0x00354027,
+			SATA_DMA_READ    = 0x00254027,
+			SATA_DMA_WRITE28 = 0x00ca4027,
+			SATA_DMA_READ28  = 0x00c84027,
+			SATA_IDENTIFY    = 0x00ec4027,
+			SATA_DSM_TRIM    = 0x01064027,
+			SATA_FLUSH       = 0x00e74027,
+			SATA_FLUSH_EXT   = 0x00ea4027,
+			SATA_SET_FEATURES= 0x00ef4027,
+			SATA_WCACHE_ON   = 0x02000000,
+			SATA_WCACHE_OFF  = 0x82000000,
+			SATA_LBA_MODE    = 0x40000000;
+
+// Status bits, as read back from the command register.  ICRC marks a
+// read whose data arrived with a bad CRC.  The (corrupt) data is still
+// written to the buffer, so the read must be reported as failed.
+static	const unsigned	SATA_ICRC      = 0x80000000,
+			SATA_ERR       = 0x00010000,
+			SATA_DMA_ERR   = 0x00004000;
+
+// Command queue
+// {{{
+// Each ring holds SATA_QSIZE entries, of which SATA_QSIZE-1 may be in use.
+// Every command may complete up to SATA_MAXMERGE requests, and has a
+// scatter-gather table with room for three segments from each: a head and
+// tail bounce buffer, and the caller's buffer between them.
+#define	SATA_LGQSIZE	4
+#define	SATA_QSIZE	(1u << SATA_LGQSIZE)
+#define	SATA_NREQS	32
+#define	SATA_MAXMERGE	8
+#define	SATA_MAXSEG	(3 * SATA_MAXMERGE)
+static	const unsigned	SATA_QCTRL_ENABLE = 0x80000000,
+			SATA_QISTAT_INT   = 0x80000000,
+			SATA_PHY_SGMODE   = 0x00000100,
+			SATA_SG_LAST      = 0x80000000,
+			SQ_WORDS = 8, CQ_WORDS = 4, SG_WORDS = 2;
+#define	SATA_RING_ALIGN	((SATA_DCACHE_LINE > 32) ? SATA_DCACHE_LINE : 32)
+// }}}
+
+typedef	struct	SATAREQ_S {
+	SATA_CALLBACK	r_callback;
+	void		*r_arg;
+	unsigned	r_cmd, r_sector, r_count;
+	const char	*r_buf;
+	// The first r_head and last r_tail bytes of the buffer go through
+	// r_bounce, and r_bounce + SATA_DCACHE_LINE, instead
+	char		*r_bounce;
+	unsigned	r_head, r_tail;
+	// r_issued counts the sectors dispatched to the controller so far,
+	// r_pending the dispatched commands yet to complete.  r_stamp is
+	// the number of commands dispatched before this request arrived.
+	unsigned	r_issued, r_stamp;
+	struct SATAREQ_S	*r_next;
+	// These may be changed by sata_isr(), from an interrupt context.
+	volatile unsigned	r_pending;
+	volatile int		r_status, r_inuse, r_done;
+} SATAREQ;
+
+typedef	struct	SATACMD_S {
+	unsigned	c_nreq;
+	SATAREQ		*c_req[SATA_MAXMERGE];
+} SATACMD;
+
+#if	SATA_CACHE_SECTORS > 0
+// Cache line flags.  A BUSY line has a read or write outstanding.  A VALID
+// line holds its sector's data, which is DIRTY if it's yet to be written
+// back to the drive.
+static	const unsigned	SATA_LINE_VALID = 1, SATA_LINE_DIRTY = 2,
+			SATA_LINE_BUSY  = 4;
+
+typedef	struct	SATALINE_S {
+	unsigned	l_sector;
+	volatile unsigned	l_flags;
+	// l_prev is toward the most recently used line
+	struct SATALINE_S	*l_prev, *l_next, *l_hash;
+} SATALINE;
+
+typedef	struct	SATACACHE_S {
+	// The data comes first, so that every sector is aligned for the DMA
+	char		c_data[SATA_CACHE_SECTORS][512];
+	SATALINE	c_line[SATA_CACHE_SECTORS];
+	SATALINE	*c_mru, *c_lru, *c_hash[SATA_CACHE_HASH];
+	struct SATADRV_S	*c_owner;
+	// Stream detection: where the next sequential read would start,
+	// and how far to read ahead of it
+	unsigned	c_ranext, c_rawin;
+	volatile unsigned	c_busy;
+	volatile int		c_err;
+#ifdef	SATA_THREADS
+	// Held across each cached read, write, or sync
+	SATA_MUTEX	c_lock;
+#endif
+} SATACACHE;
+
+// SATA_CACHE_POOL: the memory holding the cache.  This is a static pool,
+//	unless the environment needs it somewhere else.
+#ifndef	SATA_CACHE_POOL
+static	SATACACHE	sata_cache_pool __attribute__((aligned(SATA_DCACHE_LINE)));
+#define	SATA_CACHE_POOL		(&sata_cache_pool)
+#endif
+
+// The one cache, once claimed
+static	SATACACHE	*sata_cache = NULL;
+#define	SATA_LINE_DATA(C, L)	((C)->c_data[(L) - (C)->c_line])
+#else
+typedef	struct	SATACACHE_S	SATACACHE;
+#endif
 
 typedef	struct	SATADRV_S {
 	SATA		*d_dev;
 	uint32_t	d_sector_count, d_block_size;
+	// Chosen from the IDENTIFY DEVICE data.  Logical sector d_align is
+	// the first to start a physical sector, of (1<<d_lgphys) sectors.
+	unsigned	d_rdcmd, d_wrcmd, d_maxcount, d_lgphys, d_align;
+	int		d_lba48, d_ncq, d_wcache;
+	// FLUSH CACHE (EXT), or zero if the drive has neither.  d_trim is
+	// set if the drive supports TRIM, in which case d_dsm holds up to
+	// d_dsmblocks blocks of ranges.
+	unsigned	d_flushcmd, d_dsmblocks;
+	int		d_trim;
+	uint8_t		*d_dsm;
+	uint32_t	*d_sq, *d_cq, *d_sg;
+	unsigned	d_sqtail, d_cqhead;
+	volatile unsigned	d_inflight;	// Commands issued
+	int		d_scatter;
+	// The elevator: requests not yet entirely dispatched, oldest first
+	SATAREQ		*d_head, *d_tail;
+	unsigned	d_ncmds, d_nextlba;
+	// While plugged, requests wait in the elevator to be merged
+	int		d_plug;
+	SATACACHE	*d_cache;
+	// Depth of sata_lock() calls, so the interrupt is only unmasked by
+	// the outermost
+	unsigned	d_intlock;
+#ifdef	SATA_THREADS
+	// Held while touching anything above, or below.  While d_owner is
+	// set, some task is waiting on the controller, and no other may touch
+	// it.  d_events counts the times the owner has given it back.
+	SATA_MUTEX	d_lock;
+	SATA_COND	d_cond;
+	int		d_owner;
+	unsigned	d_events;
+	// Held while d_dsm is in use
+	SATA_MUTEX	d_trimlock;
+#endif
+	SATACMD		d_cmd[SATA_QSIZE];
+	SATAREQ		d_req[SATA_NREQS];
 } SATADRV;
 
 static	void	sata_wait_while_busy(SATADRV *dev);
-// static	int	sata_write_block(SATADRV *dev, uint32_t sector, uint32_t *buf);	  // CMD 24
-// static	int	sata_read_block(SATADRV *dev, uint32_t sector, uint32_t *buf);	  // CMD 17
+static	void	sata_yield(SATADRV *dev);
+static	unsigned sata_idword(const uint8_t *id, unsigned w);
+static	void	sata_identify(SATADRV *dev, const uint8_t *id);
+static	SATAREQ	*sata_submit(SATADRV *dev, const unsigned cmd,
+			const unsigned sector, const unsigned count,
+			const char *buf, SATA_CALLBACK cb, void *arg);
+static	int	sata_nodata(const unsigned cmd);
+static	int	sata_barrier(const unsigned cmd);
+static	int	sata_blocked(SATADRV *dev, SATAREQ *req);
+static	void	sata_unlink(SATADRV *dev, SATAREQ *req);
+static	void	sata_dispatch(SATADRV *dev);
+static	unsigned sata_sgmap(SATAREQ *req, uint32_t *sg, unsigned nseg,
+			unsigned off, unsigned len);
+static	void	sata_dmastart(SATADRV *dev, SATAREQ *req);
+static	void	sata_dmadone(SATAREQ *req);
+static	void	sata_unplug(SATADRV *dev);
+static	int	sata_io(SATADRV *dev, const unsigned cmd,
+			const unsigned sector, const unsigned count, char *buf);
+static	int	sata_trim(SATADRV *dev, unsigned sector, unsigned count);
+#if	SATA_CACHE_SECTORS > 0
+static	void	sata_cache_done(void *arg, int status);
+static	void	sata_cache_wait(SATADRV *dev);
+static	SATALINE *sata_cache_lookup(SATACACHE *c, unsigned sector);
+static	void	sata_cache_touch(SATACACHE *c, SATALINE *line);
+static	void	sata_cache_unhash(SATACACHE *c, SATALINE *line);
+static	SATALINE *sata_cache_alloc(SATADRV *dev, unsigned sector, int ahead);
+static	int	sata_cache_issue(SATADRV *dev, SATALINE *line,
+			const unsigned cmd);
+static	int	sata_cache_flush(SATADRV *dev);
+static	int	sata_cache_sync(SATADRV *dev, const unsigned sector,
+			const unsigned count, int drop);
+static	int	sata_cache_read(SATADRV *dev, const unsigned sector,
+			const unsigned count, char *buf);
+static	int	sata_cache_write(SATADRV *dev, const unsigned sector,
+			const unsigned count, const char *buf);
+#endif
 
-extern	SATADRV *sata_init(SDIO *dev);
+extern	SATADRV *sata_init(SATA *dev);
 extern	int	sata_write(SATADRV *dev, const unsigned sector, const unsigned count, const char *buf);
 extern	int	sata_read(SATADRV *dev, const unsigned sector, const unsigned count, char *buf);
 extern	int	sata_ioctl(SATADRV *dev, char cmd, char *buf);
+extern	SATAREQ	*sata_submit_write(SATADRV *dev, const unsigned sector, const unsigned count, const char *buf, SATA_CALLBACK cb, void *arg);
+extern	SATAREQ	*sata_submit_read(SATADRV *dev, const unsigned sector, const unsigned count, char *buf, SATA_CALLBACK cb, void *arg);
+extern	int	sata_wait(SATADRV *dev, SATAREQ *req);
+extern	void	sata_isr(SATADRV *dev);
+extern	void	sata_lock(SATADRV *dev);
+extern	void	sata_unlock(SATADRV *dev);
+
 
+void	sata_lock(SATADRV *dev) {
+	// {{{
+	// Enter the driver's critical section: keep other tasks out, and
+	// sata_isr() as well, should it be attached to the interrupt
+	GRAB_MUTEX(dev->d_lock);
+	if (0 == dev->d_intlock++)
+		SATA_DISABLE_INTS(dev);
+}
+// }}}
+
+void	sata_unlock(SATADRV *dev) {
+	// {{{
+	if (0 == --dev->d_intlock)
+		SATA_RESTORE_INTS(dev);
+	RELEASE_MUTEX(dev->d_lock);
+}
+// }}}
 
 void	sata_wait_while_busy(SATADRV *dev) {
 	// {{{
 
-	// Could also do a system call and yield to the scheduler while waiting
-	// if (SDIO_OS) {
-	//	os_wait(dev->d_int);
-	// } else if (SDIO_INT) {
-	//	// Can wait for an interrupt here, such as by calling an
-	//	// external wait_int function with our interrupt ID.
-	//	wait_int(dev->d_int);
-	// } else {
+	// Wait for every request to complete.  SATA_WAIT_INT may wait for an
+	// interrupt, or yield to the scheduler, rather than poll.
+	sata_unplug(dev);
+	while(dev->d_head != NULL || dev->d_inflight > 0)
+		sata_yield(dev);
+}
+// }}}
 
-	// Busy wait implementation
-	uint32_t	st;
+void	sata_yield(SATADRV *dev) {
+	// {{{
+	// Wait for something to change: a request to complete, or, with
+	// SATA_THREADS, another task to take its turn with the controller.
+#ifdef	SATA_THREADS
+	unsigned	seen;
 
-	st = dev->d_dev->sd_cmd;
-	while(st & SDIO_BUSY)
-		st = dev->d_dev->sd_cmd;
+	sata_lock(dev);
+	if (dev->d_owner) {
+		// Another task is waiting on the controller.  Sleep until it's
+		// done, and whatever it reaped may be ours.
+		seen = dev->d_events;
+		while(seen == dev->d_events)
+			WAIT_COND(dev->d_cond, dev->d_lock);
+		sata_unlock(dev);
+		return;
+	}
+
+	sata_dispatch(dev);
+	if (0 == dev->d_inflight) {
+		// Nothing to wait on.  Some other task has the elevator
+		// plugged, or has yet to collect its requests.
+		sata_unlock(dev);
+		return;
+	}
 
-	// }
+	// Take the controller over until its next interrupt
+	dev->d_owner = 1;
+	sata_unlock(dev);
+
+	SATA_WAIT_INT(dev);
+
+	// Then issue whatever was queued meanwhile, and wake everyone else
+	sata_lock(dev);
+	dev->d_owner = 0;
+	dev->d_events++;
+	sata_dispatch(dev);
+	WAKE_COND(dev->d_cond);
+	sata_unlock(dev);
+#else
+	SATA_WAIT_INT(dev);
+#endif
 }
 // }}}
 
-SATADRV *sata_init(SDIO *dev) {
+SATADRV *sata_init(SATA *dev) {
 	// {{{
-	unsigned	ifcond, op_cond, hcs;
 	SATADRV	*dv = (SATADRV *)malloc(sizeof(SATADRV));
-	unsigned op_cond_query;
-	unsigned	clk_phase = 16 << 16;
+	SATAREQ	*req;
+	char	*rings, *bounce;
+	uint8_t	*ident;
 
 	// Check for memory allocation failure.
 	if (NULL == dv) {
-		txstr("PANIC:  No memory for SDIO driver!\n");
+		txstr("PANIC:  No memory for SATA driver!\n");
 		// PANIC;
 		return NULL;
 	}
 
+	// The bounce buffers, a sector for the IDENTIFY DEVICE data, the
+	// DATA SET MANAGEMENT ranges, both rings, and the scatter-gather
+	// tables, aligned to a cache line (or a submission entry, 32 bytes,
+	// if larger).  This memory is never freed.
+	rings = (char *)SATA_DMA_MALLOC(SATA_QSIZE * (SQ_WORDS + CQ_WORDS
+				+ SATA_MAXSEG * SG_WORDS) * sizeof(uint32_t)
+				+ 512 + SATA_DSM_BLOCKS * 512
+				+ SATA_NREQS * 2 * SATA_DCACHE_LINE
+				+ SATA_RING_ALIGN - 1);
+	if (NULL == rings) {
+		txstr("PANIC:  No memory for SATA command rings!\n");
+		free(dv);
+		return NULL;
+	}
+
 	dv->d_dev = dev;
 	dv->d_sector_count = 0;
-	dv->d_block_size   = 0;
+	dv->d_block_size   = 512;
+	dv->d_rdcmd    = SATA_DMA_READ;
+	dv->d_wrcmd    = SATA_DMA_WRITE;
+	dv->d_maxcount = 65536;
+	dv->d_lgphys   = 0;
+	dv->d_align    = 0;
+	dv->d_lba48    = 1;
+	dv->d_ncq      = 0;
+	dv->d_wcache   = 0;
+	dv->d_flushcmd = 0;
+	dv->d_dsmblocks= 0;
+	dv->d_trim     = 0;
+	bounce = (char *)(((uintptr_t)rings + SATA_RING_ALIGN - 1)
+					& ~(uintptr_t)(SATA_RING_ALIGN - 1));
+	ident = (uint8_t *)(bounce + SATA_NREQS * 2 * SATA_DCACHE_LINE);
+	dv->d_dsm = ident + 512;
+	dv->d_sq = (uint32_t *)(dv->d_dsm + SATA_DSM_BLOCKS * 512);
+	dv->d_cq = dv->d_sq + SATA_QSIZE * SQ_WORDS;
+	dv->d_sg = dv->d_cq + SATA_QSIZE * CQ_WORDS;
+	dv->d_sqtail   = 0;
+	dv->d_cqhead   = 0;
+	dv->d_inflight = 0;
+	dv->d_head = dv->d_tail = NULL;
+	dv->d_ncmds    = 0;
+	dv->d_nextlba  = 0;
+	dv->d_plug     = 0;
+	dv->d_cache    = NULL;
+	dv->d_intlock  = 0;
+#ifdef	SATA_THREADS
+	NEW_MUTEX(dv->d_lock);
+	NEW_COND(dv->d_cond);
+	dv->d_owner    = 0;
+	dv->d_events   = 0;
+	NEW_MUTEX(dv->d_trimlock);
+#endif
+	for(unsigned k=0; k<SATA_NREQS; k++) {
+		dv->d_req[k].r_inuse = 0;
+		dv->d_req[k].r_done  = 0;
+		dv->d_req[k].r_bounce = bounce + k * 2 * SATA_DCACHE_LINE;
+	}
 
 	SET_SCOPE;
 
-	// NEW_MUTEX;
-	// GRAB_MUTEX;
+	// Scatter-gather mode applies to every command, including those from
+	// the queue.  Controllers without it read the mode bit back as zero.
+	dev->s_phy = (SATA_SCATTER) ? SATA_PHY_SGMODE : 0;
+	dv->d_scatter = (dev->s_phy & SATA_PHY_SGMODE) ? 1 : 0;
+
+	// Enable the command queue.  This also resets its ring indexes.
+	// With no interrupt moderation, the interrupt is held high so long
+	// as any completion is waiting.
+	dev->s_sqbase = (void *)dv->d_sq;
+	dev->s_cqbase = (void *)dv->d_cq;
+	dev->s_qintr  = 0;
+	dev->s_qctrl  = SATA_QCTRL_ENABLE | SATA_LGQSIZE;
+
+	// Ask the drive what it can do.  Should it fail to answer, we stay
+	// with READ/WRITE DMA EXT, and an unknown capacity.
+	req = sata_submit(dv, SATA_IDENTIFY, 0, 1, (const char *)ident,
+							NULL, NULL);
+	if (req != NULL && RES_OK == sata_wait(dv, req))
+		sata_identify(dv, ident);
+	else
+		txstr("SATA: IDENTIFY DEVICE failed\n");
+
+	// A volatile write cache is only safe to use if it can be flushed
+	if (dv->d_wcache) {
+		const int	on = (SATA_WCACHE && dv->d_flushcmd != 0);
+
+		if (RES_OK == sata_io(dv, SATA_SET_FEATURES | ((on)
+				? SATA_WCACHE_ON : SATA_WCACHE_OFF), 0, 0, NULL))
+			dv->d_wcache = (on) ? 2 : 1;
+		else
+			txstr("SATA: SET FEATURES failed\n");
+	}
+
+#if	SATA_CACHE_SECTORS > 0
+	// There's only the one cache.  The first device to claim it keeps it.
+	if (NULL == sata_cache) {
+		SATACACHE	*c = SATA_CACHE_POOL;
 
-	// Any initialization we need ...
-	//   For example, we need to get the sector count here
+		c->c_owner = dv;
+		c->c_mru = c->c_lru = NULL;
+		for(unsigned k=0; k<SATA_CACHE_HASH; k++)
+			c->c_hash[k] = NULL;
+		for(unsigned k=0; k<SATA_CACHE_SECTORS; k++) {
+			SATALINE	*line = &c->c_line[k];
 
-	// RELEASE_MUTEX;
+			line->l_flags = 0;
+			line->l_hash  = NULL;
+			line->l_prev  = c->c_lru;
+			line->l_next  = NULL;
+			if (c->c_lru)
+				c->c_lru->l_next = line;
+			else
+				c->c_mru = line;
+			c->c_lru = line;
+		}
+		c->c_ranext = 0;
+		c->c_rawin  = 0;
+		c->c_busy   = 0;
+		c->c_err    = 0;
+		NEW_MUTEX(c->c_lock);
+		dv->d_cache = c;
+		sata_cache  = c;
+	}
+#endif
 
 	if (SDEBUG) {
 		txstr("Block size:   ");
 		txdecimal(dv->d_block_size);
 		txstr("\nSector count: "); txdecimal(dv->d_sector_count);
+		txstr("\nAlignment:    "); txdecimal(dv->d_align);
+		txstr("\nLBA48:        "); txdecimal(dv->d_lba48);
+		txstr("\nMax count:    "); txdecimal(dv->d_maxcount);
+		txstr("\nNCQ depth:    "); txdecimal(dv->d_ncq);
+		txstr("\nWrite cache:  "); txdecimal(dv->d_wcache);
+		txstr("\nTRIM:         "); txdecimal(dv->d_trim);
+		txstr("\nScatter:      "); txdecimal(dv->d_scatter);
 		txstr("\n");
 	}
 
@@ -230,115 +835,1107 @@ SATADRV *sata_init(SDIO *dev) {
 }
 // }}}
 
-int	sata_write(SATADRV *dev, const unsigned sector,
-			const unsigned count, const char *buf) {
+unsigned sata_idword(const uint8_t *id, unsigned w) {
 	// {{{
-	unsigned	dev_stat, err = 0;
+	// IDENTIFY DEVICE data is 256 16-bit words, each sent least
+	// significant byte first.  A controller built with OPT_LITTLE_ENDIAN
+	// keeps the bytes in memory in the order they arrive, so this works
+	// regardless of the CPU's byte order.
+	return	id[2*w] | (id[2*w+1] << 8);
+}
+// }}}
 
-	if (0 == count)
-		return	RES_OK;
+void	sata_identify(SATADRV *dev, const uint8_t *id) {
+	// {{{
+	uint64_t	capacity;
+	unsigned	w;
+
+	// Command set, and capacity.  Word 83, bit 10: 48-bit LBAs.
+	dev->d_lba48 = (sata_idword(id, 83) & 0x0400) ? 1 : 0;
+	if (dev->d_lba48) {
+		capacity = sata_idword(id, 100)
+			| ((uint64_t)sata_idword(id, 101) << 16)
+			| ((uint64_t)sata_idword(id, 102) << 32)
+			| ((uint64_t)sata_idword(id, 103) << 48);
+		dev->d_rdcmd    = SATA_DMA_READ;
+		dev->d_wrcmd    = SATA_DMA_WRITE;
+		dev->d_maxcount = 65536;
+	} else {
+		capacity = sata_idword(id, 60)
+			| ((uint64_t)sata_idword(id, 61) << 16);
+		dev->d_rdcmd    = SATA_DMA_READ28;
+		dev->d_wrcmd    = SATA_DMA_WRITE28;
+		dev->d_maxcount = 256;
+	}
+
+	// Sector numbers are only 32 bits within this driver
+	dev->d_sector_count = (capacity > 0xffffffffu)
+				? 0xffffffffu : (uint32_t)capacity;
+
+	// Physical sectors.  Word 106 is valid if bits [15:14] are 2'b01.
+	// Bit 13 then says there's more than one logical sector per physical
+	// one, and bits [3:0] give the log_2 of how many.  Word 209 gives the
+	// offset of logical sector zero within its physical sector.
+	w = sata_idword(id, 106);
+	if ((w & 0xc000) == 0x4000 && (w & 0x2000))
+		dev->d_lgphys = w & 0x0f;
+	w = sata_idword(id, 209);
+	if ((w & 0xc000) == 0x4000 && dev->d_lgphys > 0) {
+		unsigned	phys = 1u << dev->d_lgphys;
+
+		dev->d_align = (phys - (w & (phys-1))) & (phys-1);
+	}
+	dev->d_block_size = 512u << dev->d_lgphys;
+
+	// NCQ.  Word 76, bit 8: supported.  Word 75, bits [4:0]: queue depth
+	// less one.  The controller has no FPDMA QUEUED path, so this is for
+	// information only.
+	if (sata_idword(id, 76) & 0x0100)
+		dev->d_ncq = (sata_idword(id, 75) & 0x1f) + 1;
+
+	// Volatile write cache.  Word 82, bit 5: supported, word 85, bit 5:
+	// enabled.  d_wcache is one if the drive has one, two if it's on.
+	if (sata_idword(id, 82) & 0x0020)
+		dev->d_wcache = (sata_idword(id, 85) & 0x0020) ? 2 : 1;
+
+	// FLUSH CACHE.  Word 83, bit 12: supported, bit 13: FLUSH CACHE EXT
+	// supported as well.
+	w = sata_idword(id, 83);
+	if (dev->d_lba48 && (w & 0x2000))
+		dev->d_flushcmd = SATA_FLUSH_EXT;
+	else if (w & 0x1000)
+		dev->d_flushcmd = SATA_FLUSH;
+
+	// TRIM.  Word 169, bit 0: DATA SET MANAGEMENT supports TRIM.  Word
+	// 105: the most blocks of ranges one command may carry, or zero if
+	// the drive doesn't say, in which case it's one.  DSM takes 48-bit
+	// LBAs only.
+	if (dev->d_lba48 && (sata_idword(id, 169) & 0x0001)) {
+		w = sata_idword(id, 105);
+		dev->d_trim = 1;
+		dev->d_dsmblocks = (0 == w) ? 1
+				: (w < SATA_DSM_BLOCKS) ? w : SATA_DSM_BLOCKS;
+	}
+}
+// }}}
+
+int	sata_nodata(const unsigned cmd) {
+	// {{{
+	// FLUSH CACHE (EXT) and SET FEATURES are submitted with no sectors
+	const unsigned	op = (cmd >> 16) & 0x0ff;
+
+	return	(0xe7 == op || 0xea == op || 0xef == op);
+}
+// }}}
+
+int	sata_barrier(const unsigned cmd) {
+	// {{{
+	// Anything other than a read or a write, such as a FLUSH or a TRIM,
+	// is kept in order with every request around it.  Its sector and
+	// count don't say which sectors it acts upon.
+	return	(SATA_DMA_READ != cmd && SATA_DMA_WRITE != cmd);
+}
+// }}}
+
+int	sata_blocked(SATADRV *dev, SATAREQ *req) {
+	// {{{
+	// A request may not pass any older request it overlaps, unless both
+	// are reads, nor may it pass, or be passed by, a barrier
+	unsigned	start = req->r_sector + req->r_issued,
+			end   = req->r_sector + req->r_count;
+
+	for(SATAREQ *old = dev->d_head; old != req; old = old->r_next) {
+		unsigned	ostart = old->r_sector + old->r_issued,
+				oend   = old->r_sector + old->r_count;
+
+		if (sata_barrier(old->r_cmd) || sata_barrier(req->r_cmd))
+			return 1;
+		if (old->r_cmd == SATA_DMA_READ && req->r_cmd == SATA_DMA_READ)
+			continue;
+		if (ostart < end && start < oend)
+			return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+void	sata_dispatch(SATADRV *dev) {
+	// {{{
+	// Called with the mutex held.  Moves requests from the elevator into
+	// the controller's queue, merging those that are LBA contiguous.
+#ifdef	SATA_THREADS
+	// While another task owns the controller, requests wait here, to be
+	// merged once it's done
+	if (dev->d_owner)
+		return;
+#endif
+	while(!dev->d_plug && dev->d_head != NULL
+					&& dev->d_inflight < SATA_QDEPTH) {
+		unsigned	slot = dev->d_sqtail, nsectors, lba, end;
+		SATACMD		*cmd = &dev->d_cmd[slot];
+		uint32_t	*sqe = &dev->d_sq[slot * SQ_WORDS],
+				*sg  = &dev->d_sg[slot * SATA_MAXSEG * SG_WORDS];
+		SATAREQ		*req = NULL, *wrap = NULL;
+		const char	*base, *bufend;
+		unsigned	nseg;
+		uint64_t	addr;
+
+		// Pick the next request
+		// {{{
+		if (dev->d_ncmds - dev->d_head->r_stamp >= SATA_LATENCY_BUDGET) {
+			// The oldest request has waited long enough
+			req = dev->d_head;
+		} else {
+			// One way elevator: the lowest LBA at or above the end
+			// of the last command, else the lowest LBA of all.  The
+			// oldest request is never blocked, so wrap is never
+			// NULL.
+			for(SATAREQ *r = dev->d_head; r; r = r->r_next) {
+				unsigned	lba = r->r_sector + r->r_issued;
+
+				if (sata_blocked(dev, r))
+					continue;
+				if (lba >= dev->d_nextlba && (req == NULL
+					|| lba < req->r_sector + req->r_issued))
+					req = r;
+				if (wrap == NULL
+					|| lba < wrap->r_sector + wrap->r_issued)
+					wrap = r;
+			} if (req == NULL)
+				req = wrap;
+		}
+		// }}}
+
+		// Start the command with as much of this request as will fit
+		// {{{
+		lba = req->r_sector + req->r_issued;
+		nsectors = req->r_count - req->r_issued;
+		if (nsectors > dev->d_maxcount) {
+			// Split long requests on a physical sector boundary,
+			// so the next command starts aligned
+			unsigned	trim = (lba + dev->d_maxcount
+					- dev->d_align)
+					& ((1u << dev->d_lgphys) - 1);
+
+			nsectors = dev->d_maxcount;
+			if (trim < nsectors)
+				nsectors -= trim;
+		}
+
+		base   = req->r_buf + req->r_issued * 512;
+		bufend = base + nsectors * 512;
+		end    = lba + nsectors;
+
+		if (SATA_DMA_READ == req->r_cmd)
+			sqe[0] = dev->d_rdcmd;
+		else if (SATA_DMA_WRITE == req->r_cmd)
+			sqe[0] = dev->d_wrcmd;
+		else
+			sqe[0] = req->r_cmd;
+
+		if (dev->d_lba48) {
+			sqe[1] = SATA_LBA_MODE | (lba & 0x0ffffff);
+			sqe[2] = lba >> 24;
+		} else {
+			// LBA[27:24] go in the device register
+			sqe[1] = SATA_LBA_MODE | (lba & 0x0fffffff);
+			sqe[2] = 0;
+		}
+
+		nseg = sata_sgmap(req, sg, 0, req->r_issued * 512,
+							nsectors * 512);
+
+		cmd->c_nreq   = 1;
+		cmd->c_req[0] = req;
+		req->r_issued += nsectors;
+		req->r_pending++;
+		// }}}
+
+		// Merge any requests that continue where this one ends
+		// {{{
+		while(req->r_issued == req->r_count
+				&& cmd->c_nreq < SATA_MAXMERGE) {
+			SATAREQ	*nxt = NULL;
+
+			sata_unlink(dev, req);
+
+			for(SATAREQ *r = dev->d_head; r; r = r->r_next) {
+				if (r->r_issued != 0 || r->r_cmd != req->r_cmd
+						|| r->r_sector != end
+						|| r->r_count > dev->d_maxcount
+								- nsectors)
+					continue;
+				// Without scatter-gather, the buffers must
+				// also be adjacent
+				if (!dev->d_scatter && r->r_buf != bufend)
+					continue;
+				if (sata_blocked(dev, r))
+					continue;
+				nxt = r;
+				break;
+			} if (NULL == nxt)
+				break;
+
+			nseg = sata_sgmap(nxt, sg, nseg, 0, nxt->r_count * 512);
+
+			nsectors += nxt->r_count;
+			end      += nxt->r_count;
+			bufend    = nxt->r_buf + nxt->r_count * 512;
+			cmd->c_req[cmd->c_nreq++] = nxt;
+			nxt->r_issued = nxt->r_count;
+			nxt->r_pending++;
+			req = nxt;
+		} if (req->r_issued == req->r_count)
+			sata_unlink(dev, req);
+		// }}}
+
+		// Issue the command
+		// {{{
+		if (0 == nseg) {
+			// Nothing to transfer
+			addr = 0;
+		} else if (dev->d_scatter) {
+			sg[nseg * SG_WORDS - 1] |= SATA_SG_LAST;
+			addr = SATA_BUSADDR(sg);
+			SATA_DCACHE_CLEAN(sg, nseg * SG_WORDS * sizeof(uint32_t));
+		} else
+			addr = SATA_BUSADDR(base);
+
+		// A count of zero requests the maximum: 65536 sectors, or 256
+		sqe[3] = nsectors & (dev->d_maxcount - 1);
+		sqe[4] = (uint32_t)addr;
+		sqe[5] = (uint32_t)(addr >> 32);
+		sqe[6] = slot;	// Returned in the completion
+		sqe[7] = 0;
+		SATA_DCACHE_CLEAN(sqe, SQ_WORDS * sizeof(uint32_t));
+
+		dev->d_sqtail = (dev->d_sqtail + 1) & (SATA_QSIZE-1);
+		dev->d_inflight++;
+		dev->d_ncmds++;
+		if (!sata_barrier(req->r_cmd))
+			dev->d_nextlba = end;
+
+		// Here's the *go* command
+		dev->d_dev->s_sqdoorbell = dev->d_sqtail;
+		// }}}
+	}
+}
+// }}}
+
+void	sata_unlink(SATADRV *dev, SATAREQ *req) {
+	// {{{
+	// Remove a request from the elevator, once it's been fully dispatched
+	SATAREQ	*prev = NULL;
+
+	for(SATAREQ *r = dev->d_head; r; prev = r, r = r->r_next) {
+		if (r != req)
+			continue;
+		if (prev)
+			prev->r_next = r->r_next;
+		else
+			dev->d_head  = r->r_next;
+		if (dev->d_tail == r)
+			dev->d_tail = prev;
+		r->r_next = NULL;
+		return;
+	}
+}
+// }}}
+
+unsigned sata_sgmap(SATAREQ *req, uint32_t *sg, unsigned nseg,
+			unsigned off, unsigned len) {
+	// {{{
+	// Add bytes [off, off+len) of a request to a scatter-gather table of
+	// nseg segments, and return the new number of segments.  Each piece
+	// comes from the head bounce buffer, the caller's buffer, or the tail
+	// bounce buffer, and continues the last segment if it can.
+	const unsigned	bytes = req->r_count * 512,
+			mid   = bytes - req->r_tail;
+
+	while(len > 0) {
+		const char	*ptr;
+		unsigned	n;
+		uint32_t	addr;
+
+		if (off < req->r_head) {
+			ptr = req->r_bounce + off;
+			n   = req->r_head - off;
+		} else if (off < mid) {
+			ptr = req->r_buf + off;
+			n   = mid - off;
+		} else {
+			ptr = req->r_bounce + SATA_DCACHE_LINE + (off - mid);
+			n   = bytes - off;
+		} if (n > len)
+			n = len;
+
+		addr = (uint32_t)SATA_BUSADDR(ptr);
+		if (nseg > 0 && sg[(nseg-1) * SG_WORDS]
+				+ sg[(nseg-1) * SG_WORDS + 1] == addr)
+			sg[(nseg-1) * SG_WORDS + 1] += n;
+		else {
+			sg[nseg * SG_WORDS]   = addr;
+			sg[nseg * SG_WORDS+1] = n;
+			nseg++;
+		}
+
+		off += n;
+		len -= n;
+	}
+
+	return	nseg;
+}
+// }}}
+
+void	sata_dmastart(SATADRV *dev, SATAREQ *req) {
+	// {{{
+	// Get a request's buffer ready for the DMA.  In scatter-gather mode,
+	// any partial cache line at either end goes through a bounce buffer.
+	const unsigned	bytes = req->r_count * 512;
+	unsigned	mid;
+
+	if (0 == bytes) {
+		req->r_head = req->r_tail = 0;
+		return;
+	}
+
+	if (dev->d_scatter) {
+		req->r_head = (SATA_DCACHE_LINE - ((uintptr_t)req->r_buf
+				& (SATA_DCACHE_LINE-1))) & (SATA_DCACHE_LINE-1);
+		req->r_tail = ((uintptr_t)req->r_buf + bytes)
+				& (SATA_DCACHE_LINE-1);
+	} else
+		req->r_head = req->r_tail = 0;
+	mid = bytes - req->r_tail;
+
+	if (SATA_DMA_WRITE == req->r_cmd || SATA_DSM_TRIM == req->r_cmd) {
+		if (req->r_head || req->r_tail) {
+			memcpy(req->r_bounce, req->r_buf, req->r_head);
+			memcpy(req->r_bounce + SATA_DCACHE_LINE,
+					req->r_buf + mid, req->r_tail);
+			SATA_DCACHE_CLEAN(req->r_bounce, 2 * SATA_DCACHE_LINE);
+		}
+		SATA_DCACHE_CLEAN(req->r_buf + req->r_head, mid - req->r_head);
+	} else if (dev->d_scatter) {
+		// Whole lines, every one of them about to be overwritten
+		SATA_DCACHE_INVALIDATE(req->r_buf + req->r_head,
+							mid - req->r_head);
+	} else {
+		// The lines at either end may hold someone else's data too
+		SATA_DCACHE_CLEAN(req->r_buf, bytes);
+	}
+}
+// }}}
+
+void	sata_dmadone(SATAREQ *req) {
+	// {{{
+	// Once a read completes, drop any lines the CPU may have fetched from
+	// the buffer meanwhile, and copy the ends out of the bounce buffers
+	const unsigned	mid = req->r_count * 512 - req->r_tail;
+
+	if (SATA_DMA_WRITE == req->r_cmd || SATA_DSM_TRIM == req->r_cmd
+			|| 0 == req->r_count)
+		return;
+
+	SATA_DCACHE_INVALIDATE(req->r_buf + req->r_head, mid - req->r_head);
+	if (req->r_head || req->r_tail) {
+		SATA_DCACHE_INVALIDATE(req->r_bounce, 2 * SATA_DCACHE_LINE);
+		memcpy((char *)req->r_buf, req->r_bounce, req->r_head);
+		memcpy((char *)req->r_buf + mid,
+				req->r_bounce + SATA_DCACHE_LINE, req->r_tail);
+	}
+}
+// }}}
+
+void	sata_unplug(SATADRV *dev) {
+	// {{{
+	sata_lock(dev);
+	dev->d_plug = 0;
+	sata_dispatch(dev);
+	sata_unlock(dev);
+}
+// }}}
 
+SATAREQ	*sata_submit(SATADRV *dev, const unsigned cmd, const unsigned sector,
+			const unsigned count, const char *buf,
+			SATA_CALLBACK cb, void *arg) {
+	// {{{
+	SATAREQ		*req = NULL;
+
+	// Requests that could never start aren't worth retrying
+	if (0 == count && !sata_nodata(cmd))
+		return SATA_INVALID;
+	if (dev->d_sector_count != 0 && (sector >= dev->d_sector_count
+			|| count > dev->d_sector_count - sector))
+		return SATA_INVALID;
+	if (dev->d_scatter && ((uintptr_t)buf & (SATA_SG_ALIGN-1)))
+		return SATA_INVALID;
+
+	sata_lock(dev);
+
+	for(unsigned id=0; id<SATA_NREQS; id++) {
+		if (!dev->d_req[id].r_inuse) {
+			req = &dev->d_req[id];
+			break;
+		}
+	} if (NULL == req) {
+		sata_unlock(dev);
+		return NULL;
+	}
+
+	req->r_callback = cb;
+	req->r_arg      = arg;
+	req->r_cmd      = cmd;
+	req->r_sector   = sector;
+	req->r_count    = count;
+	req->r_buf      = buf;
+	req->r_issued   = 0;
+	req->r_pending  = 0;
+	req->r_stamp    = dev->d_ncmds;
+	req->r_next     = NULL;
+	req->r_status   = RES_OK;
+	req->r_done     = 0;
+	req->r_inuse    = 1;
+	sata_dmastart(dev, req);
+
+	// Add it to the elevator, and dispatch whatever we can
+	if (dev->d_tail)
+		dev->d_tail->r_next = req;
+	else
+		dev->d_head = req;
+	dev->d_tail = req;
+
+	sata_dispatch(dev);
+
+	sata_unlock(dev);
+
+	return	req;
+}
+// }}}
+
+SATAREQ	*sata_submit_write(SATADRV *dev, const unsigned sector,
+			const unsigned count, const char *buf,
+			SATA_CALLBACK cb, void *arg) {
+	// {{{
 	if (SDEBUG) {
 		// {{{
-		txstr("SATA-WRITE(MNY): ");
+		txstr("SATA-SUBMIT-WRITE: ");
+		txhex(sector);
+		txstr(", ");
+		txhex(count);
+		txstr(", ");
+		txhex((unsigned)(uintptr_t)buf);
+		txstr("\n");
+	}
+	// }}}
+
+	return	sata_submit(dev, SATA_DMA_WRITE, sector, count, buf, cb, arg);
+}
+// }}}
+
+SATAREQ	*sata_submit_read(SATADRV *dev, const unsigned sector,
+			const unsigned count, char *buf,
+			SATA_CALLBACK cb, void *arg) {
+	// {{{
+	if (SDEBUG) {
+		// {{{
+		txstr("SATA-SUBMIT-READ: ");
 		txhex(sector);
 		txstr(", ");
 		txhex(count);
 		txstr(", ");
-		txhex(buf);
+		txhex((unsigned)(uintptr_t)buf);
 		txstr("\n");
 	}
 	// }}}
 
-	GRAB_MUTEX;
+	return	sata_submit(dev, SATA_DMA_READ, sector, count, buf, cb, arg);
+}
+// }}}
+
+void	sata_isr(SATADRV *dev) {
+	// {{{
+	unsigned	tail;
+
+	sata_lock(dev);
+
+	// Acknowledge the interrupt first, so that any completion arriving
+	// after the ring has been read will raise it again.
+	dev->d_dev->s_qistat = SATA_QISTAT_INT;
+
+	while((tail = (dev->d_dev->s_cqdoorbell >> 16) & (SATA_QSIZE-1))
+							!= dev->d_cqhead) {
+		while(dev->d_cqhead != tail) {
+			const uint32_t	*cqe = &dev->d_cq[dev->d_cqhead * CQ_WORDS];
+			SATACMD		*cmd;
+			int		failed;
+
+			// Written by the DMA, behind the cache's back
+			SATA_DCACHE_INVALIDATE(cqe, CQ_WORDS * sizeof(uint32_t));
+			cmd = &dev->d_cmd[cqe[0] & (SATA_QSIZE-1)];
+
+			failed = (cqe[1] & (SATA_ICRC | SATA_ERR | SATA_DMA_ERR))
+					? 1 : 0;
+			dev->d_cqhead = (dev->d_cqhead + 1) & (SATA_QSIZE-1);
+			dev->d_inflight--;
 
-	dev->d_dev->s_count = count;	// Number of sectors
-	dev->d_dev->s_dma   = buf;	// Address to source the data from
-	dev->d_dev->s_lbalo = sector & 0x0ffffff;
-	dev->d_dev->s_lbahi = 0;
+			// A merged command completes every request within it
+			for(unsigned k=0; k<cmd->c_nreq; k++) {
+				SATAREQ	*req = cmd->c_req[k];
 
-	// Here's the *go* command
-	dev->d_dev->s_cmd   = SATA_DMA_WRITE | ((sector >> 16) & 0x0f00);
+				if (failed && req->r_issued != req->r_count) {
+					// Don't issue the rest of a request
+					// that's already failed
+					sata_unlink(dev, req);
+					req->r_issued = req->r_count;
+				}
+				if (failed)
+					req->r_status = RES_ERROR;
 
-	sata_wait_while_busy(dev);
+				if (--req->r_pending != 0
+						|| req->r_issued != req->r_count)
+					continue;
 
-	dev_stat  = dev->d_dev->s_cmd;
+				if (req->r_status != RES_OK) {
+					TRIGGER_SCOPE;
+				}
+				sata_dmadone(req);
 
-	RELEASE_MUTEX;
+				if (req->r_callback) {
+					// Release the handle first, so the
+					// callback may submit another request
+					req->r_inuse = 0;
+					(*req->r_callback)(req->r_arg,
+							req->r_status);
+				} else
+					req->r_done = 1;
+			}
+		}
 
-	// Error handling
+		// Tell the queue these completions have been consumed
+		dev->d_dev->s_cqdoorbell = dev->d_cqhead;
+	}
+
+	// Refill the controller's queue from the elevator
+	sata_dispatch(dev);
+
+	sata_unlock(dev);
+}
+// }}}
+
+int	sata_wait(SATADRV *dev, SATAREQ *req) {
 	// {{{
-	if (err) {
-		// If we had any write failures along the way, return
-		// an error status.
+	int	status;
+
+	if (SATA_INVALID == req)
+		return	RES_PARERR;
 
-		// Immediately trigger the scope (if not already triggered)
-		// to avoid potentially losing any more data.
-		TRIGGER_SCOPE;
+	while(!req->r_done)
+		sata_yield(dev);
+
+	sata_lock(dev);
+	status = req->r_status;
+	req->r_done  = 0;
+	req->r_inuse = 0;
+	sata_unlock(dev);
+
+	return	status;
+}
+// }}}
+
+#if	SATA_CACHE_SECTORS > 0
+void	sata_cache_done(void *arg, int status) {
+	// {{{
+	// Called from sata_isr() as each cache line's read or write completes
+	SATALINE	*line = (SATALINE *)arg;
+
+	if (line->l_flags & SATA_LINE_VALID) {
+		// A write back
+		if (RES_OK == status)
+			line->l_flags &= ~SATA_LINE_DIRTY;
+		else
+			sata_cache->c_err = 1;
+	} else if (RES_OK == status)
+		line->l_flags |= SATA_LINE_VALID;
+
+	line->l_flags &= ~SATA_LINE_BUSY;
+	sata_cache->c_busy--;
+}
+// }}}
+
+void	sata_cache_wait(SATADRV *dev) {
+	// {{{
+	// Let any plugged requests go before waiting on them, then plug the
+	// queue again if it was
+	int	plug = dev->d_plug;
+
+	sata_unplug(dev);
+	sata_yield(dev);
+	dev->d_plug = plug;
+}
+// }}}
+
+SATALINE *sata_cache_lookup(SATACACHE *c, unsigned sector) {
+	// {{{
+	SATALINE	*line = c->c_hash[sector % SATA_CACHE_HASH];
+
+	while(line != NULL && line->l_sector != sector)
+		line = line->l_hash;
+
+	return	line;
+}
+// }}}
+
+void	sata_cache_touch(SATACACHE *c, SATALINE *line) {
+	// {{{
+	// Move a line to the most recently used end of the list
+	if (c->c_mru == line)
+		return;
+
+	line->l_prev->l_next = line->l_next;
+	if (line->l_next)
+		line->l_next->l_prev = line->l_prev;
+	else
+		c->c_lru = line->l_prev;
+
+	line->l_prev = NULL;
+	line->l_next = c->c_mru;
+	c->c_mru->l_prev = line;
+	c->c_mru = line;
+}
+// }}}
+
+void	sata_cache_unhash(SATACACHE *c, SATALINE *line) {
+	// {{{
+	SATALINE	**pp = &c->c_hash[line->l_sector % SATA_CACHE_HASH];
+
+	while(*pp != NULL && *pp != line)
+		pp = &(*pp)->l_hash;
+	if (*pp)
+		*pp = line->l_hash;
+	line->l_hash = NULL;
+}
+// }}}
+
+SATALINE *sata_cache_alloc(SATADRV *dev, unsigned sector, int ahead) {
+	// {{{
+	// Claim the least recently used line that isn't busy, for the given
+	// sector.  If that line is dirty, every dirty line is written back
+	// first--unless we're only reading ahead, which never waits.
+	SATACACHE	*c = dev->d_cache;
+	SATALINE	*line;
+
+	while(1) {
+		for(line = c->c_lru; line != NULL; line = line->l_prev)
+			if (0 == (line->l_flags & SATA_LINE_BUSY))
+				break;
+
+		if (line != NULL && 0 == (line->l_flags & SATA_LINE_DIRTY))
+			break;
+		if (ahead)
+			return	NULL;
+		if (NULL == line)
+			sata_cache_wait(dev);
+		else if (sata_cache_flush(dev) != RES_OK)
+			return	NULL;
 	}
-	// }}}
 
-	if (err) {
+	sata_cache_unhash(c, line);
+	line->l_sector = sector;
+	line->l_flags  = 0;
+	line->l_hash   = c->c_hash[sector % SATA_CACHE_HASH];
+	c->c_hash[sector % SATA_CACHE_HASH] = line;
+	sata_cache_touch(c, line);
+
+	return	line;
+}
+// }}}
+
+int	sata_cache_issue(SATADRV *dev, SATALINE *line, const unsigned cmd) {
+	// {{{
+	// Start a line's read, or its write back.  sata_cache_done() will
+	// clear the BUSY flag again once it completes.
+	SATACACHE	*c = dev->d_cache;
+	SATAREQ		*req;
+
+	sata_lock(dev);
+	line->l_flags |= SATA_LINE_BUSY;
+	c->c_busy++;
+	sata_unlock(dev);
+
+	while(NULL == (req = sata_submit(dev, cmd, line->l_sector, 1,
+				SATA_LINE_DATA(c, line), sata_cache_done, line)))
+		sata_cache_wait(dev);
+
+	if (SATA_INVALID == req) {
+		// Fail it, just as the drive would have
+		sata_lock(dev);
+		sata_cache_done(line, RES_PARERR);
+		sata_unlock(dev);
+		return	RES_PARERR;
+	}
+
+	return	RES_OK;
+}
+// }}}
+
+int	sata_cache_flush(SATADRV *dev) {
+	// {{{
+	// Write back every dirty line.  Plugging the queue first lets the
+	// elevator merge neighbouring sectors into longer commands.
+	SATACACHE	*c = dev->d_cache;
+	int		err;
+
+	dev->d_plug = 1;
+	for(unsigned k=0; k<SATA_CACHE_SECTORS; k++) {
+		SATALINE	*line = &c->c_line[k];
+
+		if ((line->l_flags & (SATA_LINE_DIRTY | SATA_LINE_BUSY))
+							== SATA_LINE_DIRTY)
+			sata_cache_issue(dev, line, SATA_DMA_WRITE);
+	}
+	sata_unplug(dev);
+
+	while(c->c_busy > 0)
+		sata_yield(dev);
+
+	err = c->c_err;
+	c->c_err = 0;
+
+	return	(err) ? RES_ERROR : RES_OK;
+}
+// }}}
+
+int	sata_cache_sync(SATADRV *dev, const unsigned sector,
+			const unsigned count, int drop) {
+	// {{{
+	// Before a transfer bypasses the cache, write back any dirty sectors
+	// it is about to read, or drop any it is about to overwrite
+	SATACACHE	*c = dev->d_cache;
+	int		dirty = 0;
+
+	for(unsigned k=0; k<SATA_CACHE_SECTORS; k++) {
+		SATALINE	*line = &c->c_line[k];
+
+		if (line->l_sector - sector >= count)
+			continue;
+
+		while(line->l_flags & SATA_LINE_BUSY)
+			sata_cache_wait(dev);
+
+		if (drop) {
+			sata_cache_unhash(c, line);
+			line->l_flags = 0;
+		} else if (line->l_flags & SATA_LINE_DIRTY)
+			dirty = 1;
+	}
+
+	return	(dirty) ? sata_cache_flush(dev) : RES_OK;
+}
+// }}}
+
+int	sata_cache_read(SATADRV *dev, const unsigned sector,
+			const unsigned count, char *buf) {
+	// {{{
+	SATACACHE	*c = dev->d_cache;
+	SATALINE	*line;
+	unsigned	ahead;
+
+	if (count > SATA_CACHE_BYPASS) {
+		c->c_ranext = sector + count;
+		c->c_rawin  = 0;
+		if (sata_cache_sync(dev, sector, count, 0) != RES_OK)
+			return	RES_ERROR;
+		return	sata_io(dev, SATA_DMA_READ, sector, count, buf);
+	}
+
+	// Stream detection: each read continuing the last one doubles the
+	// read ahead window.  Any other read closes it.
+	if (sector == c->c_ranext) {
+		c->c_rawin = (c->c_rawin) ? (c->c_rawin * 2) : SATA_CACHE_RAMIN;
+		if (c->c_rawin > SATA_CACHE_RAMAX)
+			c->c_rawin = SATA_CACHE_RAMAX;
+	} else
+		c->c_rawin = 0;
+	c->c_ranext = sector + count;
+
+	// The read ahead window stops at the end of the disk
+	ahead = c->c_rawin;
+	if (dev->d_sector_count != 0
+			&& ahead > dev->d_sector_count - (sector + count))
+		ahead = dev->d_sector_count - (sector + count);
+
+	// Start reading every missing sector, and every missing sector in
+	// the read ahead window, with the queue plugged so they merge
+	dev->d_plug = 1;
+	for(unsigned k=0; k<count + ahead; k++) {
+		line = sata_cache_lookup(c, sector + k);
+		if (line != NULL
+			&& (line->l_flags & (SATA_LINE_VALID | SATA_LINE_BUSY))) {
+			if (k < count)
+				sata_cache_touch(c, line);
+			continue;
+		}
+
+		if (NULL == line)
+			line = sata_cache_alloc(dev, sector + k, (k >= count));
+		if (NULL == line)
+			break;
+
+		sata_cache_issue(dev, line, SATA_DMA_READ);
+	}
+	sata_unplug(dev);
+
+	// Now copy the data out, waiting for any sectors still being read
+	for(unsigned k=0; k<count; k++) {
+		line = sata_cache_lookup(c, sector + k);
+		if (NULL == line || 0 == (line->l_flags
+				& (SATA_LINE_VALID | SATA_LINE_BUSY))) {
+			// Evicted, or never started
+			if (NULL == line
+				&& NULL == (line = sata_cache_alloc(dev,
+							sector + k, 0)))
+				return	RES_ERROR;
+			if (RES_OK != sata_cache_issue(dev, line,
+							SATA_DMA_READ))
+				return	RES_ERROR;
+		}
+
+		while(line->l_flags & SATA_LINE_BUSY)
+			sata_cache_wait(dev);
+
+		if (0 == (line->l_flags & SATA_LINE_VALID))
+			return	RES_ERROR;
+
+		memcpy(buf + k * 512, SATA_LINE_DATA(c, line), 512);
+	}
+
+	return	RES_OK;
+}
+// }}}
+
+int	sata_cache_write(SATADRV *dev, const unsigned sector,
+			const unsigned count, const char *buf) {
+	// {{{
+	SATACACHE	*c = dev->d_cache;
+	SATALINE	*line;
+
+	if (count > SATA_CACHE_BYPASS) {
+		sata_cache_sync(dev, sector, count, 1);
+		return	sata_io(dev, SATA_DMA_WRITE, sector, count,
+							(char *)buf);
+	}
+
+	// Write back: the data only goes to the cache for now
+	for(unsigned k=0; k<count; k++) {
+		line = sata_cache_lookup(c, sector + k);
+		if (line != NULL) {
+			while(line->l_flags & SATA_LINE_BUSY)
+				sata_cache_wait(dev);
+			sata_cache_touch(c, line);
+		} else if (NULL == (line = sata_cache_alloc(dev, sector + k, 0)))
+			return	RES_ERROR;
+
+		memcpy(SATA_LINE_DATA(c, line), buf + k * 512, 512);
+		line->l_flags = SATA_LINE_VALID | SATA_LINE_DIRTY;
+	}
+
+	return	RES_OK;
+}
+// }}}
+#endif
+
+int	sata_io(SATADRV *dev, const unsigned cmd, const unsigned sector,
+			const unsigned count, char *buf) {
+	// {{{
+	// A blocking transfer, straight to or from the drive
+	SATAREQ	*req;
+
+	if (dev->d_scatter && ((uintptr_t)buf & (SATA_SG_ALIGN-1)))
+		return	RES_PARERR;
+
+	// Wait for a free request handle, if others are using them all
+	while(NULL == (req = sata_submit(dev, cmd, sector, count, buf,
+							NULL, NULL)))
+		sata_yield(dev);
+	if (SATA_INVALID == req)
+		return	RES_PARERR;
+
+	if (sata_wait(dev, req) != RES_OK) {
 		if (SDEBUG)
-			txstr("SATA-WRITE -> ERR\n");
+			txstr((SATA_DMA_READ == cmd) ? "SATA-READ -> ERR\n"
+						: "SATA-WRITE -> ERR\n");
 		return	RES_ERROR;
 	} return RES_OK;
 }
 // }}}
 
-int	sata_read(SATADRV *dev, const unsigned sector,
-				const unsigned count, char *buf) {
+int	sata_trim(SATADRV *dev, unsigned sector, unsigned count) {
+	// {{{
+	// Tell the drive these sectors no longer hold anything, with as few
+	// DATA SET MANAGEMENT commands as it takes to list them.  Each range
+	// is eight bytes, least significant first: a 48-bit LBA, then a
+	// 16-bit count.  Unused ranges, with a count of zero, pad out the
+	// last block.  As with IDENTIFY, this takes an OPT_LITTLE_ENDIAN
+	// controller to send the bytes in memory order.
+	int	status = RES_OK;
+
+	GRAB_MUTEX(dev->d_trimlock);
+	while(count > 0 && RES_OK == status) {
+		uint8_t		*e = dev->d_dsm;
+		unsigned	nranges = 0, nblocks;
+
+		while(count > 0 && nranges < dev->d_dsmblocks * 64) {
+			const unsigned	n = (count > 0x0ffff) ? 0x0ffff : count;
+
+			e[0] = sector;
+			e[1] = sector >> 8;
+			e[2] = sector >> 16;
+			e[3] = sector >> 24;
+			e[4] = e[5] = 0;
+			e[6] = n;
+			e[7] = n >> 8;
+
+			sector += n;
+			count  -= n;
+			nranges++;
+			e += 8;
+		}
+
+		nblocks = (nranges + 63) / 64;
+		memset(e, 0, nblocks * 512 - nranges * 8);
+
+		// Being a barrier, this waits on every earlier write
+		status = sata_io(dev, SATA_DSM_TRIM, 0, nblocks,
+						(char *)dev->d_dsm);
+	}
+	RELEASE_MUTEX(dev->d_trimlock);
+
+	return	status;
+}
+// }}}
+
+int	sata_write(SATADRV *dev, const unsigned sector,
+			const unsigned count, const char *buf) {
 	// {{{
 	if (0 == count)
-		return RES_OK;
+		return	RES_OK;
 
 	if (SDEBUG) {
 		// {{{
-		txstr("SATA-READ(MNY): ");
+		txstr("SATA-WRITE(MNY): ");
 		txhex(sector);
 		txstr(", ");
 		txhex(count);
 		txstr(", ");
-		txhex(buf);
+		txhex((unsigned)(uintptr_t)buf);
 		txstr("\n");
 	}
 	// }}}
 
-	GRAB_MUTEX;
+	if (dev->d_sector_count != 0 && (sector >= dev->d_sector_count
+			|| count > dev->d_sector_count - sector))
+		return	RES_PARERR;
 
-	dev->d_dev->s_count = count;	// Number of sectors
-	dev->d_dev->s_dma   = buf;	// Address to source the data from
-	dev->d_dev->s_lbalo = sector & 0x0ffffff;
-	dev->d_dev->s_lbahi = 0;
+#if	SATA_CACHE_SECTORS > 0
+	if (dev->d_cache) {
+		int	status;
 
-	// Here's the *go* command
-	dev->d_dev->s_cmd   = SATA_DMA_READ | ((sector >> 16) & 0x0f00);
+		GRAB_MUTEX(dev->d_cache->c_lock);
+		status = sata_cache_write(dev, sector, count, buf);
+		RELEASE_MUTEX(dev->d_cache->c_lock);
+		return	status;
+	}
+#endif
+	return	sata_io(dev, SATA_DMA_WRITE, sector, count, (char *)buf);
+}
+// }}}
 
-	sata_wait_while_busy(dev);
+int	sata_read(SATADRV *dev, const unsigned sector,
+				const unsigned count, char *buf) {
+	// {{{
+	if (0 == count)
+		return RES_OK;
 
-	dev_stat  = dev->d_dev->s_cmd;
+	if (SDEBUG) {
+		// {{{
+		txstr("SATA-READ(MNY): ");
+		txhex(sector);
+		txstr(", ");
+		txhex(count);
+		txstr(", ");
+		txhex((unsigned)(uintptr_t)buf);
+		txstr("\n");
+	}
+	// }}}
 
-	RELEASE_MUTEX;
+	if (dev->d_sector_count != 0 && (sector >= dev->d_sector_count
+			|| count > dev->d_sector_count - sector))
+		return	RES_PARERR;
 
-	if (err) {
-		if (SDEBUG)
-			txstr("SATA-READ -> ERR\n");
-		return RES_ERROR;
-	} return RES_OK;
+#if	SATA_CACHE_SECTORS > 0
+	if (dev->d_cache) {
+		int	status;
+
+		GRAB_MUTEX(dev->d_cache->c_lock);
+		status = sata_cache_read(dev, sector, count, buf);
+		RELEASE_MUTEX(dev->d_cache->c_lock);
+		return	status;
+	}
+#endif
+	return	sata_io(dev, SATA_DMA_READ, sector, count, buf);
 }
 // }}}
 
-int	sdio_ioctl(SATADRV *dev, char cmd, char *buf) {
+int	sata_ioctl(SATADRV *dev, char cmd, char *buf) {
 	// {{{
-	int		dstat;
-	unsigned	vc;
-
 	switch(cmd) {
 	case CTRL_SYNC: {
-			GRAB_MUTEX;
+			int	status = RES_OK;
+#if	SATA_CACHE_SECTORS > 0
+			if (dev->d_cache) {
+				GRAB_MUTEX(dev->d_cache->c_lock);
+				status = sata_cache_flush(dev);
+				RELEASE_MUTEX(dev->d_cache->c_lock);
+			}
+#endif
 			sata_wait_while_busy(dev);
-			RELEASE_MUTEX;
-			return	RES_OK;
+
+			// Then get it all out of the drive's own cache.  A drive
+			// whose cache couldn't be turned off, yet can't flush
+			// it, has nothing more to offer.
+			if (2 == dev->d_wcache && 0 != dev->d_flushcmd
+					&& RES_OK != sata_io(dev,
+						dev->d_flushcmd, 0, 0, NULL))
+				status = RES_ERROR;
+			return	status;
+		} break;
+	case CTRL_TRIM: {
+			// FatFS passes the first and last sectors to trim
+			LBA_t		*range = (LBA_t *)buf;
+			unsigned	sector, count;
+
+			if (!dev->d_trim || range[1] < range[0]
+					|| range[1] >= dev->d_sector_count)
+				return	RES_PARERR;
+			sector = range[0];
+			count  = range[1] - range[0] + 1;
+
+#if	SATA_CACHE_SECTORS > 0
+			if (dev->d_cache) {
+				int	status;
+
+				// Nothing cached may outlive the TRIM, nor be
+				// written back after it
+				GRAB_MUTEX(dev->d_cache->c_lock);
+				sata_cache_sync(dev, sector, count, 1);
+				status = sata_trim(dev, sector, count);
+				RELEASE_MUTEX(dev->d_cache->c_lock);
+				return	status;
+			}
+#endif
+			return	sata_trim(dev, sector, count);
 		} break;
 	case GET_SECTOR_COUNT:
 		{	DWORD	*w = (DWORD *)buf;
@@ -351,6 +1948,13 @@ int	sdio_ioctl(SATADRV *dev, char cmd, char *buf) {
 			*w = 512;	// *MUST* be
 			return RES_OK;
 		} break;
+	case GET_BLOCK_SIZE:
+		{	DWORD	*w = (DWORD *)buf;
+			// In sectors.  Aligning to this avoids any read-modify-
+			// write cycles within the drive.
+			*w = dev->d_block_size / 512;
+			return RES_OK;
+		} break;
 	}
 
 	return	RES_PARERR;
@@ -40,14 +40,35 @@
 #define	SATADRV_H
 #include <stdint.h>
 
+#ifdef	SATA_HOST
+// Built for a host, rather than the target CPU, the registers are proxies
+// for bus transactions on a simulated controller
+#include "satahost.h"
+#else
 typedef	struct SATA_S {
 	volatile uint32_t	s_cmd, s_lbalo, s_lbahi, s_count;
-	volatile uint32_t	s_unused, s_phy;
+	volatile uint32_t	s_perf, s_phy;
 	volatile void		*s_dma;
 	volatile uint32_t	s_unused_tail;
+	// Command queue
+	volatile uint32_t	s_qctrl;
+	volatile void		*s_sqbase, *s_cqbase;
+	volatile uint32_t	s_sqdoorbell, s_cqdoorbell;
+	volatile uint32_t	s_qintr, s_qistat, s_qunused;
 } SATA;
+#endif
 
 struct	SATADRV_S;
+struct	SATAREQ_S;
+
+// Called from sata_isr() once a request completes, with the status the
+// request would've returned from sata_wait()
+typedef	void	(*SATA_CALLBACK)(void *arg, int status);
+
+// Returned by sata_submit_*() for a request that can never be started: out
+// of range, empty, or (in scatter-gather mode) misaligned.  NULL, instead,
+// only means no handle is free right now.
+#define	SATA_INVALID	((struct SATAREQ_S *)-1)
 
 extern	struct	SATADRV_S *sata_init(SATA *dev);
 extern	int	sata_write(struct SATADRV_S *dev, const unsigned sector,
@@ -55,4 +76,16 @@ extern	int	sata_write(struct SATADRV_S *dev, const unsigned sector,
 extern	int	sata_read(struct SATADRV_S *dev, const unsigned sector,
 				const unsigned count, char *buf);
 extern	int	sata_ioctl(struct SATADRV_S *dev, char cmd, char *buf);
+
+// Asynchronous I/O
+extern	struct	SATAREQ_S *sata_submit_write(struct SATADRV_S *dev,
+				const unsigned sector, const unsigned count,
+				const char *buf, SATA_CALLBACK cb, void *arg);
+extern	struct	SATAREQ_S *sata_submit_read(struct SATADRV_S *dev,
+				const unsigned sector, const unsigned count,
+				char *buf, SATA_CALLBACK cb, void *arg);
+extern	int	sata_wait(struct SATADRV_S *dev, struct SATAREQ_S *req);
+extern	void	sata_isr(struct SATADRV_S *dev);
+extern	void	sata_lock(struct SATADRV_S *dev);
+extern	void	sata_unlock(struct SATADRV_S *dev);
 #endif
@@ -0,0 +1,304 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	sw/satastripe.c
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	A striping (RAID-0) layer, on top of several instances of the
+//		SATA driver, one per controller.  The set looks like one
+//	block device, as large as its smallest drive times the number of
+//	drives.  Consecutive stripes of sectors go to consecutive drives, so
+//	that a long transfer keeps every drive busy at once.
+//
+// Entry points:
+//
+//	1. sata_stripe_init(devs, ndevs, stripe)
+//		Builds a set from ndevs drivers, each already returned by
+//		sata_init(), with stripes of "stripe" sectors.  The stripe
+//		should be a multiple of the drives' physical sector size.
+//
+//	2. sata_stripe_write(set, sector, count, buf)
+//	   sata_stripe_read(set, sector, count, buf)
+//		As sata_write() and sata_read(), but across the set.  The
+//		transfer is split on stripe boundaries, and every piece is
+//		submitted at once, through the asynchronous API.  Each drive's
+//		elevator then merges the pieces it receives into as few
+//		commands as it can, while the other drives are busy with
+//		theirs.  Returns once every piece has completed.
+//
+//	3. sata_stripe_ioctl(set, cmd, buf)
+//		As sata_ioctl().  GET_BLOCK_SIZE returns the stripe size.
+//
+//	4. sata_stripe_poll(set)
+//		Calls sata_isr() for every drive in the set.
+//
+//	While waiting, the layer calls SATA_STRIPE_WAIT(set).  By default this
+//	simply polls every drive, but it may be defined to wait for any of
+//	the controllers' interrupts first.  As the pieces all go through the
+//	asynchronous API, they bypass any sector cache, and this layer may not
+//	be used with SATA_THREADS.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include <stdlib.h>
+#include <stdint.h>
+#include <diskio.h>
+#include "satastripe.h"
+
+#ifdef	SATA_THREADS
+#error	"The striping layer doesn't support SATA_THREADS"
+#endif
+
+#ifndef	SATA_STRIPE_WAIT
+#define	SATA_STRIPE_WAIT(SET)	sata_stripe_poll(SET)
+#endif
+
+// The most drives a set may hold
+#ifndef	SATA_MAXSTRIPE
+#define	SATA_MAXSTRIPE		8
+#endif
+// }}}
+
+// Pieces of the current transfer yet to complete on one drive.  This is
+// decremented by sata_stripe_done(), from that drive's sata_isr(), so it's
+// only ever changed under that drive's sata_lock().
+typedef	struct	SATASTRIPE_PART_S {
+	struct SATASTRIPE_S	*p_set;
+	volatile unsigned	p_pending;
+} SATASTRIPE_PART;
+
+typedef	struct	SATASTRIPE_S {
+	struct SATADRV_S	*s_dev[SATA_MAXSTRIPE];
+	SATASTRIPE_PART	s_part[SATA_MAXSTRIPE];
+	unsigned	s_ndevs, s_stripe;
+	// Zero if any drive's size is unknown
+	uint32_t	s_sector_count;
+	// Set by sata_stripe_done() should any piece fail
+	volatile int		s_err;
+} SATASTRIPE;
+
+static	void	sata_stripe_done(void *arg, int status);
+static	unsigned sata_stripe_pending(SATASTRIPE *set);
+static	int	sata_stripe_io(SATASTRIPE *set, const int wr,
+			unsigned sector, unsigned count, char *buf);
+
+extern	SATASTRIPE *sata_stripe_init(struct SATADRV_S **devs,
+			const unsigned ndevs, const unsigned stripe);
+extern	int	sata_stripe_write(SATASTRIPE *set, const unsigned sector,
+			const unsigned count, const char *buf);
+extern	int	sata_stripe_read(SATASTRIPE *set, const unsigned sector,
+			const unsigned count, char *buf);
+extern	int	sata_stripe_ioctl(SATASTRIPE *set, char cmd, char *buf);
+extern	void	sata_stripe_poll(SATASTRIPE *set);
+
+SATASTRIPE *sata_stripe_init(struct SATADRV_S **devs, const unsigned ndevs,
+			const unsigned stripe) {
+	// {{{
+	SATASTRIPE	*set;
+	uint64_t	per_dev = 0, total;
+
+	if (NULL == devs || 0 == ndevs || ndevs > SATA_MAXSTRIPE || 0 == stripe)
+		return NULL;
+
+	set = (SATASTRIPE *)malloc(sizeof(SATASTRIPE));
+	if (NULL == set)
+		return NULL;
+
+	set->s_ndevs  = ndevs;
+	set->s_stripe = stripe;
+	set->s_err     = 0;
+
+	// Every drive gives up the same whole number of stripes
+	for(unsigned k=0; k<ndevs; k++) {
+		DWORD	n = 0;
+
+		set->s_dev[k] = devs[k];
+		set->s_part[k].p_set     = set;
+		set->s_part[k].p_pending = 0;
+		if (NULL == devs[k] || RES_OK != sata_ioctl(devs[k],
+					GET_SECTOR_COUNT, (char *)&n)) {
+			free(set);
+			return NULL;
+		}
+
+		if (0 == k || n < per_dev)
+			per_dev = n;
+	}
+
+	total = (per_dev / stripe) * stripe * ndevs;
+	set->s_sector_count = (total > 0xffffffff) ? 0xffffffff : total;
+
+	return	set;
+}
+// }}}
+
+void	sata_stripe_done(void *arg, int status) {
+	// {{{
+	// Called from sata_isr() as each piece completes
+	SATASTRIPE_PART	*part = (SATASTRIPE_PART *)arg;
+
+	if (RES_OK != status)
+		part->p_set->s_err = 1;
+	part->p_pending--;
+}
+// }}}
+
+unsigned sata_stripe_pending(SATASTRIPE *set) {
+	// {{{
+	unsigned	n = 0;
+
+	for(unsigned k=0; k<set->s_ndevs; k++)
+		n += set->s_part[k].p_pending;
+	return	n;
+}
+// }}}
+
+void	sata_stripe_poll(SATASTRIPE *set) {
+	// {{{
+	for(unsigned k=0; k<set->s_ndevs; k++)
+		sata_isr(set->s_dev[k]);
+}
+// }}}
+
+int	sata_stripe_io(SATASTRIPE *set, const int wr, unsigned sector,
+			unsigned count, char *buf) {
+	// {{{
+	if (0 == count)
+		return	RES_OK;
+	if (set->s_sector_count != 0 && (sector >= set->s_sector_count
+			|| count > set->s_sector_count - sector))
+		return	RES_PARERR;
+
+	set->s_err     = 0;
+
+	while(count > 0) {
+		const unsigned	stripe = sector / set->s_stripe,
+				offset = sector % set->s_stripe;
+		struct SATADRV_S *dev = set->s_dev[stripe % set->s_ndevs];
+		SATASTRIPE_PART	*part = &set->s_part[stripe % set->s_ndevs];
+		unsigned	lba, n;
+		struct SATAREQ_S *req;
+
+		// Where this piece lands on its drive
+		lba = (stripe / set->s_ndevs) * set->s_stripe + offset;
+		n   = set->s_stripe - offset;
+		if (n > count)
+			n = count;
+
+		while(1) {
+			// Count the piece before submitting it, since it may
+			// complete before sata_submit_*() even returns
+			sata_lock(dev);
+			part->p_pending++;
+			sata_unlock(dev);
+
+			req = (wr) ? sata_submit_write(dev, lba, n, buf,
+						sata_stripe_done, part)
+				: sata_submit_read(dev, lba, n, buf,
+						sata_stripe_done, part);
+			if (NULL != req && SATA_INVALID != req)
+				break;
+
+			sata_lock(dev);
+			part->p_pending--;
+			sata_unlock(dev);
+
+			// Should the drive run out of request handles, wait
+			// for some of our own to come back
+			if (SATA_INVALID == req || 0 == sata_stripe_pending(set))
+				break;
+			SATA_STRIPE_WAIT(set);
+		} if (NULL == req || SATA_INVALID == req) {
+			// Refused outright: out of range, or misaligned
+			set->s_err = 1;
+			break;
+		}
+
+		sector += n;
+		count  -= n;
+		buf    += n * 512;
+	}
+
+	// The buffer belongs to the drives until every piece is done
+	while(sata_stripe_pending(set) > 0)
+		SATA_STRIPE_WAIT(set);
+
+	return	(set->s_err) ? RES_ERROR : RES_OK;
+}
+// }}}
+
+int	sata_stripe_write(SATASTRIPE *set, const unsigned sector,
+			const unsigned count, const char *buf) {
+	// {{{
+	return	sata_stripe_io(set, 1, sector, count, (char *)buf);
+}
+// }}}
+
+int	sata_stripe_read(SATASTRIPE *set, const unsigned sector,
+			const unsigned count, char *buf) {
+	// {{{
+	return	sata_stripe_io(set, 0, sector, count, buf);
+}
+// }}}
+
+int	sata_stripe_ioctl(SATASTRIPE *set, char cmd, char *buf) {
+	// {{{
+	switch(cmd) {
+	case CTRL_SYNC: {
+			int	status = RES_OK;
+
+			for(unsigned k=0; k<set->s_ndevs; k++)
+				if (RES_OK != sata_ioctl(set->s_dev[k],
+							CTRL_SYNC, buf))
+					status = RES_ERROR;
+			return	status;
+		} break;
+	case GET_SECTOR_COUNT:
+		{	DWORD	*w = (DWORD *)buf;
+			*w = set->s_sector_count;
+			return RES_OK;
+		} break;
+	case GET_SECTOR_SIZE:
+		{	WORD	*w = (WORD *)buf;
+			*w = 512;
+			return RES_OK;
+		} break;
+	case GET_BLOCK_SIZE:
+		{	DWORD	*w = (DWORD *)buf;
+			// A transfer aligned to the stripe touches as few
+			// drives as it can
+			*w = set->s_stripe;
+			return RES_OK;
+		} break;
+	}
+
+	return	RES_PARERR;
+}
+// }}}
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	sw/satastripe.h
+// {{{
+// Project:	A Wishbone SATA controller
+//
+// Purpose:	Stripes (RAID-0) several SATA drives, each on its own
+//		controller and driver, into one block device.  See satastripe.c.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2025, Gisselquist Technology, LLC
+// {{{
+// This file is part of the WBSATA project.
+//
+// The WBSATA project is a free software (firmware) project: you may
+// redistribute it and/or modify it under the terms of  the GNU General Public
+// License as published by the Free Software Foundation, either version 3 of
+// the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  If not, please see <http://www.gnu.org/licenses/> for a
+// copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SATASTRIPE_H
+#define	SATASTRIPE_H
+#include "satadrv.h"
+
+struct	SATASTRIPE_S;
+
+extern	struct	SATASTRIPE_S *sata_stripe_init(struct SATADRV_S **devs,
+				const unsigned ndevs, const unsigned stripe);
+extern	int	sata_stripe_write(struct SATASTRIPE_S *set,
+				const unsigned sector, const unsigned count,
+				const char *buf);
+extern	int	sata_stripe_read(struct SATASTRIPE_S *set,
+				const unsigned sector, const unsigned count,
+				char *buf);
+extern	int	sata_stripe_ioctl(struct SATASTRIPE_S *set, char cmd,
+				char *buf);
+extern	void	sata_stripe_poll(struct SATASTRIPE_S *set);
+#endif